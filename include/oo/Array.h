@@ -127,7 +127,7 @@ public:
 		if (len() != t.len()) {
 			return false;
 		}
-		return std::equal(v_.begin(), v_.end(), t.v_.first());
+		return std::equal(v_.begin(), v_.end(), t.v_.begin());
 	}
 
 	bool operator<(const Array<T>& a) const { return len() < a.len(); }
@@ -167,6 +167,7 @@ public:
 	const_iterator_type cend(void) const { return v_.cend(); }
 
 	void push_back(const T& item) { v_.push_back(item); }
+	void push_back(T&& item) { v_.push_back(std::move(item)); }
 
 private:
 	std::vector<T> v_;
@@ -33,15 +33,67 @@
 #include "oo/Base.h"
 #include "oo/Sizeable.h"
 #include "oo/Error.h"
+#include "oo/Array.h"
+#include "oo/lockstat.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <new>
+#include <utility>
 #include <vector>
 
 namespace oo {
 
+/*
+	a SelectWaiter is what a Select sleeps on
+	channels wake it up when something changes
+*/
+class SelectWaiter {
+public:
+	SelectWaiter() : mx_(), cond_(), fired_(false) { }
+
+	SelectWaiter(const SelectWaiter&) = delete;
+	SelectWaiter& operator=(const SelectWaiter&) = delete;
+
+	void fire(void) {
+		std::lock_guard<std::mutex> lk(mx_);
+		fired_ = true;
+		cond_.notify_one();
+	}
+
+	void reset(void) {
+		std::lock_guard<std::mutex> lk(mx_);
+		fired_ = false;
+	}
+
+	void wait(void) {
+		std::unique_lock<std::mutex> lk(mx_);
+		cond_.wait(lk, [this](){ return this->fired_; });
+	}
+
+	// returns false on timeout
+	bool wait_until(const std::chrono::steady_clock::time_point& deadline) {
+		std::unique_lock<std::mutex> lk(mx_);
+		return cond_.wait_until(lk, deadline, [this](){ return this->fired_; });
+	}
+
+private:
+	std::mutex mx_;
+	std::condition_variable cond_;
+	bool fired_;
+};
+
+template <typename T>
+class SelectRead;
+
+template <typename T>
+class SelectWrite;
+
 /*
 	the channel class
 	A channel is a queue of items that is shared between threads.
@@ -50,16 +102,34 @@ namespace oo {
 	synchronisation signalling, and you can pass object pointers through
 	channels.
 
-	Mind that only the read() and write() methods do proper locking
-
-	You can't close a channel, as there is never a need to, but you can
-	call clear() on it to free up the buffer. This does not do locking,
-	you have to make sure yourself that no other thread is using the
-	channel at that moment. You can't use a channel anymore after it
-	has been cleared (the program will segv). However you can grow() it
-	and start using it again.
-	Anyway, a channel is not like a	file or socket that you should open
-	and close all the time.
+	The buffer is a fixed size ring, so reading and writing take
+	constant time, however deep the channel is. Items are moved into
+	and out of the channel, so move-only types like std::unique_ptr
+	can be passed through a channel. emplace() constructs the item
+	in place
+
+	write_many() and read_many() move a whole batch of items under
+	a single lock, and wake up waiting threads only once. drain()
+	takes whatever is in the channel, without waiting
+
+	A writer may close() the channel, to tell readers that no more
+	items are coming. Readers still get the items that are left;
+	after that, read() returns false. get() throws RuntimeError, and
+	so does writing to a closed channel
+
+	try_read() and try_write() never block. read_for(), read_until(),
+	write_for() and write_until() wait until a timeout or deadline,
+	and return false if it passed. See Select.h for waiting on
+	several channels at once
+
+	A channel with a name counts how often readers and writers had
+	to wait, and for how long; see lockstat.h
+
+	Mind that clear() does no locking
+	Calling clear() frees up the buffer. You have to make sure yourself
+	that no other thread is using the channel at that moment. You can't
+	use a channel anymore after it has been cleared (writers will block
+	forever). However you can grow() it and start using it again.
 */
 template <typename T>
 class Chan : public Base, public Sizeable {
@@ -67,20 +137,26 @@ public:
 	typedef T value_type;
 
 	Chan(size_t n=1) : Base(), Sizeable(),
-		mx_(), not_empty_(), not_full_(), buffer() {
+		mx_(), not_empty_(), not_full_(), buf_(nullptr), cap_(0), head_(0), len_(0), batch_readers_(0),
+		closed_(false), selectors_(), stat_() {
 		if (n <= 0) {
 			throw ValueError();
 		}
-		buffer.reserve(n);
+		grow(n);
+	}
+
+	Chan(size_t n, const char *name) : Chan(n) {
+		stat_.reset(new LockStat(name));
 	}
 
 	Chan(const Chan&) = delete;
 
-	Chan(Chan&& c) : Base(), Sizeable() {
-		mx_ = std::move(c.mx_);
-		not_empty_ = std::move(c.not_empty_);
-		not_full_ = std::move(c.not_full_);
-		buffer = std::move(c.buffer);
+	// moving only moves the buffer; the lock is not moved
+	Chan(Chan&& c) : Base(), Sizeable(),
+		mx_(), not_empty_(), not_full_(), buf_(nullptr), cap_(0), head_(0), len_(0), batch_readers_(0),
+		closed_(false), selectors_(), stat_() {
+		std::lock_guard<std::mutex> lk(c.mx_);
+		take(c);
 	}
 
 	virtual ~Chan() { clear(); }
@@ -88,10 +164,13 @@ public:
 	Chan& operator=(const Chan&) = delete;
 
 	Chan& operator=(Chan&& c) {
-		mx_ = std::move(c.mx_);
-		not_empty_ = std::move(c.not_empty_);
-		not_full_ = std::move(c.not_full_);
-		buffer = std::move(c.buffer);
+		if (this == &c) {
+			return *this;
+		}
+		clear();
+
+		std::lock_guard<std::mutex> lk(c.mx_);
+		take(c);
 		return *this;
 	}
 
@@ -99,32 +178,202 @@ public:
 
 	void clear(void) {
 		// warning: it clears whether the mutex is locked or not
-		buffer.clear();
+		while(len_ > 0) {
+			buf_[head_].~T();
+			head_ = next(head_);
+			len_--;
+		}
+		::operator delete(buf_);
+		buf_ = nullptr;
+		cap_ = head_ = 0;
 	}
 
-	size_t len(void) const { return buffer.size(); }
-	size_t cap(void) const { return buffer.capacity(); }
+	size_t len(void) const { return len_; }
+	size_t cap(void) const { return cap_; }
 
 	bool operator!(void) const { return empty(); }
 
-	void grow(size_t n) {
-		buffer.reserve(n);
+	void grow(size_t);
+
+	void close(void);
+	bool closed(void) const {
+		std::lock_guard<std::mutex> lk(mx_);
+		return closed_;
+	}
+
+	// construct an item in place at the end of the channel
+	template <typename... Args>
+	void emplace(Args&&...);
+
+	void write(const T& t) { emplace(t); }
+	void write(T&& t) { emplace(std::move(t)); }
+
+	// returns false if the channel is closed, and there are no more items
+	bool read(T&);
+
+	void put(const T& t) { emplace(t); }
+	void put(T&& t) { emplace(std::move(t)); }
+	T get(void);
+
+	// these do not block; they return false if the channel is full or empty
+	bool try_write(const T& t) { return write_until_(t, nullptr); }
+	bool try_write(T&& t) { return write_until_(std::move(t), nullptr); }
+	bool try_read(T& t) { return read_until_(t, nullptr); }
+
+	// these return false if the timeout passed
+	template <typename Rep, typename Period>
+	bool write_for(const T& t, const std::chrono::duration<Rep, Period>& timeout) {
+		return write_until(t, std::chrono::steady_clock::now() + timeout);
+	}
+
+	bool write_until(const T& t, const std::chrono::steady_clock::time_point& deadline) {
+		return write_until_(t, &deadline);
 	}
 
-	void write(const T&);
-	void read(T&);
+	template <typename Rep, typename Period>
+	bool read_for(T& t, const std::chrono::duration<Rep, Period>& timeout) {
+		return read_until(t, std::chrono::steady_clock::now() + timeout);
+	}
 
-	void put(const T& t) { this->write(t); }
-	T get(void) {
-		T t;
-		this->read(t);
-		return t;
+	bool read_until(T& t, const std::chrono::steady_clock::time_point& deadline) {
+		return read_until_(t, &deadline);
 	}
 
+	// write n items; blocks until all have been written
+	void write_many(const T *, size_t n);
+
+	// read at least min and at most max items; returns number of items read
+	// if the channel is closed, this may return fewer than min items
+	size_t read_many(T *, size_t max, size_t min=1);
+
+	// append all items in the channel to the array; does not block
+	// returns number of items
+	size_t drain(Array<T>&);
+
+	// the profiling counters; nullptr if the channel has no name
+	const LockStat *stat(void) const { return stat_.get(); }
+
 private:
-	std::mutex mx_;
+	mutable std::mutex mx_;
 	std::condition_variable not_empty_, not_full_;
-	std::vector<T> buffer;
+	T *buf_;			// ring of cap_ items
+	size_t cap_, head_, len_;
+	size_t batch_readers_;	// readers waiting for more than one item
+	bool closed_;
+	std::vector<SelectWaiter *> selectors_;
+	std::unique_ptr<LockStat> stat_;	// stays with the channel, like the lock
+
+	size_t next(size_t idx) const {
+		idx++;
+		if (idx >= cap_) {
+			idx = 0;
+		}
+		return idx;
+	}
+
+	// wait on a condition variable, and count it if profiling
+	template <typename Pred>
+	void cond_wait(std::condition_variable& cond, std::unique_lock<std::mutex>& lk, Pred pred) {
+		if (stat_.get() == nullptr || !lockstat_enabled()) {
+			cond.wait(lk, pred);
+			return;
+		}
+		if (pred()) {
+			stat_->record(false);
+			return;
+		}
+		uint64_t t0 = LockStat::now_ns();
+		cond.wait(lk, pred);
+		stat_->record(true, LockStat::now_ns() - t0);
+	}
+
+	template <typename Pred>
+	bool cond_wait_until(std::condition_variable& cond, std::unique_lock<std::mutex>& lk,
+		const std::chrono::steady_clock::time_point& deadline, Pred pred) {
+		if (stat_.get() == nullptr || !lockstat_enabled()) {
+			return cond.wait_until(lk, deadline, pred);
+		}
+		if (pred()) {
+			stat_->record(false);
+			return true;
+		}
+		uint64_t t0 = LockStat::now_ns();
+		bool ok = cond.wait_until(lk, deadline, pred);
+		stat_->record(true, LockStat::now_ns() - t0);
+		return ok;
+	}
+
+	void wait_not_full(std::unique_lock<std::mutex>&);
+	void wait_not_empty(std::unique_lock<std::mutex>&);
+	void notify_readers(size_t);
+	void notify_writers(size_t);
+
+	template <typename U>
+	bool write_until_(U&&, const std::chrono::steady_clock::time_point *);
+	bool read_until_(T&, const std::chrono::steady_clock::time_point *);
+
+	// put an item at the end; the lock must be held
+	template <typename... Args>
+	void push(Args&&... args) {
+		size_t tail = head_ + len_;
+		if (tail >= cap_) {
+			tail -= cap_;
+		}
+		new(&buf_[tail]) T(std::forward<Args>(args)...);
+		len_++;
+	}
+
+	// take the item at the head; the lock must be held
+	void pop(T& t) {
+		t = std::move(buf_[head_]);
+		buf_[head_].~T();
+		head_ = next(head_);
+		len_--;
+	}
+
+	void check_closed(void) const {
+		if (closed_) {
+			throw RuntimeError("write on closed channel");
+		}
+	}
+
+	// wake up any Select that is waiting on this channel
+	void wake_selectors(void) {
+		for(SelectWaiter *w : selectors_) {
+			w->fire();
+		}
+	}
+
+	// used by Select; the lock must be held
+	void add_selector(SelectWaiter *w) {
+		selectors_.push_back(w);
+	}
+
+	// used by Select; this takes the lock
+	void remove_selector(SelectWaiter *w) {
+		std::lock_guard<std::mutex> lk(mx_);
+		auto it = std::find(selectors_.begin(), selectors_.end(), w);
+		if (it != selectors_.end()) {
+			selectors_.erase(it);
+		}
+	}
+
+	void take(Chan& c) {
+		buf_ = c.buf_;
+		cap_ = c.cap_;
+		head_ = c.head_;
+		len_ = c.len_;
+		closed_ = c.closed_;
+
+		c.buf_ = nullptr;
+		c.cap_ = c.head_ = c.len_ = 0;
+	}
+
+	template <typename U>
+	friend class SelectRead;
+
+	template <typename U>
+	friend class SelectWrite;
 
 	template <typename U>
 	friend std::ostream& operator<<(std::ostream&, const Chan<U>&);
@@ -133,49 +382,281 @@ private:
 // templated methods
 
 template <typename T>
-void Chan<T>::write(const T& t) {
-	std::unique_lock<std::mutex> lk(mx_);
+void Chan<T>::grow(size_t n) {
+	std::lock_guard<std::mutex> lk(mx_);
 
-	// wait until not full
+	if (n <= cap_) {
+		return;
+	}
+
+	T *new_buf = static_cast<T *>(::operator new(n * sizeof(T)));
+
+	// move the items over, head first
+	size_t idx = head_;
+	for(size_t i = 0; i < len_; i++) {
+		new(&new_buf[i]) T(std::move(buf_[idx]));
+		buf_[idx].~T();
+		idx = next(idx);
+	}
+	::operator delete(buf_);
+
+	buf_ = new_buf;
+	cap_ = n;
+	head_ = 0;
+
+	// writers may be waiting for room
+	notify_writers(2);
+}
+
+template <typename T>
+void Chan<T>::close(void) {
+	std::lock_guard<std::mutex> lk(mx_);
+
+	closed_ = true;
+
+	// everyone should wake up and see
+	try {
+		not_empty_.notify_all();
+		not_full_.notify_all();
+	} catch(std::system_error) {
+		throw OSError("channel signal failed");
+	}
+	wake_selectors();
+}
+
+template <typename T>
+void Chan<T>::wait_not_full(std::unique_lock<std::mutex>& lk) {
 	try {
-		not_full_.wait(lk, [this](){ return this->len() < this->cap(); });
+		cond_wait(not_full_, lk, [this](){ return this->len_ < this->cap_ || this->closed_; });
 	} catch(std::system_error) {
 		throw OSError("wait on channel failed");
 	}
+	check_closed();
+}
 
-	// we have a lock and we have room, put the item
-	buffer.push_back(t);
+template <typename T>
+void Chan<T>::wait_not_empty(std::unique_lock<std::mutex>& lk) {
+	try {
+		cond_wait(not_empty_, lk, [this](){ return this->len_ != 0 || this->closed_; });
+	} catch(std::system_error) {
+		throw OSError("wait on channel failed");
+	}
+}
 
-	// wake up an other thread
+template <typename T>
+void Chan<T>::notify_readers(size_t n) {
 	try {
-		not_empty_.notify_one();
+		// a reader that waits for a batch may not be satisfied yet,
+		// so then wake up all readers
+		if (n > 1 || batch_readers_ > 0) {
+			not_empty_.notify_all();
+		} else {
+			not_empty_.notify_one();
+		}
 	} catch(std::system_error) {
 		throw OSError("channel signal failed");
 	}
+	if (!selectors_.empty()) {
+		wake_selectors();
+	}
 }
 
 template <typename T>
-void Chan<T>::read(T& t) {
+void Chan<T>::notify_writers(size_t n) {
+	try {
+		if (n > 1) {
+			not_full_.notify_all();
+		} else {
+			not_full_.notify_one();
+		}
+	} catch(std::system_error) {
+		throw OSError("channel signal failed");
+	}
+	if (!selectors_.empty()) {
+		wake_selectors();
+	}
+}
+
+template <typename T>
+template <typename... Args>
+void Chan<T>::emplace(Args&&... args) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	// wait until not full
+	wait_not_full(lk);
+
+	// we have a lock and we have room, put the item
+	push(std::forward<Args>(args)...);
+
+	// wake up an other thread
+	notify_readers(1);
+}
+
+template <typename T>
+bool Chan<T>::read(T& t) {
 	std::unique_lock<std::mutex> lk(mx_);
 
 	// wait until not empty
-	try {
-		not_empty_.wait(lk, [this](){ return this->len() != 0; });
-	} catch(std::system_error) {
-		throw OSError("wait on channel failed");
+	wait_not_empty(lk);
+	if (!len_) {
+		// closed
+		return false;
 	}
 
 	// get an item
-	typename std::vector<T>::iterator it = buffer.begin();
-	t = *it;
-	buffer.erase(it);
+	pop(t);
 
 	// wake up an other thread
-	try {
-		not_full_.notify_one();
-	} catch(std::system_error) {
-		throw OSError("channel signal failed");
+	notify_writers(1);
+	return true;
+}
+
+template <typename T>
+T Chan<T>::get(void) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	wait_not_empty(lk);
+	if (!len_) {
+		throw RuntimeError("read on closed channel");
+	}
+
+	T t(std::move(buf_[head_]));
+	buf_[head_].~T();
+	head_ = next(head_);
+	len_--;
+
+	notify_writers(1);
+	return t;
+}
+
+// without deadline, this does not wait at all
+template <typename T>
+template <typename U>
+bool Chan<T>::write_until_(U&& u, const std::chrono::steady_clock::time_point *deadline) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	if (deadline != nullptr) {
+		try {
+			cond_wait_until(not_full_, lk, *deadline, [this](){ return this->len_ < this->cap_ || this->closed_; });
+		} catch(std::system_error) {
+			throw OSError("wait on channel failed");
+		}
+	}
+	check_closed();
+
+	if (len_ >= cap_) {
+		return false;
+	}
+	push(std::forward<U>(u));
+	notify_readers(1);
+	return true;
+}
+
+template <typename T>
+bool Chan<T>::read_until_(T& t, const std::chrono::steady_clock::time_point *deadline) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	if (deadline != nullptr) {
+		try {
+			cond_wait_until(not_empty_, lk, *deadline, [this](){ return this->len_ != 0 || this->closed_; });
+		} catch(std::system_error) {
+			throw OSError("wait on channel failed");
+		}
+	}
+
+	if (!len_) {
+		return false;
+	}
+	pop(t);
+	notify_writers(1);
+	return true;
+}
+
+template <typename T>
+void Chan<T>::write_many(const T *items, size_t n) {
+	if (items == nullptr && n > 0) {
+		throw ReferenceError();
+	}
+
+	std::unique_lock<std::mutex> lk(mx_);
+
+	while(n > 0) {
+		wait_not_full(lk);
+
+		// put as many as there is room for
+		size_t count = cap_ - len_;
+		if (count > n) {
+			count = n;
+		}
+		for(size_t i = 0; i < count; i++) {
+			push(items[i]);
+		}
+		items += count;
+		n -= count;
+
+		notify_readers(count);
+	}
+}
+
+template <typename T>
+size_t Chan<T>::read_many(T *items, size_t max, size_t min) {
+	if (items == nullptr) {
+		throw ReferenceError();
+	}
+	if (min > max) {
+		throw ValueError();
+	}
+	if (!max) {
+		return 0;
+	}
+
+	std::unique_lock<std::mutex> lk(mx_);
+
+	// wait for min items, or for a full channel if it can't hold that many
+	if (min > 1) {
+		batch_readers_++;
+		try {
+			cond_wait(not_empty_, lk, [this, min](){
+				return this->len_ >= min || (this->len_ > 0 && this->len_ == this->cap_) || this->closed_;
+			});
+		} catch(std::system_error) {
+			batch_readers_--;
+			throw OSError("wait on channel failed");
+		}
+		batch_readers_--;
+	} else if (min == 1) {
+		wait_not_empty(lk);
+	}
+
+	size_t count = (len_ < max) ? len_ : max;
+	for(size_t i = 0; i < count; i++) {
+		pop(items[i]);
+	}
+
+	if (count) {
+		notify_writers(count);
+	}
+	return count;
+}
+
+template <typename T>
+size_t Chan<T>::drain(Array<T>& a) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	size_t count = len_;
+	a.grow(a.len() + count);
+
+	for(size_t i = 0; i < count; i++) {
+		a.push_back(std::move(buf_[head_]));
+		buf_[head_].~T();
+		head_ = next(head_);
+		len_--;
+	}
+
+	if (count) {
+		notify_writers(count);
 	}
+	return count;
 }
 
 // used for printing
@@ -87,7 +87,9 @@ public:
 	bool operator==(const Dict<T>& d) const;
 	bool operator<(const Dict<T>& d) const { return len() < d.len(); }
 
-	bool has_key(const String& s) const { return m_.find(s) != m_.end(); }
+	// std::map can not search by a StringView; for short keys the String
+	// lives on the stack, so this does not allocate
+	bool has_key(const StringView& s) const { return m_.find(String(s)) != m_.end(); }
 	bool del(const String& s) { return m_.erase(s) == 1; }
 
 	Array<String> keys(void) const;
@@ -51,6 +51,7 @@ extern const int kIOError;
 extern const int kRuntimeError;
 extern const int kOSError;
 extern const int kStringEncodingError;
+extern const int kCancelledError;
 
 class Error : public Base {
 public:
@@ -154,6 +155,7 @@ oo_define_error(IOError, "I/O error");
 oo_define_error(RuntimeError, "runtime error");	// often used for other kind of errors
 oo_define_error(OSError, "OS error");
 oo_define_error(StringEncodingError, "string encoding error");
+oo_define_error(CancelledError, "operation was cancelled");
 
 void panic(const Error&);
 void panic(const std::string&);
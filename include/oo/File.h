@@ -188,7 +188,7 @@ public:
 	String readline(void);
 	Array<String> readlines(void);
 	size_t read(void *, size_t);
-	void write(const String&);
+	void write(const StringView&);
 	void writelines(const Array<String>&);
 	void write(void *, size_t);
 	void seek(long, int);
@@ -0,0 +1,507 @@
+/*
+	Future.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOFUTURE_H_WJ114
+#define OOFUTURE_H_WJ114
+
+#include "oo/Base.h"
+#include "oo/Array.h"
+#include "oo/Error.h"
+#include "oo/ThreadPool.h"
+#include "oo/go.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+/*
+	futures: values that are computed in the background
+
+		Future<int> f = async(compute, 10, 20);
+		...
+		int answer = f.get();
+
+	async() runs the function on go_pool(); async_on() runs it on
+	a pool of your choice. get() waits for the result, and throws the
+	exception that the function threw, if any. wait_for() and
+	wait_until() return false if the timeout passed
+
+	then() chains a function that runs (on go_pool()) with the result
+	once it's there, and gives a new Future for its result. If the
+	first function threw, the chained function is skipped and its
+	Future gets the same exception
+
+	when_all() gives a Future for an Array of all results; when_any()
+	gives a Future for the index of the first Future that is ready
+
+	A Future is a handle; copies share the same result. The result is
+	kept inside the shared state, so there is no allocation for it
+	apart from the state itself
+
+	A Promise is the other end: it sets the value (or an error) of its
+	Future by hand, for instance from a callback
+
+	Mind that calling get() from within a task of a fixed size pool
+	may deadlock, when the task it waits for can't get a worker
+*/
+
+// shared state of a Future and its Promise, without the value
+class FutureStateBase {
+public:
+	FutureStateBase() : mx_(), cond_(), ready_(false), error_(), callbacks_() { }
+
+	FutureStateBase(const FutureStateBase&) = delete;
+	FutureStateBase& operator=(const FutureStateBase&) = delete;
+
+	bool ready(void) const { return ready_.load(std::memory_order_acquire); }
+
+	void wait(void) {
+		if (ready()) {
+			return;
+		}
+		std::unique_lock<std::mutex> lk(mx_);
+		cond_.wait(lk, [this](){ return this->ready_.load(std::memory_order_relaxed); });
+	}
+
+	bool wait_until(const std::chrono::steady_clock::time_point& deadline) {
+		if (ready()) {
+			return true;
+		}
+		std::unique_lock<std::mutex> lk(mx_);
+		return cond_.wait_until(lk, deadline, [this](){ return this->ready_.load(std::memory_order_relaxed); });
+	}
+
+	void set_error(std::exception_ptr e) {
+		std::unique_lock<std::mutex> lk(mx_);
+		check_not_ready();
+		error_ = e;
+		complete(lk);
+	}
+
+	// call cb when ready; right away if it is ready already
+	void on_ready(std::function<void()> cb) {
+		std::unique_lock<std::mutex> lk(mx_);
+		if (!ready_.load(std::memory_order_relaxed)) {
+			callbacks_.push_back(std::move(cb));
+			return;
+		}
+		lk.unlock();
+		cb();
+	}
+
+	// throw the error, if there is one; only after wait()
+	void check_error(void) const {
+		if (error_) {
+			std::rethrow_exception(error_);
+		}
+	}
+
+protected:
+	std::mutex mx_;
+	std::condition_variable cond_;
+	std::atomic<bool> ready_;
+	std::exception_ptr error_;
+	std::vector<std::function<void()> > callbacks_;
+
+	void check_not_ready(void) const {
+		if (ready_.load(std::memory_order_relaxed)) {
+			throw RuntimeError("future is already set");
+		}
+	}
+
+	// the lock must be held; it is released
+	void complete(std::unique_lock<std::mutex>& lk) {
+		ready_.store(true, std::memory_order_release);
+		cond_.notify_all();
+
+		std::vector<std::function<void()> > callbacks;
+		callbacks.swap(callbacks_);
+		lk.unlock();
+
+		for(auto& cb : callbacks) {
+			cb();
+		}
+	}
+};
+
+template <typename T>
+class FutureState : public FutureStateBase {
+public:
+	FutureState() : FutureStateBase(), has_value_(false) { }
+
+	~FutureState() {
+		if (has_value_) {
+			value().~T();
+		}
+	}
+
+	template <typename... Args>
+	void set_value(Args&&... args) {
+		std::unique_lock<std::mutex> lk(mx_);
+		check_not_ready();
+		new(&storage_) T(std::forward<Args>(args)...);
+		has_value_ = true;
+		complete(lk);
+	}
+
+	// only after wait()
+	const T& value(void) const { return *reinterpret_cast<const T *>(&storage_); }
+	T& value(void) { return *reinterpret_cast<T *>(&storage_); }
+
+private:
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+	bool has_value_;
+};
+
+template <>
+class FutureState<void> : public FutureStateBase {
+public:
+	FutureState() : FutureStateBase() { }
+
+	void set_value(void) {
+		std::unique_lock<std::mutex> lk(mx_);
+		check_not_ready();
+		complete(lk);
+	}
+};
+
+// run f and put its result (or exception) into the state
+template <typename R>
+struct FutureRun {
+	template <typename F>
+	static void run(FutureState<R>& state, F& f) {
+		try {
+			state.set_value(f());
+		} catch(...) {
+			state.set_error(std::current_exception());
+		}
+	}
+};
+
+template <>
+struct FutureRun<void> {
+	template <typename F>
+	static void run(FutureState<void>& state, F& f) {
+		try {
+			f();
+		} catch(...) {
+			state.set_error(std::current_exception());
+			return;
+		}
+		state.set_value();
+	}
+};
+
+template <typename T>
+class Future;
+
+// the parts of Future that do not depend on the type of value
+template <typename T>
+class FutureBase : public Base {
+public:
+	FutureBase() : Base(), state_() { }
+	explicit FutureBase(const std::shared_ptr<FutureState<T> >& s) : Base(), state_(s) { }
+
+	std::string repr(void) const { return "<Future>"; }
+
+	bool operator!(void) const { return !valid(); }
+
+	// false for a default constructed Future
+	bool valid(void) const { return state_.get() != nullptr; }
+
+	bool ready(void) const {
+		check_valid();
+		return state_->ready();
+	}
+
+	void wait(void) const {
+		check_valid();
+		state_->wait();
+	}
+
+	template <typename Rep, typename Period>
+	bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+		return wait_until(std::chrono::steady_clock::now() + timeout);
+	}
+
+	bool wait_until(const std::chrono::steady_clock::time_point& deadline) const {
+		check_valid();
+		return state_->wait_until(deadline);
+	}
+
+	// used by when_all(), when_any()
+	void on_ready(std::function<void()> cb) const {
+		check_valid();
+		state_->on_ready(std::move(cb));
+	}
+
+protected:
+	std::shared_ptr<FutureState<T> > state_;
+
+	void check_valid(void) const {
+		if (state_.get() == nullptr) {
+			throw ReferenceError("future has no state");
+		}
+	}
+
+	// chain g, which calls the user's function; returns its Future
+	template <typename R, typename G>
+	Future<R> chain(G g) const {
+		check_valid();
+
+		std::shared_ptr<FutureState<T> > in(state_);
+		std::shared_ptr<FutureState<R> > out = std::make_shared<FutureState<R> >();
+
+		in->on_ready([in, out, g]() {
+			go_pool().submit([in, out, g]() mutable {
+				try {
+					in->check_error();
+				} catch(...) {
+					out->set_error(std::current_exception());
+					return;
+				}
+				auto call = [&in, &g]() { return g(*in); };
+				FutureRun<R>::run(*out, call);
+			});
+		});
+		return Future<R>(out);
+	}
+};
+
+template <typename T>
+class Future : public FutureBase<T> {
+public:
+	Future() : FutureBase<T>() { }
+	explicit Future(const std::shared_ptr<FutureState<T> >& s) : FutureBase<T>(s) { }
+
+	// wait for the value; throws what the function threw
+	const T& get(void) const {
+		this->wait();
+		this->state_->check_error();
+		return this->state_->value();
+	}
+
+	// f is called with the value, as const T&
+	template <typename F>
+	Future<typename std::result_of<F(const T&)>::type> then(F f) const {
+		typedef typename std::result_of<F(const T&)>::type R;
+		return this->template chain<R>([f](FutureState<T>& s) { return f(s.value()); });
+	}
+};
+
+template <>
+class Future<void> : public FutureBase<void> {
+public:
+	Future() : FutureBase<void>() { }
+	explicit Future(const std::shared_ptr<FutureState<void> >& s) : FutureBase<void>(s) { }
+
+	void get(void) const {
+		this->wait();
+		this->state_->check_error();
+	}
+
+	// f takes no arguments
+	template <typename F>
+	Future<typename std::result_of<F()>::type> then(F f) const {
+		typedef typename std::result_of<F()>::type R;
+		return this->template chain<R>([f](FutureState<void>&) { return f(); });
+	}
+};
+
+template <typename T>
+class Promise : public Base {
+public:
+	Promise() : Base(), state_(std::make_shared<FutureState<T> >()) { }
+
+	std::string repr(void) const { return "<Promise>"; }
+
+	bool operator!(void) const { return state_.get() == nullptr; }
+
+	Future<T> future(void) const { return Future<T>(state_); }
+
+	// throws RuntimeError if the value was set already
+	template <typename... Args>
+	void set_value(Args&&... args) { state_->set_value(std::forward<Args>(args)...); }
+
+	void set_error(std::exception_ptr e) { state_->set_error(e); }
+
+private:
+	std::shared_ptr<FutureState<T> > state_;
+};
+
+// used for printing
+template <typename T>
+inline std::ostream& operator<<(std::ostream& os, const Future<T>& f) {
+	os << f.str();
+	return os;
+}
+
+template <typename T>
+inline std::ostream& operator<<(std::ostream& os, const Promise<T>& p) {
+	os << p.str();
+	return os;
+}
+
+// run f(args...) on a pool; returns a Future for its result
+template <typename F, typename... Args>
+Future<typename std::result_of<typename std::decay<F>::type(typename std::decay<Args>::type&...)>::type>
+async_on(ThreadPool& pool, F&& f, Args&&... args) {
+	typedef typename std::result_of<typename std::decay<F>::type(typename std::decay<Args>::type&...)>::type R;
+
+	std::shared_ptr<FutureState<R> > state = std::make_shared<FutureState<R> >();
+	auto bound = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+
+	pool.submit([state, bound]() mutable {
+		FutureRun<R>::run(*state, bound);
+	});
+	return Future<R>(state);
+}
+
+// run f(args...) on go_pool()
+template <typename F, typename... Args>
+Future<typename std::result_of<typename std::decay<F>::type(typename std::decay<Args>::type&...)>::type>
+async(F&& f, Args&&... args) {
+	return async_on(go_pool(), std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+// a Future for all results, in order
+// if any of them failed, it gets the error of the first that failed
+template <typename T>
+Future<Array<T> > when_all(const Array<Future<T> >& futures) {
+	std::shared_ptr<FutureState<Array<T> > > out = std::make_shared<FutureState<Array<T> > >();
+
+	size_t n = futures.len();
+	if (!n) {
+		out->set_value(Array<T>());
+		return Future<Array<T> >(out);
+	}
+
+	struct Gather {
+		std::atomic<size_t> left;
+		Array<Future<T> > futures;
+
+		Gather(size_t n, const Array<Future<T> >& a) : left(n), futures(a) { }
+	};
+	std::shared_ptr<Gather> g = std::make_shared<Gather>(n, futures);
+
+	for(size_t i = 0; i < n; i++) {
+		g->futures[i].on_ready([g, out]() {
+			if (g->left.fetch_sub(1) != 1) {
+				return;
+			}
+			// the last one is in
+			try {
+				Array<T> results;
+				size_t len = g->futures.len();
+				results.grow(len);
+				for(size_t j = 0; j < len; j++) {
+					results.push_back(g->futures[j].get());
+				}
+				out->set_value(std::move(results));
+			} catch(...) {
+				out->set_error(std::current_exception());
+			}
+		});
+	}
+	return Future<Array<T> >(out);
+}
+
+inline Future<void> when_all(const Array<Future<void> >& futures) {
+	std::shared_ptr<FutureState<void> > out = std::make_shared<FutureState<void> >();
+
+	size_t n = futures.len();
+	if (!n) {
+		out->set_value();
+		return Future<void>(out);
+	}
+
+	struct Gather {
+		std::atomic<size_t> left;
+		Array<Future<void> > futures;
+
+		Gather(size_t n, const Array<Future<void> >& a) : left(n), futures(a) { }
+	};
+	std::shared_ptr<Gather> g = std::make_shared<Gather>(n, futures);
+
+	for(size_t i = 0; i < n; i++) {
+		g->futures[i].on_ready([g, out]() {
+			if (g->left.fetch_sub(1) != 1) {
+				return;
+			}
+			try {
+				for(size_t j = 0; j < g->futures.len(); j++) {
+					g->futures[j].get();
+				}
+			} catch(...) {
+				out->set_error(std::current_exception());
+				return;
+			}
+			out->set_value();
+		});
+	}
+	return Future<void>(out);
+}
+
+// a Future for the index of the first Future that is ready
+// (it may have failed; get() on it throws)
+template <typename T>
+Future<size_t> when_any(const Array<Future<T> >& futures) {
+	if (!futures.len()) {
+		throw ValueError("when_any() without futures");
+	}
+
+	std::shared_ptr<FutureState<size_t> > out = std::make_shared<FutureState<size_t> >();
+	std::shared_ptr<std::atomic<bool> > fired = std::make_shared<std::atomic<bool> >(false);
+
+	for(size_t i = 0; i < futures.len(); i++) {
+		futures[i].on_ready([out, fired, i]() {
+			if (!fired->exchange(true)) {
+				out->set_value(i);
+			}
+		});
+	}
+	return Future<size_t>(out);
+}
+
+}	// namespace
+
+#endif	// OOFUTURE_H_WJ114
+
+// EOB
@@ -0,0 +1,558 @@
+/*
+	HashDict.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOHASHDICT_H_WJ114
+#define OOHASHDICT_H_WJ114
+
+#include "oo/Base.h"
+#include "oo/Sizeable.h"
+#include "oo/Error.h"
+#include "oo/String.h"
+#include "oo/StringView.h"
+#include "oo/Array.h"
+#include "oo/compare.h"
+#include "oo/hash.h"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace oo {
+
+/*
+	HashDict is an unordered Dict, implemented as an open addressing
+	hash table (in the style of a "Swiss table")
+
+	Every slot has a control byte; it is either empty, deleted, or it
+	holds the low 7 bits of the hash of the key. A lookup scans the
+	control bytes of a group of 16 slots at once, and only compares
+	keys for slots where those 7 bits match
+
+	Lookups take a HashKey, so searching by const char* or by view
+	does not construct a String. Searching by String uses the hash
+	value that is cached inside the String
+
+	Mind that inserting or deleting invalidates iterators, and
+	pointers to values
+*/
+
+typedef enum {
+	HashCtrlEmpty = -128,
+	HashCtrlDeleted = -2
+} HashCtrl;
+
+const size_t kHashGroupSize = 16;
+
+// a group of control bytes
+class HashGroup {
+public:
+	explicit HashGroup(const int8_t *ctrl) {
+#ifdef __SSE2__
+		ctrl_ = _mm_loadu_si128((const __m128i *)ctrl);
+#else
+		std::memcpy(ctrl_, ctrl, kHashGroupSize);
+#endif
+	}
+
+	// all functions return a bitmask of matching slots
+
+	uint32_t match(int8_t h2) const {
+#ifdef __SSE2__
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(h2)));
+#else
+		uint32_t mask = 0;
+		for(size_t i = 0; i < kHashGroupSize; i++) {
+			if (ctrl_[i] == h2) {
+				mask |= 1U << i;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	uint32_t match_empty(void) const { return match(HashCtrlEmpty); }
+
+	uint32_t match_empty_or_deleted(void) const {
+#ifdef __SSE2__
+		return _mm_movemask_epi8(_mm_cmplt_epi8(ctrl_, _mm_set1_epi8(-1)));
+#else
+		uint32_t mask = 0;
+		for(size_t i = 0; i < kHashGroupSize; i++) {
+			if (ctrl_[i] < -1) {
+				mask |= 1U << i;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	static int next_bit(uint32_t *mask) {
+		int i = __builtin_ctz(*mask);
+		*mask &= *mask - 1;
+		return i;
+	}
+
+private:
+#ifdef __SSE2__
+	__m128i ctrl_;
+#else
+	int8_t ctrl_[kHashGroupSize];
+#endif
+};
+
+// key for lookups in hashed containers
+// it is only used to pass arguments, and should not be stored
+class HashKey {
+public:
+	HashKey(const String& s) : view_(s.view()), hash_(s.hash()) { }
+	HashKey(const StringView& v) : view_(v), hash_(v.hash()) { }
+	HashKey(const char *s) : HashKey(StringView(s)) { }
+	HashKey(const std::string& s) : HashKey(StringView(s)) { }
+
+	const StringView& view(void) const { return view_; }
+	uint64_t hash(void) const { return hash_; }
+
+private:
+	StringView view_;
+	uint64_t hash_;
+};
+
+template <typename E>
+class HashDictIterator {
+public:
+	HashDictIterator(const int8_t *ctrl, E *slot, const int8_t *end) : ctrl_(ctrl), slot_(slot), end_(end) {
+		skip();
+	}
+
+	E& operator*(void) const { return *slot_; }
+	E *operator->(void) const { return slot_; }
+
+	HashDictIterator& operator++(void) {
+		ctrl_++;
+		slot_++;
+		skip();
+		return *this;
+	}
+
+	bool operator==(const HashDictIterator& it) const { return ctrl_ == it.ctrl_; }
+	bool operator!=(const HashDictIterator& it) const { return ctrl_ != it.ctrl_; }
+
+private:
+	const int8_t *ctrl_;
+	E *slot_;
+	const int8_t *end_;
+
+	void skip(void) {
+		while(ctrl_ < end_ && *ctrl_ < 0) {
+			ctrl_++;
+			slot_++;
+		}
+	}
+};
+
+template <typename T>
+class HashDict : public Base, public Sizeable, eq_less_comparable<HashDict<T> > {
+public:
+	typedef T value_type;
+	typedef std::pair<const String, T> entry_type;
+	typedef HashDictIterator<entry_type> iterator;
+	typedef HashDictIterator<const entry_type> const_iterator;
+
+	HashDict() : Base(), Sizeable(), ctrl_(nullptr), slots_(nullptr), cap_(0), size_(0), growth_left_(0) { }
+
+	HashDict(const HashDict<T>& d) : HashDict() {
+		copy(d);
+	}
+
+	HashDict(HashDict<T>&& d) : HashDict() {
+		swap(d);
+	}
+
+	~HashDict() {
+		release();
+	}
+
+	HashDict<T>& operator=(const HashDict<T>& d) {
+		if (this == &d) {
+			return *this;
+		}
+		release();
+		copy(d);
+		return *this;
+	}
+
+	HashDict<T>& operator=(HashDict<T>&& d) {
+		if (this == &d) {
+			return *this;
+		}
+		release();
+		swap(d);
+		return *this;
+	}
+
+	std::string repr(void) const;
+
+	void clear(void) {
+		release();
+	}
+
+	size_t len(void) const { return size_; }
+	size_t cap(void) const { return cap_; }
+
+	bool operator!(void) const { return this->empty(); }
+
+	// make room for at least n items
+	void reserve(size_t n) {
+		if (n > cap_ - cap_ / 8) {
+			rehash(n);
+		}
+	}
+
+	//	like Dict, this never throws KeyError
+	//	any non-existing keys will create a new (empty) item
+	T& operator[](const HashKey& key);
+
+	bool operator==(const HashDict<T>& d) const;
+	bool operator<(const HashDict<T>& d) const { return len() < d.len(); }
+
+	bool has_key(const HashKey& key) const { return lookup(key) != npos; }
+
+	// returns pointer to the value, or nullptr if the key is not present
+	T *find(const HashKey& key) {
+		size_t idx = lookup(key);
+		return (idx == npos) ? nullptr : &slots_[idx].second;
+	}
+
+	const T *find(const HashKey& key) const {
+		size_t idx = lookup(key);
+		return (idx == npos) ? nullptr : &slots_[idx].second;
+	}
+
+	bool del(const HashKey& key);
+
+	Array<String> keys(void) const;
+	Array<T> values(void) const;
+
+	// this enables range-based for-loops
+	// the order of the items is unspecified
+	iterator begin(void) { return iterator(ctrl_, slots_, ctrl_ + cap_); }
+	iterator end(void) { return iterator(ctrl_ + cap_, slots_ + cap_, ctrl_ + cap_); }
+	const_iterator begin(void) const { return cbegin(); }
+	const_iterator end(void) const { return cend(); }
+	const_iterator cbegin(void) const { return const_iterator(ctrl_, slots_, ctrl_ + cap_); }
+	const_iterator cend(void) const { return const_iterator(ctrl_ + cap_, slots_ + cap_, ctrl_ + cap_); }
+
+private:
+	static const size_t npos = (size_t)-1;
+
+	int8_t *ctrl_;			// cap_ control bytes
+	entry_type *slots_;		// cap_ slots
+	size_t cap_;			// 0, or a power of two that is at least kHashGroupSize
+	size_t size_;
+	size_t growth_left_;	// number of inserts before we must rehash
+
+	static int8_t hash_h2(uint64_t h) { return (int8_t)(h & 0x7f); }
+	static size_t hash_h1(uint64_t h) { return (size_t)(h >> 7); }
+
+	static bool key_equal(const String& s, const StringView& key) {
+		return s.len() == key.len() && !std::memcmp(s.c_str(), key.data(), key.len());
+	}
+
+	size_t lookup(const HashKey&) const;
+	size_t find_insert_slot(uint64_t) const;
+	void rehash(size_t);
+	void copy(const HashDict<T>&);
+	void release(void);
+
+	void swap(HashDict<T>& d) {
+		std::swap(ctrl_, d.ctrl_);
+		std::swap(slots_, d.slots_);
+		std::swap(cap_, d.cap_);
+		std::swap(size_, d.size_);
+		std::swap(growth_left_, d.growth_left_);
+	}
+
+	template <typename U>
+	friend std::ostream& operator<<(std::ostream&, const HashDict<U>&);
+};
+
+
+// templated HashDict methods
+
+template <typename T>
+size_t HashDict<T>::lookup(const HashKey& key) const {
+	if (!cap_) {
+		return npos;
+	}
+
+	uint64_t h = key.hash();
+
+	// probe group by group; the step increases by one group every time,
+	// which visits every group when the number of groups is a power of two
+	size_t mask = cap_ / kHashGroupSize - 1;
+	size_t g = hash_h1(h) & mask;
+	int8_t h2 = hash_h2(h);
+
+	for(size_t step = 1; ; step++) {
+		HashGroup group(ctrl_ + g * kHashGroupSize);
+
+		uint32_t m = group.match(h2);
+		while(m) {
+			size_t idx = g * kHashGroupSize + HashGroup::next_bit(&m);
+			if (key_equal(slots_[idx].first, key.view())) {
+				return idx;
+			}
+		}
+		if (group.match_empty()) {
+			return npos;
+		}
+		g = (g + step) & mask;
+	}
+}
+
+template <typename T>
+size_t HashDict<T>::find_insert_slot(uint64_t h) const {
+	size_t mask = cap_ / kHashGroupSize - 1;
+	size_t g = hash_h1(h) & mask;
+
+	for(size_t step = 1; ; step++) {
+		HashGroup group(ctrl_ + g * kHashGroupSize);
+
+		uint32_t m = group.match_empty_or_deleted();
+		if (m) {
+			return g * kHashGroupSize + HashGroup::next_bit(&m);
+		}
+		g = (g + step) & mask;
+	}
+}
+
+template <typename T>
+T& HashDict<T>::operator[](const HashKey& key) {
+	size_t idx = lookup(key);
+	if (idx != npos) {
+		return slots_[idx].second;
+	}
+
+	if (!growth_left_) {
+		// if there are many deleted slots, rehashing at the same size
+		// cleans them out. Otherwise, grow
+		size_t limit = cap_ - cap_ / 8;
+		rehash((size_ + 1 > limit / 2) ? limit + 1 : size_ + 1);
+	}
+
+	uint64_t h = key.hash();
+	idx = find_insert_slot(h);
+	if (ctrl_[idx] == HashCtrlEmpty) {
+		growth_left_--;
+	}
+	new(&slots_[idx]) entry_type(String(key.view()), T());
+	ctrl_[idx] = hash_h2(h);
+	size_++;
+	return slots_[idx].second;
+}
+
+template <typename T>
+bool HashDict<T>::del(const HashKey& key) {
+	size_t idx = lookup(key);
+	if (idx == npos) {
+		return false;
+	}
+
+	slots_[idx].~entry_type();
+	size_--;
+
+	// if the group still has an empty slot, then no lookup ever probed
+	// past this group, and the slot may become empty again
+	// Otherwise it must be marked as deleted, so that lookups go on
+	HashGroup group(ctrl_ + (idx & ~(kHashGroupSize - 1)));
+	if (group.match_empty()) {
+		ctrl_[idx] = HashCtrlEmpty;
+		growth_left_++;
+	} else {
+		ctrl_[idx] = HashCtrlDeleted;
+	}
+	return true;
+}
+
+// rehash for at least n items
+// this also cleans out deleted slots
+template <typename T>
+void HashDict<T>::rehash(size_t n) {
+	// keep the load factor below 7/8
+	size_t new_cap = kHashGroupSize;
+	while(new_cap - new_cap / 8 < n) {
+		new_cap <<= 1;
+	}
+
+	int8_t *old_ctrl = ctrl_;
+	entry_type *old_slots = slots_;
+	size_t old_cap = cap_;
+
+	slots_ = static_cast<entry_type *>(::operator new(new_cap * sizeof(entry_type)));
+	try {
+		ctrl_ = new int8_t[new_cap];
+	} catch(...) {
+		::operator delete(slots_);
+		slots_ = old_slots;
+		throw;
+	}
+	std::memset(ctrl_, HashCtrlEmpty, new_cap);
+	cap_ = new_cap;
+	growth_left_ = new_cap - new_cap / 8 - size_;
+
+	for(size_t i = 0; i < old_cap; i++) {
+		if (old_ctrl[i] < 0) {
+			continue;
+		}
+		String& key = const_cast<String&>(old_slots[i].first);
+		uint64_t h = key.hash();
+		size_t idx = find_insert_slot(h);
+
+		// the old entry is destroyed right away, so it is OK to move the key
+		new(&slots_[idx]) entry_type(std::move(key), std::move(old_slots[i].second));
+		ctrl_[idx] = hash_h2(h);
+		old_slots[i].~entry_type();
+	}
+
+	delete [] old_ctrl;
+	::operator delete(old_slots);
+}
+
+template <typename T>
+void HashDict<T>::copy(const HashDict<T>& d) {
+	if (!d.size_) {
+		return;
+	}
+
+	// same capacity, same layout
+	slots_ = static_cast<entry_type *>(::operator new(d.cap_ * sizeof(entry_type)));
+	ctrl_ = new int8_t[d.cap_];
+	std::memset(ctrl_, HashCtrlEmpty, d.cap_);
+	cap_ = d.cap_;
+	growth_left_ = d.growth_left_;
+
+	for(size_t i = 0; i < cap_; i++) {
+		if (d.ctrl_[i] >= 0) {
+			new(&slots_[i]) entry_type(d.slots_[i]);
+			size_++;
+		}
+		ctrl_[i] = d.ctrl_[i];
+	}
+}
+
+template <typename T>
+void HashDict<T>::release(void) {
+	for(size_t i = 0; i < cap_; i++) {
+		if (ctrl_[i] >= 0) {
+			slots_[i].~entry_type();
+		}
+	}
+	delete [] ctrl_;
+	::operator delete(slots_);
+
+	ctrl_ = nullptr;
+	slots_ = nullptr;
+	cap_ = size_ = growth_left_ = 0;
+}
+
+template <typename T>
+std::string HashDict<T>::repr(void) const {
+	std::stringstream ss;
+	ss << "{";
+
+	for(const_iterator it = cbegin(); it != cend(); ) {
+		ss << '"' << it->first << '"' << ": " << it->second;
+		++it;
+		if (it != cend()) {
+			ss << ", ";
+		}
+	}
+	ss << "}";
+	return ss.str();
+}
+
+template <typename T>
+bool HashDict<T>::operator==(const HashDict<T>& d) const {
+	if (len() != d.len()) {
+		return false;
+	}
+
+	for(const_iterator it = cbegin(); it != cend(); ++it) {
+		const T *value = d.find(it->first);
+		if (value == nullptr) {
+			return false;
+		}
+		if (it->second != *value) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename T>
+Array<String> HashDict<T>::keys(void) const {
+	Array<String> a(len());
+
+	int i = 0;
+	for(const_iterator it = cbegin(); it != cend(); ++it) {
+		a[i++] = it->first;
+	}
+	return a;
+}
+
+template <typename T>
+Array<T> HashDict<T>::values(void) const {
+	Array<T> a(len());
+
+	int i = 0;
+	for(const_iterator it = cbegin(); it != cend(); ++it) {
+		a[i++] = it->second;
+	}
+	return a;
+}
+
+// used for printing
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const HashDict<T>& d) {
+	os << d.str();
+	return os;
+}
+
+}	// namespace
+
+#endif	// OOHASHDICT_H_WJ114
+
+// EOB
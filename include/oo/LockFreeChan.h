@@ -0,0 +1,659 @@
+/*
+	LockFreeChan.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOLOCKFREECHAN_H_WJ114
+#define OOLOCKFREECHAN_H_WJ114
+
+#include "oo/Base.h"
+#include "oo/Sizeable.h"
+#include "oo/Error.h"
+#include "oo/Array.h"
+#include "oo/futex.h"
+#include "oo/types.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace oo {
+
+/*
+	lock-free channels
+	These work like Chan, with put() and get(), but they take no lock
+	As long as the channel is neither full nor empty, put() and get()
+	only do a few atomic operations. A thread only sleeps (on a futex)
+	when it must wait for the other side
+
+	SpscChan is for exactly one writing thread and one reading thread
+	MpmcChan may be used by any number of writers and readers
+
+	write_many() and read_many() move a batch of items with a single
+	atomic operation, and wake up the other side only once. drain()
+	takes whatever is in the channel, without waiting
+
+	The capacity is rounded up to a power of two. A channel can not be
+	resized; len() is only an estimate while the channel is in use
+*/
+
+// spin a little before going to sleep
+const int kLockFreeChanSpin = 64;
+
+inline size_t lockfree_chan_capacity(size_t n) {
+	if (n <= 0) {
+		throw ValueError();
+	}
+	// MpmcChan needs at least two cells, or a full cell would look free
+	size_t cap = 2;
+	while(cap < n) {
+		cap <<= 1;
+	}
+	return cap;
+}
+
+// blocking batch operations, shared by SpscChan and MpmcChan
+
+template <typename C, typename T>
+void lockfree_chan_write_many(C& c, EventCount& not_full, const T *items, size_t n) {
+	int spin = 0;
+	while(n > 0) {
+		size_t count = c.try_write_many(items, n);
+		if (!count) {
+			if (spin < kLockFreeChanSpin) {
+				spin++;
+				continue;
+			}
+			uint32_t key = not_full.prepare_wait();
+			count = c.try_write_many(items, n);
+			if (count) {
+				not_full.cancel_wait();
+			} else {
+				not_full.wait(key);
+				continue;
+			}
+		}
+		items += count;
+		n -= count;
+	}
+}
+
+template <typename C, typename T>
+size_t lockfree_chan_read_many(C& c, EventCount& not_empty, T *items, size_t max, size_t min) {
+	size_t total = 0;
+	int spin = 0;
+	for(;;) {
+		size_t count = c.try_read_many(items + total, max - total);
+		total += count;
+		if (total >= min) {
+			return total;
+		}
+		if (count) {
+			continue;
+		}
+		if (spin < kLockFreeChanSpin) {
+			spin++;
+			continue;
+		}
+		uint32_t key = not_empty.prepare_wait();
+		count = c.try_read_many(items + total, max - total);
+		total += count;
+		if (total >= min) {
+			not_empty.cancel_wait();
+			return total;
+		}
+		if (count) {
+			not_empty.cancel_wait();
+		} else {
+			not_empty.wait(key);
+		}
+	}
+}
+
+template <typename T>
+class SpscChan : public Base, public Sizeable {
+public:
+	typedef T value_type;
+
+	SpscChan(size_t n=1) : Base(), Sizeable(), cap_(lockfree_chan_capacity(n)), mask_(cap_ - 1),
+		buf_(static_cast<T *>(::operator new(cap_ * sizeof(T)))),
+		head_(0), tail_cache_(0), tail_(0), head_cache_(0) { }
+
+	SpscChan(const SpscChan&) = delete;
+
+	virtual ~SpscChan() {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		for(size_t i = head_.load(std::memory_order_relaxed); i != tail; i++) {
+			buf_[i & mask_].~T();
+		}
+		::operator delete(buf_);
+	}
+
+	SpscChan& operator=(const SpscChan&) = delete;
+
+	std::string repr(void) const { return "<SpscChan>"; }
+
+	size_t len(void) const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+	size_t cap(void) const { return cap_; }
+
+	bool operator!(void) const { return empty(); }
+
+	// these return false when the channel is full or empty
+	bool try_put(const T& t) { return try_emplace(t); }
+	bool try_put(T&& t) { return try_emplace(std::move(t)); }
+	bool try_get(T&);
+
+	void put(const T& t) { emplace(t); }
+	void put(T&& t) { emplace(std::move(t)); }
+	T get(void);
+
+	template <typename... Args>
+	bool try_emplace(Args&&...);
+
+	template <typename... Args>
+	void emplace(Args&&...);
+
+	// write n items; blocks until all have been written
+	void write_many(const T *, size_t n);
+
+	// read at least min and at most max items; returns number of items read
+	size_t read_many(T *, size_t max, size_t min=1);
+
+	// append all items in the channel to the array; does not block
+	// returns number of items
+	size_t drain(Array<T>& a) { return take(SIZE_MAX, [&a](T&& t) { a.push_back(std::move(t)); }); }
+
+	// these do not block; they return the number of items written or read
+	size_t try_write_many(const T *, size_t n);
+	size_t try_read_many(T *items, size_t max) { return take(max, [&items](T&& t) { *items++ = std::move(t); }); }
+
+private:
+	const size_t cap_, mask_;
+	T *buf_;
+
+	// keep the reader and writer on separate cache lines
+	alignas(kCacheLineSize) std::atomic<size_t> head_;		// written by the reader
+	size_t tail_cache_;				// reader's copy of tail_
+	EventCount not_empty_;
+	alignas(kCacheLineSize) std::atomic<size_t> tail_;		// written by the writer
+	size_t head_cache_;				// writer's copy of head_
+	EventCount not_full_;
+
+	// move at most max items out, passing each to func
+	template <typename F>
+	size_t take(size_t max, F func);
+};
+
+template <typename T>
+template <typename... Args>
+bool SpscChan<T>::try_emplace(Args&&... args) {
+	size_t tail = tail_.load(std::memory_order_relaxed);
+
+	if (tail - head_cache_ >= cap_) {
+		head_cache_ = head_.load(std::memory_order_acquire);
+		if (tail - head_cache_ >= cap_) {
+			return false;
+		}
+	}
+
+	new(&buf_[tail & mask_]) T(std::forward<Args>(args)...);
+	tail_.store(tail + 1, std::memory_order_release);
+
+	not_empty_.notify();
+	return true;
+}
+
+template <typename T>
+template <typename... Args>
+void SpscChan<T>::emplace(Args&&... args) {
+	// the arguments are only used when the item is really put,
+	// so it's OK to forward them more than once
+	for(int i = 0; i < kLockFreeChanSpin; i++) {
+		if (try_emplace(std::forward<Args>(args)...)) {
+			return;
+		}
+	}
+	for(;;) {
+		uint32_t key = not_full_.prepare_wait();
+		if (try_emplace(std::forward<Args>(args)...)) {
+			not_full_.cancel_wait();
+			return;
+		}
+		not_full_.wait(key);
+	}
+}
+
+template <typename T>
+bool SpscChan<T>::try_get(T& t) {
+	size_t head = head_.load(std::memory_order_relaxed);
+
+	if (head == tail_cache_) {
+		tail_cache_ = tail_.load(std::memory_order_acquire);
+		if (head == tail_cache_) {
+			return false;
+		}
+	}
+
+	T& item = buf_[head & mask_];
+	t = std::move(item);
+	item.~T();
+	head_.store(head + 1, std::memory_order_release);
+
+	not_full_.notify();
+	return true;
+}
+
+template <typename T>
+T SpscChan<T>::get(void) {
+	T t;
+
+	for(int i = 0; i < kLockFreeChanSpin; i++) {
+		if (try_get(t)) {
+			return t;
+		}
+	}
+	for(;;) {
+		uint32_t key = not_empty_.prepare_wait();
+		if (try_get(t)) {
+			not_empty_.cancel_wait();
+			return t;
+		}
+		not_empty_.wait(key);
+	}
+}
+
+template <typename T>
+size_t SpscChan<T>::try_write_many(const T *items, size_t n) {
+	size_t tail = tail_.load(std::memory_order_relaxed);
+
+	size_t room = cap_ - (tail - head_cache_);
+	if (room < n) {
+		head_cache_ = head_.load(std::memory_order_acquire);
+		room = cap_ - (tail - head_cache_);
+	}
+	if (room > n) {
+		room = n;
+	}
+
+	for(size_t i = 0; i < room; i++) {
+		new(&buf_[(tail + i) & mask_]) T(items[i]);
+	}
+	if (room) {
+		tail_.store(tail + room, std::memory_order_release);
+		not_empty_.notify();
+	}
+	return room;
+}
+
+template <typename T>
+template <typename F>
+size_t SpscChan<T>::take(size_t max, F func) {
+	size_t head = head_.load(std::memory_order_relaxed);
+
+	size_t avail = tail_cache_ - head;
+	if (avail < max) {
+		tail_cache_ = tail_.load(std::memory_order_acquire);
+		avail = tail_cache_ - head;
+	}
+	if (avail > max) {
+		avail = max;
+	}
+
+	for(size_t i = 0; i < avail; i++) {
+		T& item = buf_[(head + i) & mask_];
+		func(std::move(item));
+		item.~T();
+	}
+	if (avail) {
+		head_.store(head + avail, std::memory_order_release);
+		not_full_.notify();
+	}
+	return avail;
+}
+
+template <typename T>
+void SpscChan<T>::write_many(const T *items, size_t n) {
+	if (items == nullptr && n > 0) {
+		throw ReferenceError();
+	}
+	lockfree_chan_write_many(*this, not_full_, items, n);
+}
+
+template <typename T>
+size_t SpscChan<T>::read_many(T *items, size_t max, size_t min) {
+	if (items == nullptr) {
+		throw ReferenceError();
+	}
+	if (min > max) {
+		throw ValueError();
+	}
+	return lockfree_chan_read_many(*this, not_empty_, items, max, min);
+}
+
+
+/*
+	MpmcChan is a bounded queue after Dmitry Vyukov
+	Every cell has a sequence number, that tells whether the cell
+	is ready for the writer or for the reader of a given position
+*/
+template <typename T>
+class MpmcChan : public Base, public Sizeable {
+public:
+	typedef T value_type;
+
+	MpmcChan(size_t n=1);
+
+	MpmcChan(const MpmcChan&) = delete;
+
+	virtual ~MpmcChan() {
+		T t;
+		while(try_get(t)) {
+		}
+		delete [] cells_;
+	}
+
+	MpmcChan& operator=(const MpmcChan&) = delete;
+
+	std::string repr(void) const { return "<MpmcChan>"; }
+
+	size_t len(void) const {
+		size_t tail = tail_.load(std::memory_order_acquire);
+		size_t head = head_.load(std::memory_order_acquire);
+		return (tail > head) ? tail - head : 0;
+	}
+	size_t cap(void) const { return cap_; }
+
+	bool operator!(void) const { return empty(); }
+
+	bool try_put(const T& t) { return try_emplace(t); }
+	bool try_put(T&& t) { return try_emplace(std::move(t)); }
+	bool try_get(T&);
+
+	void put(const T& t) { emplace(t); }
+	void put(T&& t) { emplace(std::move(t)); }
+	T get(void);
+
+	template <typename... Args>
+	bool try_emplace(Args&&...);
+
+	template <typename... Args>
+	void emplace(Args&&...);
+
+	// write n items; blocks until all have been written
+	void write_many(const T *, size_t n);
+
+	// read at least min and at most max items; returns number of items read
+	size_t read_many(T *, size_t max, size_t min=1);
+
+	// append all items in the channel to the array; does not block
+	// returns number of items
+	size_t drain(Array<T>& a) { return take(SIZE_MAX, [&a](T&& t) { a.push_back(std::move(t)); }); }
+
+	// these do not block; they return the number of items written or read
+	size_t try_write_many(const T *, size_t n);
+	size_t try_read_many(T *items, size_t max) { return take(max, [&items](T&& t) { *items++ = std::move(t); }); }
+
+private:
+	struct Cell {
+		std::atomic<size_t> seq;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+
+		T *item(void) { return reinterpret_cast<T *>(&data); }
+	};
+
+	const size_t cap_, mask_;
+	Cell *cells_;
+
+	alignas(kCacheLineSize) std::atomic<size_t> tail_;		// next position to write
+	EventCount not_empty_;
+	alignas(kCacheLineSize) std::atomic<size_t> head_;		// next position to read
+	EventCount not_full_;
+
+	template <typename F>
+	size_t take(size_t max, F func);
+};
+
+template <typename T>
+MpmcChan<T>::MpmcChan(size_t n) : Base(), Sizeable(), cap_(lockfree_chan_capacity(n)), mask_(cap_ - 1),
+	cells_(new Cell[cap_]), tail_(0), head_(0) {
+	for(size_t i = 0; i < cap_; i++) {
+		cells_[i].seq.store(i, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+template <typename... Args>
+bool MpmcChan<T>::try_emplace(Args&&... args) {
+	Cell *cell;
+	size_t pos = tail_.load(std::memory_order_relaxed);
+
+	for(;;) {
+		cell = &cells_[pos & mask_];
+		size_t seq = cell->seq.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			// the cell is free; claim the position
+			if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// full
+			return false;
+		} else {
+			// an other writer was first
+			pos = tail_.load(std::memory_order_relaxed);
+		}
+	}
+
+	new(cell->item()) T(std::forward<Args>(args)...);
+	cell->seq.store(pos + 1, std::memory_order_release);
+
+	not_empty_.notify();
+	return true;
+}
+
+template <typename T>
+template <typename... Args>
+void MpmcChan<T>::emplace(Args&&... args) {
+	// the arguments are only used when the item is really put,
+	// so it's OK to forward them more than once
+	for(int i = 0; i < kLockFreeChanSpin; i++) {
+		if (try_emplace(std::forward<Args>(args)...)) {
+			return;
+		}
+	}
+	for(;;) {
+		uint32_t key = not_full_.prepare_wait();
+		if (try_emplace(std::forward<Args>(args)...)) {
+			not_full_.cancel_wait();
+			return;
+		}
+		not_full_.wait(key);
+	}
+}
+
+template <typename T>
+bool MpmcChan<T>::try_get(T& t) {
+	Cell *cell;
+	size_t pos = head_.load(std::memory_order_relaxed);
+
+	for(;;) {
+		cell = &cells_[pos & mask_];
+		size_t seq = cell->seq.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if (diff == 0) {
+			if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// empty
+			return false;
+		} else {
+			pos = head_.load(std::memory_order_relaxed);
+		}
+	}
+
+	T *item = cell->item();
+	t = std::move(*item);
+	item->~T();
+	// the cell is free for the writer of the next round
+	cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+
+	not_full_.notify();
+	return true;
+}
+
+template <typename T>
+T MpmcChan<T>::get(void) {
+	T t;
+
+	for(int i = 0; i < kLockFreeChanSpin; i++) {
+		if (try_get(t)) {
+			return t;
+		}
+	}
+	for(;;) {
+		uint32_t key = not_empty_.prepare_wait();
+		if (try_get(t)) {
+			not_empty_.cancel_wait();
+			return t;
+		}
+		not_empty_.wait(key);
+	}
+}
+
+template <typename T>
+size_t MpmcChan<T>::try_write_many(const T *items, size_t n) {
+	if (!n) {
+		return 0;
+	}
+
+	size_t pos = tail_.load(std::memory_order_relaxed);
+	size_t count;
+
+	for(;;) {
+		// count the free cells, and claim them all at once
+		size_t seq = 0;
+		for(count = 0; count < n; count++) {
+			seq = cells_[(pos + count) & mask_].seq.load(std::memory_order_acquire);
+			if (seq != pos + count) {
+				break;
+			}
+		}
+		if (!count) {
+			if ((intptr_t)seq - (intptr_t)pos < 0) {
+				// full
+				return 0;
+			}
+			pos = tail_.load(std::memory_order_relaxed);
+			continue;
+		}
+		if (tail_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	for(size_t i = 0; i < count; i++) {
+		Cell *cell = &cells_[(pos + i) & mask_];
+		new(cell->item()) T(items[i]);
+		cell->seq.store(pos + i + 1, std::memory_order_release);
+	}
+	not_empty_.notify();
+	return count;
+}
+
+template <typename T>
+template <typename F>
+size_t MpmcChan<T>::take(size_t max, F func) {
+	if (!max) {
+		return 0;
+	}
+
+	size_t pos = head_.load(std::memory_order_relaxed);
+	size_t count;
+
+	for(;;) {
+		size_t seq = 0;
+		for(count = 0; count < max; count++) {
+			seq = cells_[(pos + count) & mask_].seq.load(std::memory_order_acquire);
+			if (seq != pos + count + 1) {
+				break;
+			}
+		}
+		if (!count) {
+			if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+				// empty
+				return 0;
+			}
+			pos = head_.load(std::memory_order_relaxed);
+			continue;
+		}
+		if (head_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	for(size_t i = 0; i < count; i++) {
+		Cell *cell = &cells_[(pos + i) & mask_];
+		T *item = cell->item();
+		func(std::move(*item));
+		item->~T();
+		cell->seq.store(pos + i + mask_ + 1, std::memory_order_release);
+	}
+	not_full_.notify();
+	return count;
+}
+
+template <typename T>
+void MpmcChan<T>::write_many(const T *items, size_t n) {
+	if (items == nullptr && n > 0) {
+		throw ReferenceError();
+	}
+	lockfree_chan_write_many(*this, not_full_, items, n);
+}
+
+template <typename T>
+size_t MpmcChan<T>::read_many(T *items, size_t max, size_t min) {
+	if (items == nullptr) {
+		throw ReferenceError();
+	}
+	if (min > max) {
+		throw ValueError();
+	}
+	return lockfree_chan_read_many(*this, not_empty_, items, max, min);
+}
+
+}	// namespace
+
+#endif	// OOLOCKFREECHAN_H_WJ114
+
+// EOB
@@ -32,6 +32,7 @@
 
 #include "oo/Base.h"
 #include "oo/Error.h"
+#include "oo/lockstat.h"
 
 #include <ostream>
 #include <sstream>
@@ -47,16 +48,21 @@ typedef enum {
 
 // Mutex is based on std::mutex
 // It's basically the same, except that Mutex has an islocked() method
+// A Mutex with a name can be profiled; see lockstat.h
 
 class Mutex : public Base {
 public:
-	Mutex() : Base(), state(MutexUnlocked), m_(std::shared_ptr<std::mutex>(new std::mutex)) { }
+	Mutex() : Base(), state(MutexUnlocked), m_(std::shared_ptr<std::mutex>(new std::mutex)), stat_() { }
 
-	Mutex(const Mutex& m) : Base(), state(m.state), m_(m.m_) { }
+	explicit Mutex(const char *name) : Base(), state(MutexUnlocked), m_(std::shared_ptr<std::mutex>(new std::mutex)),
+		stat_(std::make_shared<LockStat>(name)) { }
+
+	Mutex(const Mutex& m) : Base(), state(m.state), m_(m.m_), stat_(m.stat_) { }
 
 	Mutex(Mutex&& m) : Base() {
 		state = m.state;
 		m_ = std::move(m.m_);
+		stat_ = std::move(m.stat_);
 	}
 
 	virtual ~Mutex() {
@@ -71,12 +77,14 @@ public:
 		}
 		state = m.state;
 		m_ = m.m_;
+		stat_ = m.stat_;
 		return *this;
 	}
 
 	Mutex& operator=(Mutex&& m) {
 		state = m.state;
 		m_ = std::move(m.m_);
+		stat_ = std::move(m.stat_);
 		m.state = MutexUnlocked;
 		return *this;
 	}
@@ -98,9 +106,15 @@ public:
 
 	virtual bool islocked(void) const { return (state == MutexLocked); }
 
+	// the profiling counters; nullptr if the Mutex has no name
+	const LockStat *stat(void) const { return stat_.get(); }
+
 private:
 	MutexState state;
 	std::shared_ptr<std::mutex> m_;
+	std::shared_ptr<LockStat> stat_;	// shared by copies, like the mutex
+
+	void lock_profiled(void);
 
 	friend std::ostream& operator<<(std::ostream&, const Mutex&);
 };
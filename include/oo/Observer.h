@@ -30,36 +30,171 @@
 #ifndef OOOBSERVER_H_WJ112
 #define OOOBSERVER_H_WJ112
 
-#include "oo/Dict.h"
+#include "oo/Error.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <stdlib.h>
 
 namespace oo {
 
+/*
+	events are named by strings, and interned into EventIds
+	The same name always gives the same id, in all NotificationCenters
+	Looking up the id once, and notifying by id, saves a lookup of
+	the name in every notify()
+
+		static const EventId kSaved = event_id("saved");
+		...
+		notify(kSaved);
+
+	Observers are called with the event name; when notifying by id,
+	that is the interned copy, event_name(id)
+*/
+typedef uint32_t EventId;
+
+const EventId kNoEvent = 0;
+
+EventId event_id(const char *);
+
+// returns kNoEvent if the name was never interned
+EventId find_event_id(const char *);
+
+// returns nullptr for an unknown id
+const char *event_name(EventId);
+
 class Observer {
 public:
 	virtual void notify(const char *) = 0;
 };
 
+class ThreadPool;
+class NotifyQueue;
+class NotifyGuard;
+
+// default length of the queue for post()
+const size_t kNotifyQueueLen = 1024;
+
+/*
+	notify() by EventId does not lock, and does not allocate memory
+	notify() by name looks up the id first, under a shared read lock
+	on the table of names; use the id where it matters
+	The observers of all events are in a table that is never changed;
+	adding or removing an observer makes a new table, and swaps it in.
+	Lists of observers that did not change are shared between tables
+	An old table is freed once the notify() calls that might still be
+	looking at it are gone, also when others keep on coming
+
+	It is fine for an observer to add or remove observers; a notify()
+	that is running calls the observers that were there when it began
 
+	post() is the asynchronous notify(): it puts the event in a queue,
+	and returns. A dispatcher thread hands the event to every observer,
+	and the observers run on a thread pool, so a slow observer does
+	not hold up the poster, nor the other observers. Every observer
+	gets its notifications one at a time, in the order they were
+	posted; the ones that piled up while it was busy come in a batch
+
+	Posting an event that is still waiting in the queue does nothing;
+	the two are delivered as one, and the same goes for an event that
+	is waiting for an observer. A coalescing window holds back every
+	event for that long, so that more duplicates are merged
+	An observer has room for queue_len undelivered events; when one
+	falls that far behind, the queue stops moving until it catches up
+	When the queue is full, post() blocks until there is room, and
+	try_post() returns false. An observer that posts never blocks;
+	it could be waiting for itself
+
+		nc.start_async(1024, std::chrono::milliseconds(10));
+		nc.post(kSaved);
+		...
+		nc.flush();		// wait until everything has been delivered
+
+	post() starts asynchronous delivery (with defaults) if need be
+	Observers are called with the interned event name, like notify()
+	by id. An exception from an observer ends the program, as it would
+	in go(). After remove_observer(o), o gets no more notifications;
+	it waits for a delivery to o that is in progress, so that o may
+	be destroyed right after
+
+	stop_async() delivers what was posted, and frees the queue. post(),
+	try_post(), flush() and remove_observer() use the queue without a
+	lock, so none of them may run at the same time as stop_async(), or
+	as the destructor; stop the threads that call them first
+*/
 class NotificationCenter {
 public:
-	~NotificationCenter() { all_observers.clear(); }
+	NotificationCenter();
+	~NotificationCenter();
+
+	NotificationCenter(const NotificationCenter&) = delete;
+	NotificationCenter& operator=(const NotificationCenter&) = delete;
 
 	void add_observer(Observer&, const char *);
+	void add_observer(Observer&, EventId);
+
+	// without event, or with kNoEvent, o is removed for all events
 	void remove_observer(Observer&, const char * = nullptr);
+	void remove_observer(Observer&, EventId);
+
 	void notify(const char *);
+	void notify(EventId);
+
+	// asynchronous delivery; uses go_pool() unless a pool is given
+	void start_async(size_t queue_len = kNotifyQueueLen, std::chrono::milliseconds window = std::chrono::milliseconds(0));
+	void start_async(ThreadPool&, size_t queue_len = kNotifyQueueLen, std::chrono::milliseconds window = std::chrono::milliseconds(0));
+	void stop_async(void);		// see above; not while the queue is in use
+
+	void post(const char *);
+	void post(EventId);
+	bool try_post(const char *);
+	bool try_post(EventId);
+	void flush(void);
 
 private:
-	// dict[event] => array of Observers
-	Dict< Array<Observer *> > all_observers;
+	struct ObserverList {
+		const char *name;				// the interned event name
+		std::vector<Observer *> observers;
+	};
+
+	// table[event id] => observers
+	typedef std::vector<std::shared_ptr<const ObserverList> > ObserverTable;
+
+	std::atomic<const ObserverTable *> table_;
+	std::atomic<uint32_t> epoch_;				// which readers_ a notify() counts in
+	std::atomic<uint32_t> readers_[2];			// number of notify() calls running
+	std::atomic<bool> retired_;					// there are old tables to free
+	std::mutex mx_;								// for changing the table
+	std::vector<const ObserverTable *> old_tables_[2];	// retired in epoch 0 or 1
+	std::atomic<NotifyQueue *> async_;			// nullptr if not started
+
+	const ObserverList *observers(EventId) const;
+	void publish(ObserverTable *);
+	void reclaim(void);
+	void try_reclaim(void);
+	void remove_observer_(Observer&, EventId);
+	NotifyQueue *async_queue(void);
+
+	friend class NotifyQueue;
+	friend class NotifyGuard;
 };
 
 extern NotificationCenter defaultNotificationCenter;
 
 void add_observer(Observer&, const char *);
+void add_observer(Observer&, EventId);
 void remove_observer(Observer&, const char * = nullptr);
+void remove_observer(Observer&, EventId);
 void notify(const char *);
+void notify(EventId);
+void post(const char *);
+void post(EventId);
 
 }	// namespace oo
 
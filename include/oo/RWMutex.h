@@ -0,0 +1,307 @@
+/*
+	RWMutex.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OORWMUTEX_H_WJ114
+#define OORWMUTEX_H_WJ114
+
+#include "oo/Base.h"
+#include "oo/futex.h"
+#include "oo/types.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+namespace oo {
+
+// tell the CPU that we are in a spin loop
+inline void cpu_relax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield" ::: "memory");
+#else
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+/*
+	SpinMutex is a lightweight mutex that spins for a while
+	before it goes to sleep on a futex
+
+	Most critical sections are short, and the owner will let go of
+	the lock before a sleeping thread could even be woken up. How
+	long to spin is learned from how long it took before, like
+	glibc's adaptive mutexes. On a single CPU it never spins, since
+	the owner can not run while we do
+
+	It is not recursive, and it can not be copied
+	It has lock(), unlock() and try_lock(), so it works with
+	std::lock_guard and std::unique_lock
+*/
+class SpinMutex : public Base {
+public:
+	SpinMutex() : Base(), state_(kUnlocked), spins_(0) { }
+
+	SpinMutex(const SpinMutex&) = delete;
+	SpinMutex& operator=(const SpinMutex&) = delete;
+
+	std::string repr(void) const {
+		if (islocked()) {
+			return "<SpinMutex: locked>";
+		}
+		return "<SpinMutex>";
+	}
+
+	bool operator!(void) const { return !islocked(); }
+
+	void lock(void) {
+		uint32_t s = kUnlocked;
+		if (!state_.compare_exchange_strong(s, kLocked, std::memory_order_acquire, std::memory_order_relaxed)) {
+			lock_slow();
+		}
+	}
+
+	void unlock(void) {
+		if (state_.exchange(kUnlocked, std::memory_order_release) == kContended) {
+			futex_wake(&state_, 1);
+		}
+	}
+
+	bool try_lock(void) {
+		uint32_t s = kUnlocked;
+		return state_.compare_exchange_strong(s, kLocked, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	// same as try_lock(); the name that Mutex uses
+	bool trylock(void) { return try_lock(); }
+
+	bool islocked(void) const { return state_.load(std::memory_order_relaxed) != kUnlocked; }
+
+private:
+	// kContended means "locked, and maybe somebody sleeps on it"
+	static const uint32_t kUnlocked = 0;
+	static const uint32_t kLocked = 1;
+	static const uint32_t kContended = 2;
+
+	static const int kMaxSpins = 1000;
+
+	void lock_slow(void);
+
+	std::atomic<uint32_t> state_;
+	std::atomic<int> spins_;		// average number of spins it took; only a hint
+};
+
+/*
+	RWMutex is a reader-writer lock: any number of readers, or one writer
+
+	It prefers writers: once a writer asks for the lock, new readers
+	have to wait until it is done. So a steady stream of readers can
+	not starve out a writer; it is meant for tables that are read all
+	the time, and updated every now and then
+
+	Readers that do not have to wait cost only one atomic operation
+	to lock and one to unlock. Writers take turns on a SpinMutex
+
+		RWMutex mx;
+		{
+			ReadLock lk(mx);
+			... look up things
+		}
+		{
+			WriteLock lk(mx);
+			... change things
+		}
+
+	It is not recursive; a reader that asks for the lock again while a
+	writer waits will deadlock. It can not be copied
+*/
+class RWMutex : public Base {
+public:
+	RWMutex() : Base(), state_(0), writer_seq_(0), wmx_() { }
+
+	RWMutex(const RWMutex&) = delete;
+	RWMutex& operator=(const RWMutex&) = delete;
+
+	std::string repr(void) const;
+
+	bool operator!(void) const { return state_.load(std::memory_order_relaxed) == 0; }
+
+	// exclusive
+	void lock(void);
+	void unlock(void);
+	bool try_lock(void);
+
+	// shared
+	void lock_shared(void) {
+		uint32_t s = state_.load(std::memory_order_relaxed);
+		if ((s & kWriter) || !state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+			lock_shared_slow();
+		}
+	}
+
+	void unlock_shared(void) {
+		uint32_t s = state_.fetch_sub(1, std::memory_order_release);
+		if ((s & kWriter) && (s & kReaderMask) == 1) {
+			// last reader out; the writer may go
+			wake_writer();
+		}
+	}
+
+	bool try_lock_shared(void);
+
+	uint32_t readers(void) const { return state_.load(std::memory_order_relaxed) & kReaderMask; }
+	bool islocked(void) const { return (state_.load(std::memory_order_relaxed) & kWriter) != 0; }
+
+private:
+	static const uint32_t kWriter = 0x80000000U;			// writer has, or is waiting for, the lock
+	static const uint32_t kReadersParked = 0x40000000U;		// readers sleep on state_
+	static const uint32_t kReaderMask = 0x3fffffffU;
+
+	void lock_shared_slow(void);
+	void wake_writer(void);
+
+	std::atomic<uint32_t> state_;
+	std::atomic<uint32_t> writer_seq_;		// the writer sleeps on this
+	SpinMutex wmx_;							// one writer at a time
+};
+
+// RAII guards for RWMutex
+
+class ReadLock {
+public:
+	explicit ReadLock(RWMutex& m) : m_(m) { m_.lock_shared(); }
+	~ReadLock() { m_.unlock_shared(); }
+
+	ReadLock(const ReadLock&) = delete;
+	ReadLock& operator=(const ReadLock&) = delete;
+
+private:
+	RWMutex& m_;
+};
+
+class WriteLock {
+public:
+	explicit WriteLock(RWMutex& m) : m_(m) { m_.lock(); }
+	~WriteLock() { m_.unlock(); }
+
+	WriteLock(const WriteLock&) = delete;
+	WriteLock& operator=(const WriteLock&) = delete;
+
+private:
+	RWMutex& m_;
+};
+
+/*
+	StripedLock guards a big table with N locks rather than one
+	A key is hashed onto one of the locks, so threads that work on
+	different keys mostly do not get in each other's way. Each lock
+	sits on a cache line of its own
+
+		StripedLock<64> locks;
+		...
+		std::lock_guard<SpinMutex> lk(locks[key]);
+
+	N must be a power of two. M may be any kind of mutex, for example
+	RWMutex for a read-mostly table
+	lock_all() takes all locks, always in the same order, so that two
+	threads doing lock_all() do not deadlock
+*/
+template <size_t N, typename M = SpinMutex>
+class StripedLock : public Base {
+public:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "StripedLock: N must be a power of two");
+
+	StripedLock() : Base() { }
+
+	StripedLock(const StripedLock&) = delete;
+	StripedLock& operator=(const StripedLock&) = delete;
+
+	std::string repr(void) const { return "<StripedLock>"; }
+
+	bool operator!(void) const { return false; }
+
+	size_t len(void) const { return N; }
+
+	template <typename K>
+	size_t index(const K& key) const {
+		// std::hash of an integer is the integer itself;
+		// mix it, or keys that are multiples of N all map onto one lock
+		uint64_t h = (uint64_t)std::hash<K>()(key) * 0x9e3779b97f4a7c15ULL;
+		return (size_t)(h >> 32) & (N - 1);
+	}
+
+	template <typename K>
+	M& operator[](const K& key) { return stripes_[index(key)].lock; }
+
+	M& at(size_t idx) { return stripes_[idx & (N - 1)].lock; }
+
+	void lock_all(void) {
+		for(size_t i = 0; i < N; i++) {
+			stripes_[i].lock.lock();
+		}
+	}
+
+	void unlock_all(void) {
+		for(size_t i = N; i > 0; i--) {
+			stripes_[i - 1].lock.unlock();
+		}
+	}
+
+private:
+	struct alignas(kCacheLineSize) Stripe {
+		M lock;
+	};
+
+	Stripe stripes_[N];
+};
+
+// used for printing
+inline std::ostream& operator<<(std::ostream& os, const SpinMutex& m) {
+	os << m.str();
+	return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const RWMutex& m) {
+	os << m.str();
+	return os;
+}
+
+template <size_t N, typename M>
+std::ostream& operator<<(std::ostream& os, const StripedLock<N, M>& s) {
+	os << s.str();
+	return os;
+}
+
+}	// namespace
+
+#endif	// OORWMUTEX_H_WJ114
+
+// EOB
@@ -136,7 +136,7 @@ private:
 
 	String subject_;
 
-	void prepare_(const String&, const pcre *, const pcre_extra *);
+	void prepare_(const StringView&, const pcre *, const pcre_extra *);
 	void exec_(const pcre *, const pcre_extra *, int);
 
 	friend class Regex;
@@ -203,12 +203,12 @@ public:
 
 	void compile(int options=0);	// 'studies' the regex
 
-	Match match(const String& s, int options=0) {
+	Match match(const StringView& s, int options=0) {
 		return search(s, options|PCRE_ANCHORED);
 	}
 
-	Match search(const String&, int options=0);
-	Array<Array<String> > findall(const String&, int options=0);
+	Match search(const StringView&, int options=0);
+	Array<Array<String> > findall(const StringView&, int options=0);
 	String sub(const String&, const String&, int count=0, int options=0);
 	Array<String> split(const String&, int count=0, int options=0);
 	String escape(void) const;
@@ -0,0 +1,205 @@
+/*
+	Select.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOSELECT_H_WJ114
+#define OOSELECT_H_WJ114
+
+#include "oo/Chan.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace oo {
+
+/*
+	Select waits on several channels at once, like Go's select statement
+
+		Select sel;
+		int a = sel.read(chan1, x);
+		int b = sel.read(chan2, y, &ok);
+		int c = sel.write(chan3, z);
+
+		int which = sel.wait();
+		if (which == a) ...
+
+	wait() blocks until one of the cases can be done, does it, and
+	returns its number. wait_for() and wait_until() return -1 if the
+	timeout passes, and try_wait() returns -1 if no case is ready
+	(like a "default:" case in Go)
+
+	A read case on a closed channel is ready right away; it sets ok to
+	false (if ok was given). A write case on a closed channel throws
+	RuntimeError. Since a closed channel is always ready, disable()
+	its case once you are done with it (like setting the channel to nil
+	in Go). When several cases are ready, they take turns
+
+	The waiting thread sleeps; the channels wake it up when something
+	changes. A Select can be reused; call wait() again for the next item
+*/
+
+class SelectCase {
+public:
+	virtual ~SelectCase() { }
+
+	// do the operation if possible
+	virtual bool try_complete(void) = 0;
+
+	// register with the channel; returns true if the case is ready already
+	virtual bool arm(SelectWaiter *) = 0;
+	virtual void disarm(SelectWaiter *) = 0;
+};
+
+template <typename T>
+class SelectRead : public SelectCase {
+public:
+	SelectRead(Chan<T>& c, T& t, bool *ok) : c_(c), t_(t), ok_(ok) { }
+
+	bool try_complete(void) {
+		std::lock_guard<std::mutex> lk(c_.mx_);
+
+		if (c_.len_ > 0) {
+			c_.pop(t_);
+			c_.notify_writers(1);
+			set_ok(true);
+			return true;
+		}
+		if (c_.closed_) {
+			set_ok(false);
+			return true;
+		}
+		return false;
+	}
+
+	bool arm(SelectWaiter *w) {
+		std::lock_guard<std::mutex> lk(c_.mx_);
+		c_.add_selector(w);
+		return c_.len_ > 0 || c_.closed_;
+	}
+
+	void disarm(SelectWaiter *w) {
+		c_.remove_selector(w);
+	}
+
+private:
+	Chan<T>& c_;
+	T& t_;
+	bool *ok_;
+
+	void set_ok(bool ok) {
+		if (ok_ != nullptr) {
+			*ok_ = ok;
+		}
+	}
+};
+
+template <typename T>
+class SelectWrite : public SelectCase {
+public:
+	SelectWrite(Chan<T>& c, const T& t) : c_(c), t_(t) { }
+
+	bool try_complete(void) {
+		std::lock_guard<std::mutex> lk(c_.mx_);
+
+		c_.check_closed();
+		if (c_.len_ < c_.cap_) {
+			c_.push(t_);
+			c_.notify_readers(1);
+			return true;
+		}
+		return false;
+	}
+
+	bool arm(SelectWaiter *w) {
+		std::lock_guard<std::mutex> lk(c_.mx_);
+		c_.add_selector(w);
+		return c_.len_ < c_.cap_ || c_.closed_;
+	}
+
+	void disarm(SelectWaiter *w) {
+		c_.remove_selector(w);
+	}
+
+private:
+	Chan<T>& c_;
+	const T& t_;
+};
+
+class Select {
+public:
+	Select() : cases_(), enabled_(), next_(0) { }
+
+	Select(const Select&) = delete;
+	Select& operator=(const Select&) = delete;
+
+	// add cases; these return the number of the case
+	// mind that the variables are used by reference, and must stay alive
+	template <typename T>
+	int read(Chan<T>& c, T& t, bool *ok = nullptr) {
+		return add(new SelectRead<T>(c, t, ok));
+	}
+
+	template <typename T>
+	int write(Chan<T>& c, const T& t) {
+		return add(new SelectWrite<T>(c, t));
+	}
+
+	// a temporary would be gone by the time wait() writes it
+	template <typename T>
+	int write(Chan<T>&, const T&&) = delete;
+
+	// skip a case from now on, or take it back in
+	void disable(int);
+	void enable(int);
+
+	int wait(void);
+	int try_wait(void);
+
+	template <typename Rep, typename Period>
+	int wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+		return wait_until(std::chrono::steady_clock::now() + timeout);
+	}
+
+	int wait_until(const std::chrono::steady_clock::time_point&);
+
+private:
+	std::vector<std::unique_ptr<SelectCase> > cases_;
+	std::vector<bool> enabled_;
+	size_t next_;			// where to start, so that cases take turns
+
+	int add(SelectCase *);
+	int wait_(const std::chrono::steady_clock::time_point *);
+	void disarm(SelectWaiter *, size_t);
+};
+
+}	// namespace
+
+#endif	// OOSELECT_H_WJ114
+
+// EOB
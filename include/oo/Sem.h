@@ -34,6 +34,11 @@
 #include "oo/Error.h"
 #include "oo/String.h"
 
+#include "oo/futex.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <sstream>
 #include <ostream>
 #include <memory>
@@ -143,12 +148,170 @@ private:
 	friend std::ostream& operator<<(std::ostream&, const Sem&);
 };
 
+/*
+	FastSem is a counting semaphore for threads of the same process
+
+	It is an atomic counter; wait() and post() only make a system call
+	(on a futex) when a thread actually has to sleep, or has to be woken
+	up. So it is much cheaper than Sem, which is a named semaphore that
+	lives in the filesystem
+
+	It can not be copied, and it can not be shared with child processes;
+	use SharedSem for that
+*/
+class FastSem : public Base {
+public:
+	explicit FastSem(uint32_t value = 0) : Base(), value_(value), waiters_(0) { }
+
+	FastSem(const FastSem&) = delete;
+	FastSem& operator=(const FastSem&) = delete;
+
+	std::string repr(void) const {
+		std::stringstream ss;
+		ss << "<FastSem: " << value() << ">";
+		return ss.str();
+	}
+
+	bool operator!(void) const { return value() == 0; }
+
+	void wait(void) {
+		if (!trywait()) {
+			wait_slow();
+		}
+	}
+
+	void post(void) {
+		// pairs with the waiters_ increment in wait_slow();
+		// either we see the waiter, or the waiter sees the new value
+		value_.fetch_add(1, std::memory_order_seq_cst);
+		if (waiters_.load(std::memory_order_seq_cst) > 0) {
+			futex_wake(&value_, 1);
+		}
+	}
+
+	bool trywait(void) {
+		uint32_t v = value_.load(std::memory_order_relaxed);
+		while(v > 0) {
+			if (value_.compare_exchange_weak(v, v - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// returns false if the timeout passed
+	template <typename Rep, typename Period>
+	bool timedwait(const std::chrono::duration<Rep, Period>& timeout) {
+		if (trywait()) {
+			return true;
+		}
+		return timedwait_slow(std::chrono::steady_clock::now() + timeout);
+	}
+
+	uint32_t value(void) const { return value_.load(std::memory_order_relaxed); }
+
+	// also known as ...
+	void signal(void) { post(); }
+
+	void P(void) { wait(); }
+	void V(void) { post(); }
+
+	void acquire(void) { wait(); }
+	void release(void) { post(); }
+
+	void down(void) { wait(); }
+	void up(void) { post(); }
+
+private:
+	std::atomic<uint32_t> value_;
+	std::atomic<uint32_t> waiters_;		// number of threads in wait_slow()
+
+	void wait_slow(void);
+	bool timedwait_slow(const std::chrono::steady_clock::time_point&);
+};
+
+/*
+	SharedSem is an unnamed semaphore in shared memory
+	Create it before child(), and parent and children can use it to
+	synchronize; it does not leave anything behind in the filesystem,
+	not even when a process crashes
+
+	Copies refer to the same semaphore. Only the process that created
+	it destroys it
+	Not all systems have unnamed semaphores (OSX does not); there the
+	constructor throws OSError
+*/
+class SharedSem : public Base {
+public:
+	SharedSem() : Base(), sem_() { }
+	explicit SharedSem(unsigned int value);
+
+	SharedSem(const SharedSem& s) : Base(), sem_(s.sem_) { }
+	SharedSem(SharedSem&& s) : Base(), sem_(std::move(s.sem_)) { }
+
+	SharedSem& operator=(const SharedSem& s) {
+		sem_ = s.sem_;
+		return *this;
+	}
+
+	SharedSem& operator=(SharedSem&& s) {
+		sem_ = std::move(s.sem_);
+		return *this;
+	}
+
+	std::string repr(void) const;
+
+	void clear(void) { sem_.reset(); }
+
+	bool operator!(void) const { return (sem_.get() == nullptr); }
+
+	void wait(void);
+	void post(void);
+	bool trywait(void);
+
+	// returns false if the timeout passed
+	template <typename Rep, typename Period>
+	bool timedwait(const std::chrono::duration<Rep, Period>& timeout) {
+		return timedwait_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout));
+	}
+
+	int value(void) const;
+
+	// also known as ...
+	void signal(void) { post(); }
+
+	void P(void) { wait(); }
+	void V(void) { post(); }
+
+	void acquire(void) { wait(); }
+	void release(void) { post(); }
+
+	void down(void) { wait(); }
+	void up(void) { post(); }
+
+private:
+	std::shared_ptr<sem_t> sem_;
+
+	bool timedwait_ns(std::chrono::nanoseconds);
+	sem_t *get(void) const;
+};
+
 // used for printing
 inline std::ostream& operator<<(std::ostream& os, const Sem& sem) {
 	os << sem.str();
 	return os;
 }
 
+inline std::ostream& operator<<(std::ostream& os, const FastSem& sem) {
+	os << sem.str();
+	return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const SharedSem& sem) {
+	os << sem.str();
+	return os;
+}
+
 }	// namespace
 
 #endif	// OOSEM_H_WJ112
@@ -65,6 +65,7 @@ public:
 // map/filter/reduce functionality
 // Note how the class T does not need to be a Sequence<T> ...
 // Class T must however implement iterators and method push_back()
+// For parallel versions that work on Array, see parallel.h
 
 // apply function to every member of T a
 // T is a collection like Array<T> or List<T>
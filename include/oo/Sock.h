@@ -112,7 +112,7 @@ public:
 	String readline(void) { return f_.readline(); }
 	Array<String> readlines(void) { return f_.readlines(); }
 	size_t read(void *v, size_t n) { return f_.read(v, n); }
-	void write(const String& s) { return f_.write(s); }
+	void write(const StringView& s) { return f_.write(s); }
 	void writelines(const Array<String>& a) { return f_.writelines(a); }
 	void write(void *v, size_t n) { return f_.write(v, n); }
 
@@ -32,51 +32,57 @@
 
 #include "oo/Base.h"
 #include "oo/Sizeable.h"
+#include "oo/StringView.h"
 #include "oo/Error.h"
 #include "oo/Array.h"
 #include "oo/compare.h"
+#include "oo/numconv.h"
+#include "oo/hash.h"
 #include "oo/types.h"
 
+#include <atomic>
+#include <cfloat>
 #include <cstdarg>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <ostream>
 #include <sstream>
 #include <istream>
+#include <limits>
+#include <type_traits>
 
 namespace oo {
 
 class String;
 
+template <typename T>
+class Dict;
+
 extern const String kStringStripDefaultCharSet;
 extern const size_t kSmallestString;
 
 
 class String : public Base, public Sizeable, eq_less_comparable<String> {
 public:
-	String() : Base(), Sizeable(), s_len(0), s_cap(kSmallestString) {
-		s_data = new char[kSmallestString];
-		*s_data = 0;
+	String() : Base(), Sizeable(), s_len(0), s_cap(kInlineSize), s_data(s_buf) {
+		*s_buf = 0;
 	}
 
 	String(const String&);
 	String(const std::string&);
 	String(const char *);
 	String(const char *, size_t);
+	String(const StringView& v) : String(v.data(), v.len()) { }
 	String(const rune *);
 	String(rune);
 
 	String(String&& s) : Base(), Sizeable() {
-		s_data = s.s_data;
-		s_cap = s.s_cap;
-		s_len = s.s_len;
-
-		s.s_data = nullptr;
-		s.s_cap = s.s_len = 0;
+		take(s);
 	}
 
 	~String() {
-		if (s_data != nullptr) {
+		if (s_data != s_buf) {
 			delete [] s_data;
 		}
 	}
@@ -86,40 +92,32 @@ public:
 			return *this;
 		}
 
-		if (s_data != nullptr) {
-			delete [] s_data;
+		// reuse the buffer we already have, if it's large enough
+		if (s.s_len >= s_cap) {
+			release();
+			alloc(s.s_len + 1);
 		}
-
+		std::memcpy(s_data, s.s_data, s.s_len + 1);
 		s_len = s.s_len;
-		s_cap = s.s_cap;
-		s_data = new char[s_cap];
-		std::memcpy(s_data, s.s_data, s_cap);
+		s_hash.store(s.s_hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
 		return *this;
 	}
 
 	String& operator=(String&& s) {
-		s_data = s.s_data;
-		s_cap = s.s_cap;
-		s_len = s.s_len;
+		if (this == &s) {
+			return *this;
+		}
 
-		s.s_data = nullptr;
-		s.s_cap = s.s_len = 0;
+		release();
+		take(s);
 		return *this;
 	}
 
 	void clear(void) {
-		if (s_cap <= kSmallestString) {
-			*s_data = 0;
-			s_len = 0;
-			return;
-		}
-
-		delete [] s_data;
-
-		s_cap = kSmallestString;
-		s_data = new char[s_cap];
+		release();
 		*s_data = 0;
 		s_len = 0;
+		invalidate_hash();
 	}
 
 	std::string repr(void) const {
@@ -159,7 +157,13 @@ public:
 		if (s_len != s.s_len) {
 			return false;
 		}
-		return (std::strcmp(s_data, s.s_data) == 0);
+		// if both hashes are known, they must be the same
+		uint64_t h1 = s_hash.load(std::memory_order_relaxed);
+		uint64_t h2 = s.s_hash.load(std::memory_order_relaxed);
+		if (h1 && h2 && h1 != h2) {
+			return false;
+		}
+		return (std::memcmp(s_data, s.s_data, s_len) == 0);
 	}
 
 	bool operator<(const String& s) const {
@@ -168,15 +172,15 @@ public:
 
 	bool operator!(void) const { return s_len == 0; }
 
-	int find(rune, int=0, int=0) const;
-	int rfind(rune, int=0, int=0) const;
+	int find(rune r, int start=0, int end=0) const { return view().find(r, start, end); }
+	int rfind(rune r, int start=0, int end=0) const { return view().rfind(r, start, end); }
 
-	int find(const String&, int=0, int=0) const;
-	int rfind(const String&, int=0, int=0) const;
+	int find(const StringView& s, int start=0, int end=0) const { return view().find(s, start, end); }
+	int rfind(const StringView& s, int start=0, int end=0) const { return view().rfind(s, start, end); }
 
-	String strip(const String& charset=kStringStripDefaultCharSet) const;
-	String lstrip(const String& charset=kStringStripDefaultCharSet) const;
-	String rstrip(const String& charset=kStringStripDefaultCharSet) const;
+	String strip(const StringView& charset=kStringStripDefaultCharSet) const;
+	String lstrip(const StringView& charset=kStringStripDefaultCharSet) const;
+	String rstrip(const StringView& charset=kStringStripDefaultCharSet) const;
 
 	// these only work correctly for English text ...
 	String upper(void) const;
@@ -193,9 +197,19 @@ public:
 		return slice(start, num);
 	}
 
-	String replace(const String&, const String&, int n=-1) const;
+	String replace(const StringView&, const StringView&, int n=-1) const;
+
+	// replace all keys in the Dict by their values, in a single scan
+	// where keys overlap, the longest match wins
+	String replace_many(const Dict<String>&) const;
 
 	Array<String> split(rune=' ') const;
+	Array<String> split(const StringView&) const;
+
+	// lazy split; yields views into this String, without copying
+	SplitIter isplit(rune sep=' ') const { return SplitIter(view(), sep); }
+	SplitIter isplit(const StringView& sep) const { return SplitIter(view(), sep); }
+	SplitIter isplitlines(void) const { return SplitIter(view()); }
 
 	// this method should have been a static ... but this is how Python does it, too
 	String join(const Array<String>&, rune=' ') const;
@@ -203,9 +217,90 @@ public:
 
 	const char *c_str(void) const { return s_data; }
 
+	// hash value, as used by the hashed containers
+	// it is computed once and kept until the String is modified
+	uint64_t hash(void) const {
+		uint64_t h = s_hash.load(std::memory_order_relaxed);
+		if (!h) {
+			h = hash_bytes(s_data, s_len);
+			s_hash.store(h, std::memory_order_relaxed);
+		}
+		return h;
+	}
+
+	// format a number (locale-free)
+	static String from(int v) { return from((long long)v); }
+	static String from(long v) { return from((long long)v); }
+	static String from(long long v) {
+		char buf[kFormatNumberSize];
+		return String(buf, format_int(v, buf));
+	}
+	static String from(unsigned int v) { return from((unsigned long long)v); }
+	static String from(unsigned long v) { return from((unsigned long long)v); }
+	static String from(unsigned long long v) {
+		char buf[kFormatNumberSize];
+		return String(buf, format_uint(v, buf));
+	}
+	static String from(double v) {
+		char buf[kFormatNumberSize];
+		return String(buf, format_double(v, buf));
+	}
+
+	// a String can be passed wherever a StringView is expected
+	StringView view(void) const { return StringView(s_data, s_len); }
+	operator StringView() const { return view(); }
+
 private:
+	// short strings are kept in s_buf and need no heap allocation
+	enum { kInlineSize = 16 };
+
 	size_t s_len, s_cap;
 	char *s_data;
+	char s_buf[kInlineSize];
+	mutable std::atomic<uint64_t> s_hash{0};	// zero means not yet computed
+
+	void invalidate_hash(void) { s_hash.store(0, std::memory_order_relaxed); }
+
+	// allocate a buffer of size n; short strings use the inline buffer
+	void alloc(size_t n) {
+		if (n <= kInlineSize) {
+			s_data = s_buf;
+			s_cap = kInlineSize;
+		} else {
+			s_data = new char[n];
+			s_cap = n;
+		}
+	}
+
+	// free the heap buffer (if any) and fall back to the inline buffer
+	void release(void) {
+		if (s_data != s_buf) {
+			delete [] s_data;
+			s_data = s_buf;
+			s_cap = kInlineSize;
+		}
+	}
+
+	// move contents of s into this String, leaving s empty
+	void take(String& s) {
+		s_len = s.s_len;
+		s_hash.store(s.s_hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		s.invalidate_hash();
+
+		if (s.s_data == s.s_buf) {
+			s_data = s_buf;
+			s_cap = kInlineSize;
+			std::memcpy(s_buf, s.s_buf, s.s_len + 1);
+		} else {
+			s_data = s.s_data;
+			s_cap = s.s_cap;
+
+			s.s_data = s.s_buf;
+			s.s_cap = kInlineSize;
+		}
+		*s.s_data = 0;
+		s.s_len = 0;
+	}
 
 	static void utf8_encode(const rune *, char *, size_t);
 	static size_t utf8_encoded_len(rune);
@@ -221,18 +316,78 @@ inline std::ostream& operator<<(std::ostream& os, const String& s) {
 }
 
 // convert string to different type (like an int)
-// thanks to stackoverflow.com
+// numbers go through the fast, locale-free parsers in numconv.h
+// anything else is read with a std::istringstream
+
+// integer types, but not bool and not the character types
 template <typename T>
-T convert(const std::string& s) {
-	std::istringstream iss(s);
-	T v;
+struct is_convertible_int : std::integral_constant<bool,
+	std::is_integral<T>::value && !std::is_same<T, bool>::value
+	&& !std::is_same<T, char>::value && !std::is_same<T, signed char>::value
+	&& !std::is_same<T, unsigned char>::value && !std::is_same<T, wchar_t>::value
+	&& !std::is_same<T, char16_t>::value && !std::is_same<T, char32_t>::value> { };
+
+template <typename T, typename Enable = void>
+struct Converter {
+	static T convert(const StringView& s) {
+		// thanks to stackoverflow.com
+		std::istringstream iss(s.str());
+		T v;
+
+		iss >> std::ws >> v >> std::ws;
+
+		if (!iss.eof()) {
+			throw ValueError();
+		}
+		return v;
+	}
+};
 
-	iss >> std::ws >> v >> std::ws;
+template <typename T>
+struct Converter<T, typename std::enable_if<is_convertible_int<T>::value && std::is_signed<T>::value>::type> {
+	static T convert(const StringView& s) {
+		int64_t v;
+		if (!parse_int(s, v) || v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max()) {
+			throw ValueError();
+		}
+		return (T)v;
+	}
+};
 
-	if (!iss.eof()) {
-		throw ValueError();
+template <typename T>
+struct Converter<T, typename std::enable_if<is_convertible_int<T>::value && std::is_unsigned<T>::value>::type> {
+	static T convert(const StringView& s) {
+		uint64_t v;
+		if (!parse_uint(s, v) || v > std::numeric_limits<T>::max()) {
+			throw ValueError();
+		}
+		return (T)v;
 	}
-	return v;
+};
+
+template <typename T>
+struct Converter<T, typename std::enable_if<std::is_same<T, double>::value || std::is_same<T, float>::value>::type> {
+	static T convert(const StringView& s) {
+		double v;
+		if (!parse_double(s, v)) {
+			throw ValueError();
+		}
+		// a float can not hold it; narrowing would give inf
+		if (std::is_same<T, float>::value && (v > FLT_MAX || v < -FLT_MAX)) {
+			throw ValueError();
+		}
+		return (T)v;
+	}
+};
+
+template <typename T>
+inline T convert(const StringView& s) {
+	return Converter<T>::convert(s);
+}
+
+template <typename T>
+inline T convert(const std::string& s) {
+	return Converter<T>::convert(StringView(s));
 }
 
 template <typename T>
@@ -240,12 +395,12 @@ inline T convert(const char *s) {
 	if (s == nullptr) {
 		throw ReferenceError();
 	}
-	return convert<T>(std::string(s));
+	return Converter<T>::convert(StringView(s));
 }
 
 template <typename T>
 inline T convert(const String& s) {
-	return convert<T>(s.str());
+	return Converter<T>::convert(s.view());
 }
 
 String sprint(const char *fmt, ...);
@@ -253,6 +408,16 @@ String vsprint(const char *fmt, va_list);
 
 }	// namespace
 
+// enables String as key in std::unordered_map and std::unordered_set
+namespace std {
+
+template <>
+struct hash<oo::String> {
+	size_t operator()(const oo::String& s) const { return (size_t)s.hash(); }
+};
+
+}	// namespace std
+
 #endif	// OOSTRING_H_WJ112
 
 // EOB
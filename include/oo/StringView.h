@@ -0,0 +1,235 @@
+/*
+	StringView.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOSTRINGVIEW_H_WJ114
+#define OOSTRINGVIEW_H_WJ114
+
+#include "oo/Error.h"
+#include "oo/compare.h"
+#include "oo/hash.h"
+#include "oo/types.h"
+
+#include <cstring>
+#include <string>
+#include <ostream>
+
+namespace oo {
+
+/*
+	StringView is a non-owning reference to a piece of string data:
+	a pointer and a length. It does not copy anything, so the data
+	must outlive the view. Mind that the data need not be nul-terminated
+
+	Functions that only look at a string should take a StringView;
+	you can pass a String, const char* or std::string without making
+	a temporary copy
+*/
+
+class StringView;
+class SplitIter;
+
+extern const StringView kStringViewStripDefaultCharSet;
+
+class StringView : eq_less_comparable<StringView> {
+public:
+	StringView() : data_(""), len_(0) { }
+
+	StringView(const char *s) : data_(s), len_(0) {
+		if (s == nullptr) {
+			data_ = "";
+		} else {
+			len_ = std::strlen(s);
+		}
+	}
+
+	StringView(const char *s, size_t n) : data_(s), len_(n) {
+		if (s == nullptr) {
+			data_ = "";
+			len_ = 0;
+		}
+	}
+
+	StringView(const std::string& s) : data_(s.data()), len_(s.size()) { }
+
+	std::string repr(void) const {
+		std::string s("\"");
+		s.append(data_, len_);
+		s += '"';
+		return s;
+	}
+
+	std::string str(void) const { return std::string(data_, len_); }
+
+	const char *data(void) const { return data_; }
+	size_t len(void) const { return len_; }
+	bool empty(void) const { return len_ == 0; }
+
+	bool operator!(void) const { return len_ == 0; }
+
+	// returns byte at index, like String::operator[]()
+	rune operator[](int) const;
+
+	bool operator==(const StringView& v) const {
+		if (len_ != v.len_) {
+			return false;
+		}
+		return (std::memcmp(data_, v.data_, len_) == 0);
+	}
+
+	bool operator<(const StringView&) const;
+
+	// same value as String::hash()
+	uint64_t hash(void) const { return hash_bytes(data_, len_); }
+
+	int find(rune, int=0, int=0) const;
+	int rfind(rune, int=0, int=0) const;
+
+	int find(const StringView&, int=0, int=0) const;
+	int rfind(const StringView&, int=0, int=0) const;
+
+	StringView strip(const StringView& charset=kStringViewStripDefaultCharSet) const;
+	StringView lstrip(const StringView& charset=kStringViewStripDefaultCharSet) const;
+	StringView rstrip(const StringView& charset=kStringViewStripDefaultCharSet) const;
+
+	StringView slice(int, int) const;
+
+	StringView substr(int start, size_t num = 0) const {
+		if (num == 0) {
+			num = len_;
+		}
+		return slice(start, num);
+	}
+
+	// lazy split; see SplitIter below
+	SplitIter isplit(rune=' ') const;
+	SplitIter isplit(const StringView&) const;
+	SplitIter isplitlines(void) const;
+
+private:
+	const char *data_;
+	size_t len_;
+};
+
+/*
+	SplitIter splits a string one field at a time, without copying
+	The fields are views into the original string, so it must outlive
+	the iterator. The separator is copied; it may be a temporary
+
+	Use it like this:
+
+		SplitIter it = s.isplit(',');
+		StringView field;
+		while(it.next(field)) {
+			...
+		}
+
+	or with a range-based for-loop:
+
+		for(StringView field : s.isplit(',')) {
+			...
+		}
+
+	isplitlines() splits on "\n" and "\r\n", and does not produce
+	a trailing empty line (like Python's splitlines())
+*/
+
+class SplitIter {
+public:
+	SplitIter(const StringView& s, const StringView& sep) : rest_(s), sep_(sep.data(), sep.len()),
+		lines_(false), done_(false) {
+		if (sep.empty()) {
+			throw ValueError("empty separator");
+		}
+	}
+
+	SplitIter(const StringView&, rune);
+
+	// split on newlines
+	SplitIter(const StringView& s) : rest_(s), sep_(), lines_(true), done_(false) { }
+
+	// get next field; returns false when there are no more fields
+	bool next(StringView&);
+
+	// what's left of the string (not yet split)
+	StringView rest(void) const { return rest_; }
+
+	class iterator {
+	public:
+		iterator() : it_(nullptr), field_() { }
+		iterator(SplitIter *it) : it_(it), field_() { advance(); }
+
+		const StringView& operator*(void) const { return field_; }
+		const StringView *operator->(void) const { return &field_; }
+
+		iterator& operator++(void) {
+			advance();
+			return *this;
+		}
+
+		bool operator==(const iterator& other) const { return it_ == other.it_; }
+		bool operator!=(const iterator& other) const { return it_ != other.it_; }
+
+	private:
+		SplitIter *it_;
+		StringView field_;
+
+		void advance(void) {
+			if (it_ != nullptr && !it_->next(field_)) {
+				it_ = nullptr;
+			}
+		}
+	};
+
+	// this enables range-based for-loops
+	// mind that iterating consumes the SplitIter
+	iterator begin(void) { return iterator(this); }
+	iterator end(void) { return iterator(); }
+
+private:
+	StringView rest_;
+	std::string sep_;		// short ones stay in its inline buffer
+	bool lines_, done_;
+
+	StringView sep(void) const { return StringView(sep_.data(), sep_.size()); }
+};
+
+inline SplitIter StringView::isplit(rune sep) const { return SplitIter(*this, sep); }
+inline SplitIter StringView::isplit(const StringView& sep) const { return SplitIter(*this, sep); }
+inline SplitIter StringView::isplitlines(void) const { return SplitIter(*this); }
+
+inline std::ostream& operator<<(std::ostream& os, const StringView& v) {
+	os.write(v.data(), v.len());
+	return os;
+}
+
+}	// namespace
+
+#endif	// OOSTRINGVIEW_H_WJ114
+
+// EOB
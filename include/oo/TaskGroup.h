@@ -0,0 +1,210 @@
+/*
+	TaskGroup.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOTASKGROUP_H_WJ114
+#define OOTASKGROUP_H_WJ114
+
+#include "oo/Base.h"
+#include "oo/Error.h"
+#include "oo/ThreadPool.h"
+#include "oo/go.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+
+namespace oo {
+
+/*
+	WaitGroup waits for a number of things to be done, like in Go
+
+		WaitGroup wg;
+		wg.add(3);
+		... three times, in some thread: wg.done();
+		wg.wait();
+
+	It is a counter; wait() sleeps on a futex until it drops to zero
+	done() is only one atomic operation, plus a wakeup if somebody
+	is waiting. The count and the "somebody is waiting" bit share a
+	word, so done() does not touch the WaitGroup after the count
+	dropped; the waiter may destroy it right away
+*/
+class WaitGroup : public Base {
+public:
+	WaitGroup() : Base(), state_(0) { }
+
+	WaitGroup(const WaitGroup&) = delete;
+	WaitGroup& operator=(const WaitGroup&) = delete;
+
+	std::string repr(void) const { return "<WaitGroup>"; }
+
+	bool operator!(void) const { return count() == 0; }
+
+	void add(uint32_t n = 1);
+	void done(void);
+	void wait(void);
+
+	uint32_t count(void) const { return state_.load(std::memory_order_acquire) & kCountMask; }
+
+private:
+	static const uint32_t kWaiters = 0x80000000U;
+	static const uint32_t kCountMask = 0x7fffffffU;
+
+	std::atomic<uint32_t> state_;
+};
+
+/*
+	a CancelToken tells tasks to stop
+	Copies share the same flag. Long running tasks should look at
+	cancelled() now and then, or call check(), which throws
+	CancelledError
+*/
+class CancelToken : public Base {
+public:
+	CancelToken() : Base(), flag_(std::make_shared<std::atomic<bool> >(false)) { }
+
+	std::string repr(void) const { return "<CancelToken>"; }
+
+	bool operator!(void) const { return flag_.get() == nullptr; }
+
+	void cancel(void) const { flag_->store(true, std::memory_order_release); }
+	bool cancelled(void) const { return flag_->load(std::memory_order_acquire); }
+
+	void check(void) const {
+		if (cancelled()) {
+			throw CancelledError();
+		}
+	}
+
+private:
+	std::shared_ptr<std::atomic<bool> > flag_;
+};
+
+/*
+	TaskGroup runs tasks (on go_pool(), or on a pool of your choice)
+	and waits for just those, rather than for everything like join()
+
+		TaskGroup g;
+		for(...) {
+			g.go(work, x, y);
+		}
+		g.wait();
+
+	If a task throws, the group is cancelled, and wait() throws that
+	exception (the first one, if there are more). Tasks of a cancelled
+	group that have not started yet are skipped; running tasks can
+	look at token()
+
+	wait() runs the tasks of the group that have not started yet
+	itself, rather than sitting idle, so groups can nest, as in divide
+	and conquer. It never runs tasks of others; those might wait for
+	what the waiter does after wait() returns
+	The destructor waits too, but does not throw
+*/
+class TaskGroup : public Base {
+public:
+	TaskGroup() : TaskGroup(go_pool()) { }
+	explicit TaskGroup(ThreadPool& pool) : Base(), pool_(pool), wg_(), token_(), mx_(), error_(), queue_(std::make_shared<TaskQueue>()) { }
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	virtual ~TaskGroup();
+
+	std::string repr(void) const { return "<TaskGroup>"; }
+
+	bool operator!(void) const { return !wg_; }
+
+	template <typename... Tpack>
+	void go(Tpack&&... args) {
+		submit(std::bind(std::forward<Tpack>(args)...));
+	}
+
+	void submit(std::function<void()>);
+
+	// wait for all tasks; throws the first exception of a task
+	void wait(void);
+
+	void cancel(void) { token_.cancel(); }
+	bool cancelled(void) const { return token_.cancelled(); }
+	const CancelToken& token(void) const { return token_; }
+
+	size_t pending(void) const { return wg_.count(); }
+
+private:
+	ThreadPool& pool_;
+	WaitGroup wg_;
+	CancelToken token_;
+	std::mutex mx_;
+	std::exception_ptr error_;
+
+	// tasks that have not started yet; whoever comes first runs them,
+	// a worker of the pool or the waiter. It outlives the group, for
+	// the workers that come too late
+	struct TaskQueue {
+		std::mutex mx;
+		std::deque<std::function<void()> > tasks;
+
+		TaskQueue() : mx(), tasks() { }
+
+		bool pop(std::function<void()>&);
+	};
+	std::shared_ptr<TaskQueue> queue_;
+
+	void run(const std::function<void()>&);
+	void wait_(void);
+};
+
+// used for printing
+inline std::ostream& operator<<(std::ostream& os, const WaitGroup& wg) {
+	os << wg.str();
+	return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const CancelToken& t) {
+	os << t.str();
+	return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const TaskGroup& g) {
+	os << g.str();
+	return os;
+}
+
+}	// namespace
+
+#endif	// OOTASKGROUP_H_WJ114
+
+// EOB
@@ -0,0 +1,194 @@
+/*
+	ThreadPool.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOTHREADPOOL_H_WJ114
+#define OOTHREADPOOL_H_WJ114
+
+#include "oo/Base.h"
+#include "oo/WorkDeque.h"
+#include "oo/types.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+const size_t kThreadPoolUnlimited = (size_t)-1;
+
+// how long a surplus worker stays around without work
+const std::chrono::milliseconds kThreadPoolLinger(2000);
+
+// how long the queue may make no progress before an elastic pool adds a worker
+const std::chrono::milliseconds kThreadPoolStall(1);
+
+// every so many tasks, a worker looks at the shared queue before its own deque
+const uint32_t kThreadPoolFairness = 61;
+
+/*
+	a ThreadPool runs tasks on a set of worker threads that are
+	started once and reused, rather than starting a thread per task
+
+	A fixed pool has n threads:
+
+		ThreadPool pool(4);
+
+	An elastic pool starts a new worker whenever a task comes in and
+	all workers are busy, up to the number of CPUs. Beyond that, more
+	workers (up to max_threads) are only added when the workers are
+	stuck: when tasks are waiting and none was started for a while,
+	because the running tasks block. Workers beyond min_threads exit
+	when they have been idle for the linger time:
+
+		ThreadPool pool(0, kThreadPoolUnlimited);
+
+	When all workers are busy and there is no room for more, tasks
+	wait in the queue. Mind that tasks in a fixed pool that block on
+	each other (on a channel, say) can deadlock the pool
+
+	The pool schedules by work stealing. Every worker has a deque
+	of its own (see WorkDeque.h); a task that submits tasks puts
+	them there, without taking a lock. A worker runs its own tasks
+	newest first, then takes from the shared queue, and when it has
+	nothing left to do, it steals the oldest task of another worker.
+	This way, divide and conquer jobs spread out over the workers,
+	while the shared queue only sees tasks from outside the pool
+
+	go() runs on an elastic pool without limit, so that goroutines
+	that block never starve the others; see go_pool()
+
+	wait() waits until all tasks are done. The destructor runs the
+	tasks that are still in the queue, and then stops the workers
+*/
+
+class ThreadPool : public Base {
+public:
+	explicit ThreadPool(size_t n);
+	ThreadPool(size_t min_threads, size_t max_threads, std::chrono::milliseconds linger = kThreadPoolLinger);
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	virtual ~ThreadPool();
+
+	std::string repr(void) const { return "<ThreadPool>"; }
+
+	bool operator!(void) const;
+
+	// queue a task
+	// a task of this pool that submits a task, puts it on its own deque
+	void submit(std::function<void()>);
+
+	// like the global go(), but run on this pool
+	template <typename... Tpack>
+	void go(Tpack&&... args) {
+		submit(std::bind(std::forward<Tpack>(args)...));
+	}
+
+	// wait until all tasks are done
+	// do not call this from within a task; it would wait for itself
+	void wait(void);
+
+	// a task that waits for other tasks may run one of them meanwhile
+	// Mind that it runs just any task; one that waits for the caller
+	// deadlocks. TaskGroup::wait() only runs tasks of its own group
+	// returns false if there was nothing to run, or if the calling
+	// thread is not a worker of this pool
+	bool run_one(void);
+
+	// run what is queued, then stop the workers
+	// after shutdown, submit() throws RuntimeError
+	void shutdown(void);
+
+	size_t threads(void) const;		// number of workers
+	size_t idle(void) const;		// number of workers without work
+	size_t pending(void) const;		// number of tasks queued or running
+
+private:
+	typedef std::function<void()> Task;
+
+	struct Worker {
+		WorkDeque<Task *> deque;
+		alignas(kCacheLineSize) std::atomic<uint64_t> started;	// number of tasks run
+		std::thread thread;
+		uint32_t seed;			// for picking a victim to steal from
+
+		Worker() : deque(), started(0), thread(), seed(0) { }
+	};
+
+	typedef std::vector<Worker *> WorkerList;
+
+	mutable std::mutex mx_;
+	std::condition_variable work_, done_, stalled_;
+	std::deque<Task *> queue_;			// tasks from outside the pool
+	std::atomic<size_t> queue_len_;
+	WorkerList slots_;					// every Worker ever made
+	WorkerList free_slots_;				// of workers that retired
+	std::atomic<const WorkerList *> snapshot_;		// for thieves
+	std::vector<const WorkerList *> old_snapshots_;
+	std::thread monitor_;				// watches for stuck workers
+	size_t min_threads_, max_threads_, core_threads_;
+	std::chrono::milliseconds linger_;
+	std::atomic<size_t> threads_, idle_, pending_;
+	std::atomic<bool> monitor_asleep_;
+	bool stop_;
+
+	// the worker that the current thread is, if any
+	static thread_local ThreadPool *current_pool_;
+	static thread_local Worker *current_worker_;
+
+	static Worker *new_worker(void);
+	static void delete_worker(Worker *);
+
+	void spawn(void);
+	void worker_main(Worker *);
+	Task *next_task(Worker *, uint32_t);
+	Task *take_queued(void);
+	Task *steal(Worker *);
+	bool work_waiting(void) const;
+	uint64_t tasks_started(void) const;
+	void run(Worker *, Task *);
+	void push_local(Worker *, Task *);
+	void retire(Worker *);
+	void wake_monitor(void);
+	void monitor_main(void);
+};
+
+}	// namespace
+
+#endif	// OOTHREADPOOL_H_WJ114
+
+// EOB
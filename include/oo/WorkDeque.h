@@ -0,0 +1,189 @@
+/*
+	WorkDeque.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOWORKDEQUE_H_WJ114
+#define OOWORKDEQUE_H_WJ114
+
+#include "oo/types.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace oo {
+
+typedef enum {
+	StealOK = 0,
+	StealEmpty,
+	StealAbort			// lost a race; try again
+} StealResult;
+
+/*
+	WorkDeque is a Chase-Lev work-stealing deque
+	(Lê, Pop, Cohen, Zappa Nardelli: "Correct and Efficient Work-Stealing
+	for Weak Memory Models", 2013)
+
+	One thread owns the deque; it push()es and pop()s at the bottom, so
+	it runs its own work last-in first-out, which keeps it hot in
+	the cache. Other threads steal() from the top, so they take the
+	oldest item; in divide and conquer that is the biggest piece of work
+
+	push() and pop() take no lock, and pop() only does an atomic
+	read-modify-write when the deque is almost empty
+	The ring grows when it's full; old rings are kept until the deque
+	is destroyed, since a thief may still be reading one
+
+	T must be a pointer (or other trivially copyable type)
+*/
+
+const size_t kWorkDequeSize = 256;
+
+template <typename T>
+class WorkDeque {
+public:
+	static_assert(std::is_trivially_copyable<T>::value, "WorkDeque<T> needs a trivially copyable type");
+
+	WorkDeque(size_t n = kWorkDequeSize) : top_(0), bottom_(0), ring_(nullptr), old_rings_() {
+		size_t cap = 2;
+		while(cap < n) {
+			cap <<= 1;
+		}
+		ring_.store(new Ring(cap), std::memory_order_relaxed);
+	}
+
+	WorkDeque(const WorkDeque&) = delete;
+	WorkDeque& operator=(const WorkDeque&) = delete;
+
+	~WorkDeque() {
+		delete ring_.load(std::memory_order_relaxed);
+		for(Ring *r : old_rings_) {
+			delete r;
+		}
+	}
+
+	// owner only
+	void push(T t) {
+		int64_t b = bottom_.load(std::memory_order_relaxed);
+		int64_t top = top_.load(std::memory_order_acquire);
+		Ring *r = ring_.load(std::memory_order_relaxed);
+
+		if (b - top > (int64_t)r->mask) {
+			r = grow(r, top, b);
+		}
+		r->put(b, t);
+		bottom_.store(b + 1, std::memory_order_release);
+	}
+
+	// owner only; takes the newest item
+	bool pop(T& t) {
+		int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+		Ring *r = ring_.load(std::memory_order_relaxed);
+		bottom_.store(b, std::memory_order_seq_cst);
+		int64_t top = top_.load(std::memory_order_seq_cst);
+
+		if (top > b) {
+			// empty
+			bottom_.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		t = r->get(b);
+		if (top == b) {
+			// the last item; race against the thieves for it
+			bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom_.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	// any thread; takes the oldest item
+	StealResult steal(T& t) {
+		int64_t top = top_.load(std::memory_order_seq_cst);
+		int64_t b = bottom_.load(std::memory_order_seq_cst);
+
+		if (top >= b) {
+			return StealEmpty;
+		}
+
+		Ring *r = ring_.load(std::memory_order_acquire);
+		t = r->get(top);
+		if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return StealAbort;
+		}
+		return StealOK;
+	}
+
+	// only an estimate while others are using it
+	size_t len(void) const {
+		int64_t b = bottom_.load(std::memory_order_seq_cst);
+		int64_t top = top_.load(std::memory_order_seq_cst);
+		return (b > top) ? (size_t)(b - top) : 0;
+	}
+
+	bool empty(void) const { return len() == 0; }
+
+private:
+	struct Ring {
+		size_t mask;
+		std::atomic<T> *items;
+
+		Ring(size_t cap) : mask(cap - 1), items(new std::atomic<T>[cap]) { }
+		~Ring() { delete [] items; }
+
+		Ring(const Ring&) = delete;
+		Ring& operator=(const Ring&) = delete;
+
+		void put(int64_t i, T t) { items[i & mask].store(t, std::memory_order_relaxed); }
+		T get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+	};
+
+	alignas(kCacheLineSize) std::atomic<int64_t> top_;		// thieves take from here
+	alignas(kCacheLineSize) std::atomic<int64_t> bottom_;	// the owner works here
+	std::atomic<Ring *> ring_;
+	std::vector<Ring *> old_rings_;		// owner only
+
+	Ring *grow(Ring *r, int64_t top, int64_t b) {
+		Ring *bigger = new Ring((r->mask + 1) * 2);
+		for(int64_t i = top; i < b; i++) {
+			bigger->put(i, r->get(i));
+		}
+		old_rings_.push_back(r);
+		ring_.store(bigger, std::memory_order_release);
+		return bigger;
+	}
+};
+
+}	// namespace
+
+#endif	// OOWORKDEQUE_H_WJ114
+
+// EOB
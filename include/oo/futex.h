@@ -0,0 +1,120 @@
+/*
+	futex.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOFUTEX_H_WJ114
+#define OOFUTEX_H_WJ114
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+
+namespace oo {
+
+/*
+	futex: block on an integer in memory
+	futex_wait() sleeps as long as the value at addr equals expected
+	futex_wake() wakes up to n threads that are waiting on addr
+
+	Like the real thing, futex_wait() may return spuriously; always
+	check the condition again. On systems other than Linux this is
+	emulated with condition variables
+*/
+
+void futex_wait(std::atomic<uint32_t> *addr, uint32_t expected);
+void futex_wake(std::atomic<uint32_t> *addr, int n = INT_MAX);
+
+// futex_wait() with a timeout; returns false if it timed out
+bool futex_wait_for(std::atomic<uint32_t> *addr, uint32_t expected, std::chrono::nanoseconds timeout);
+
+/*
+	EventCount lets lock-free code block when there is nothing to do,
+	while the fast path costs only a load when nobody is waiting
+
+	waiting side:
+		uint32_t key = ec.prepare_wait();
+		if (condition is now true) {
+			ec.cancel_wait();
+		} else {
+			ec.wait(key);
+		}
+		(and check the condition again)
+
+	notifying side:
+		make condition true
+		ec.notify()
+
+	A waiter sets the low bit of the sequence number ("armed"). notify()
+	only makes a system call if the bit is set, and then wakes all
+	waiters; so a burst of notifications wakes a sleeping thread once
+*/
+class EventCount {
+public:
+	EventCount() : seq_(0) { }
+
+	EventCount(const EventCount&) = delete;
+	EventCount& operator=(const EventCount&) = delete;
+
+	uint32_t prepare_wait(void) {
+		uint32_t key = seq_.fetch_or(1, std::memory_order_seq_cst) | 1;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return key;
+	}
+
+	void cancel_wait(void) {
+		// nothing to do; at worst, the next notify() makes a needless system call
+	}
+
+	void wait(uint32_t key) {
+		futex_wait(&seq_, key);
+	}
+
+	void notify(void) {
+		// pairs with the fence in prepare_wait(); either we see the
+		// waiter, or the waiter sees the condition that we made true
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		uint32_t seq = seq_.load(std::memory_order_relaxed);
+		if (seq & 1) {
+			// if this fails, another thread did the wakeup
+			if (seq_.compare_exchange_strong(seq, seq + 1, std::memory_order_seq_cst)) {
+				futex_wake(&seq_);
+			}
+		}
+	}
+
+private:
+	std::atomic<uint32_t> seq_;
+};
+
+}	// namespace
+
+#endif	// OOFUTEX_H_WJ114
+
+// EOB
@@ -41,12 +41,19 @@ namespace oo {
 // get current thread id
 unsigned int gettid(void);
 
+class ThreadPool;
+
 void go_trampoline__(const std::function<void()>&);
 
+// set the tid of this thread, return the old one; for ThreadPool
+unsigned int swap_tid__(unsigned int);
+
 /*
-	launch a thread
-	Use join() to wait for termination of all threads
-	Threads must be joined before the program ends or you might get
+	launch a goroutine
+	It runs on a pool of threads (see go_pool()), so no thread is
+	started when there is an idle one
+	Use join() to wait for termination of all goroutines
+	Goroutines must be joined before the program ends or you might get
 	weird SEGVs and the like upon termination
 	Use either getpid() or gettid() in the child to get its id
 */
@@ -68,9 +75,13 @@ inline void go<Functor&>(Functor& f) {
 	go_trampoline__(f.function());
 }
 
-// join() is like wait(), it waits for all threads to end
+// join() is like wait(), it waits for all goroutines to end
+// do not call it from within a goroutine
 void join(void);
 
+// the thread pool that go() runs on
+ThreadPool& go_pool(void);
+
 void child_trampoline__(const std::function<void()>&);
 
 /*
@@ -0,0 +1,137 @@
+/*
+	lockstat.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOLOCKSTAT_H_WJ114
+#define OOLOCKSTAT_H_WJ114
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace oo {
+
+/*
+	lock contention profiling
+
+	Give a Mutex or a Chan a name, and it keeps a LockStat:
+
+		Mutex mx("table lock");
+		Mutex mx2(OO_HERE);				// named after file:line
+		Chan<int> c(10, "work queue");
+
+	Nothing is counted until profiling is switched on:
+
+		lockstat_enable();
+		...
+		print("%s", lockstat_report().c_str());
+		std::string json = lockstat_json();
+
+	When it is off, a named lock costs one extra load and test per
+	lock(); a lock without a name only a test of a null pointer
+
+	For a Mutex it counts:
+		acquired	number of times the lock was taken
+		contended	number of times it was busy, and we had to wait
+					(or trylock() failed)
+		wait		total and longest time spent waiting for it
+		hold		longest time it was held
+	For a Chan, "acquired" counts blocking reads and writes, and
+	"contended" counts those that had to wait for items or room
+*/
+
+#define OO_STRINGIFY_(x)	#x
+#define OO_STRINGIFY(x)		OO_STRINGIFY_(x)
+#define OO_HERE				__FILE__ ":" OO_STRINGIFY(__LINE__)
+
+class LockStat {
+public:
+	explicit LockStat(const char *name);
+	~LockStat();
+
+	LockStat(const LockStat&) = delete;
+	LockStat& operator=(const LockStat&) = delete;
+
+	const std::string& name(void) const { return name_; }
+
+	// record an acquisition; wait_ns only counts if it was contended
+	void record(bool contended, uint64_t wait_ns = 0);
+
+	// a trylock() that failed
+	void busy(void) { contended_.fetch_add(1, std::memory_order_relaxed); }
+
+	// the owner of the lock calls these
+	void hold_begin(void) { hold_start_.store(now_ns(), std::memory_order_relaxed); }
+	void hold_end(void) {
+		if (hold_start_.load(std::memory_order_relaxed) != 0) {
+			hold_end_();
+		}
+	}
+
+	void reset(void);
+
+	uint64_t acquired(void) const { return acquired_.load(std::memory_order_relaxed); }
+	uint64_t contended(void) const { return contended_.load(std::memory_order_relaxed); }
+	uint64_t wait_ns(void) const { return wait_ns_.load(std::memory_order_relaxed); }
+	uint64_t max_wait_ns(void) const { return max_wait_ns_.load(std::memory_order_relaxed); }
+	uint64_t max_hold_ns(void) const { return max_hold_ns_.load(std::memory_order_relaxed); }
+
+	static uint64_t now_ns(void);
+
+private:
+	std::string name_;
+	std::atomic<uint64_t> acquired_, contended_, wait_ns_, max_wait_ns_, max_hold_ns_;
+	std::atomic<uint64_t> hold_start_;		// 0 if not timing a hold
+
+	LockStat *prev_, *next_;				// all LockStats are in a list
+
+	void hold_end_(void);
+
+	friend class LockStatList;
+};
+
+extern std::atomic<bool> lockstat_enabled_;
+
+inline bool lockstat_enabled(void) { return lockstat_enabled_.load(std::memory_order_relaxed); }
+
+void lockstat_enable(bool on = true);
+
+// zero all counters
+void lockstat_reset(void);
+
+// a table, sorted by total wait time
+std::string lockstat_report(void);
+
+// the same, as a JSON array of objects; times are in nanoseconds
+std::string lockstat_json(void);
+
+}	// namespace
+
+#endif	// OOLOCKSTAT_H_WJ114
+
+// EOB
@@ -0,0 +1,59 @@
+/*
+	memsearch.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOMEMSEARCH_H_WJ114
+#define OOMEMSEARCH_H_WJ114
+
+#include <cstddef>
+
+namespace oo {
+
+/*
+	fast search in byte buffers, used by String and StringView
+
+	On x86 these use SSE2 or AVX2, chosen at runtime depending on
+	what the CPU supports. Substring search compares the first and
+	last byte of the needle for a whole block of positions at once,
+	and only does a full compare for the candidates
+
+	All functions return a pointer to the match, or nullptr
+	An empty needle matches at the start (or for memrfind(), the end)
+*/
+
+const char *memfind(const char *haystack, size_t n, const char *needle, size_t m);
+const char *memrfind(const char *haystack, size_t n, const char *needle, size_t m);
+
+const char *memfind_byte(const char *s, size_t n, char c);
+const char *memrfind_byte(const char *s, size_t n, char c);
+
+}	// namespace
+
+#endif	// OOMEMSEARCH_H_WJ114
+
+// EOB
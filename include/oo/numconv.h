@@ -0,0 +1,73 @@
+/*
+	numconv.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OONUMCONV_H_WJ114
+#define OONUMCONV_H_WJ114
+
+#include "oo/StringView.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace oo {
+
+/*
+	locale-free conversion between numbers and text
+
+	The parse functions accept leading and trailing whitespace, like
+	convert<T>() always did. They return false if the text is not
+	a number, or if the number does not fit
+
+	The format functions write a nul-terminated string into buf and
+	return its length. buf must be at least kFormatNumberSize bytes
+
+	format_double() writes the shortest string that reads back as
+	the very same double
+
+	format_fixed() is like printf("%.*f") in the "C" locale. Because
+	large numbers can have many digits, it takes the size of buf, and
+	like snprintf() it returns the length it needed
+*/
+
+const size_t kFormatNumberSize = 32;
+
+bool parse_int(const StringView&, int64_t&);
+bool parse_uint(const StringView&, uint64_t&);
+bool parse_double(const StringView&, double&);
+
+size_t format_int(int64_t, char *buf);
+size_t format_uint(uint64_t, char *buf);
+size_t format_double(double, char *buf);
+size_t format_fixed(double, int precision, char *buf, size_t bufsize);
+
+}	// namespace
+
+#endif	// OONUMCONV_H_WJ114
+
+// EOB
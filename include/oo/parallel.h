@@ -0,0 +1,252 @@
+/*
+	parallel.h	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OOPARALLEL_H_WJ114
+#define OOPARALLEL_H_WJ114
+
+#include "oo/Array.h"
+#include "oo/TaskGroup.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+/*
+	parallel map/filter/reduce over an Array
+
+		b = par_apply(func, a);
+		b = par_filter(func, a);
+		x = par_reduce(func, a);
+		par_for(0, n, [](size_t i) { ... });
+
+	These work like apply(), filter() and reduce() in Sequence.h, but
+	split the array into chunks that run on go_pool(). The calling
+	thread works on chunks too. The result is allocated up front;
+	nothing is grown while it runs
+	They are fine to call from a goroutine; while the caller waits for
+	the chunks, it does not run other goroutines (see TaskGroup)
+
+	The chunks depend only on the length of the array (and the grain,
+	if given), not on the number of threads. So results come out in
+	order, and par_reduce() combines chunks in the same way every time,
+	even for floating point. func must be associative for par_reduce()
+	to give the same answer as reduce()
+
+	A chunk is at least kParGrain elements, and there are at most
+	kParChunks of them. Pass a grain size to override this, for
+	instance when func is expensive
+
+	If func throws, the remaining chunks are skipped and the exception
+	comes out of the par_ call
+*/
+
+const size_t kParGrain = 2048;
+const size_t kParChunks = 256;
+
+// number of elements per chunk
+inline size_t par_grain(size_t n, size_t grain = 0) {
+	if (grain > 0) {
+		return grain;
+	}
+	grain = (n + kParChunks - 1) / kParChunks;
+	return (grain < kParGrain) ? kParGrain : grain;
+}
+
+/*
+	call fn(lo, hi) for every chunk of [0, n), in parallel
+	Chunk number c is [c * grain, (c + 1) * grain)
+*/
+template <typename F>
+void par_chunks(size_t n, size_t grain, F fn) {
+	if (!n) {
+		return;
+	}
+	grain = par_grain(n, grain);
+	size_t nchunks = (n + grain - 1) / grain;
+
+	if (nchunks == 1) {
+		fn(0, n);
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	TaskGroup group;
+
+	// take chunks until there are no more
+	auto work = [&next, &group, &fn, nchunks, grain, n]() {
+		while(!group.cancelled()) {
+			size_t c = next.fetch_add(1, std::memory_order_relaxed);
+			if (c >= nchunks) {
+				break;
+			}
+			size_t lo = c * grain;
+			size_t hi = (lo + grain < n) ? lo + grain : n;
+			fn(lo, hi);
+		}
+	};
+
+	size_t helpers = std::thread::hardware_concurrency();
+	if (helpers > 0) {
+		helpers--;
+	}
+	if (helpers > nchunks - 1) {
+		helpers = nchunks - 1;
+	}
+	for(size_t i = 0; i < helpers; i++) {
+		group.submit(work);
+	}
+
+	try {
+		work();
+	} catch(...) {
+		// the destructor waits for the helpers
+		group.cancel();
+		throw;
+	}
+	group.wait();
+}
+
+// call func(i) for every i in [lo, hi)
+template <typename F>
+void par_for(size_t lo, size_t hi, F func, size_t grain = 0) {
+	if (hi <= lo) {
+		return;
+	}
+	par_chunks(hi - lo, grain, [lo, &func](size_t a, size_t b) {
+		for(size_t i = lo + a; i < lo + b; i++) {
+			func(i);
+		}
+	});
+}
+
+// apply function to every member of a
+template <typename T, typename F>
+Array<T> par_apply(F func, const Array<T>& a, size_t grain = 0) {
+	size_t n = a.len();
+	Array<T> ret(n);
+
+	auto src = a.cbegin();
+	auto dst = ret.begin();
+	par_chunks(n, grain, [&src, &dst, &func](size_t lo, size_t hi) {
+		std::transform(src + lo, src + hi, dst + lo, func);
+	});
+	return ret;
+}
+
+// return the members of a for which func is true, in order
+template <typename T, typename F>
+Array<T> par_filter(F func, const Array<T>& a, size_t grain = 0) {
+	size_t n = a.len();
+	if (!n) {
+		return Array<T>();
+	}
+	grain = par_grain(n, grain);
+	size_t nchunks = (n + grain - 1) / grain;
+
+	// first pass: test every member, count per chunk
+	std::vector<unsigned char> keep(n);
+	std::vector<size_t> counts(nchunks);
+
+	auto src = a.cbegin();
+	par_chunks(n, grain, [&src, &keep, &counts, &func, grain](size_t lo, size_t hi) {
+		size_t count = 0;
+		for(size_t i = lo; i < hi; i++) {
+			keep[i] = func(*(src + i)) ? 1 : 0;
+			count += keep[i];
+		}
+		counts[lo / grain] = count;
+	});
+
+	// where every chunk starts in the output
+	size_t total = 0;
+	for(size_t c = 0; c < nchunks; c++) {
+		size_t count = counts[c];
+		counts[c] = total;
+		total += count;
+	}
+
+	// second pass: copy
+	Array<T> ret(total);
+	auto dst = ret.begin();
+	par_chunks(n, grain, [&src, &dst, &keep, &counts, grain](size_t lo, size_t hi) {
+		auto out = dst + counts[lo / grain];
+		for(size_t i = lo; i < hi; i++) {
+			if (keep[i]) {
+				*out = *(src + i);
+				++out;
+			}
+		}
+	});
+	return ret;
+}
+
+// reduce array to a single value by applying the function to every element
+// func must be associative
+template <typename T, typename F>
+auto par_reduce(F func, const Array<T>& a, size_t grain = 0) -> decltype(func(std::declval<T>(), std::declval<T>())) {
+	typedef decltype(func(std::declval<T>(), std::declval<T>())) R;
+
+	// like reduce(), start out with a zero value
+	R init{};
+
+	size_t n = a.len();
+	if (!n) {
+		return init;
+	}
+	grain = par_grain(n, grain);
+	size_t nchunks = (n + grain - 1) / grain;
+
+	std::vector<R> partial(nchunks);
+
+	auto src = a.cbegin();
+	par_chunks(n, grain, [&src, &partial, &func, grain](size_t lo, size_t hi) {
+		R r = *(src + lo);
+		for(size_t i = lo + 1; i < hi; i++) {
+			r = func(r, *(src + i));
+		}
+		partial[lo / grain] = r;
+	});
+
+	// combine the chunks in order
+	for(size_t c = 0; c < nchunks; c++) {
+		init = func(init, partial[c]);
+	}
+	return init;
+}
+
+}	// namespace
+
+#endif	// OOPARALLEL_H_WJ114
+
+// EOB
@@ -30,12 +30,48 @@
 #ifndef OOPRINT_H_WJ112
 #define OOPRINT_H_WJ112
 
+#include "oo/StringView.h"
+
 #include <sstream>
 #include <ostream>
+#include <string>
 #include <cstdarg>
 
 namespace oo {
 
+/*
+	FormatBuffer formats print()-style format strings without using
+	iostreams. It borrows a per-thread buffer, so formatting normally
+	does not allocate memory. Parsed format strings are cached per thread
+
+	Keep a FormatBuffer on the stack only; it is not meant to be stored
+*/
+
+class FormatBuffer {
+public:
+	FormatBuffer();
+	~FormatBuffer();
+
+	void format(const char *, ...);
+	void vformat(const char *, std::va_list);
+
+	void append(char c) { buf_->push_back(c); }
+	void append(const char *s, size_t n) { buf_->append(s, n); }
+	void clear(void) { buf_->clear(); }
+
+	const char *data(void) const { return buf_->data(); }
+	size_t len(void) const { return buf_->size(); }
+	StringView view(void) const { return StringView(buf_->data(), buf_->size()); }
+
+private:
+	std::string *buf_;
+	std::string local_;		// used when the per-thread buffer is taken
+	bool borrowed_;
+
+	FormatBuffer(const FormatBuffer&) = delete;
+	FormatBuffer& operator=(const FormatBuffer&) = delete;
+};
+
 void vssprint(std::stringstream&, const char *, std::va_list);
 void ssprint(std::stringstream&, const char *, ...);
 
@@ -50,6 +86,30 @@ void printerr(void);
 void printerr(const char *, ...);
 void printnerr(const char *, ...);
 
+/*
+	asynchronous printing
+	print() and printerr() queue the line in a per-thread buffer, and
+	a writer thread writes it out. This way threads don't have to wait
+	for each other (or for the terminal) when printing
+
+	Call print_flush() to wait until all queued output has been written
+	At exit, queued output is written automatically
+	Mind that output written directly to std::cout may come out of order
+*/
+
+typedef enum {
+	PrintBlock = 0,		// when the buffer is full, wait
+	PrintDrop,			// when the buffer is full, drop the line
+	PrintDropCount		// drop the line, and report the number of dropped lines
+} PrintOverflow;
+
+const size_t kPrintAsyncBufSize = 64 * 1024;
+
+void print_async(PrintOverflow overflow = PrintBlock, size_t bufsize = kPrintAsyncBufSize);
+void print_sync(void);
+void print_flush(void);
+size_t print_dropped(void);
+
 }	// namespace
 
 #endif	// OOPRINT_H_WJ112
@@ -30,6 +30,7 @@
 #ifndef OOTYPES_H_WJ112
 #define OOTYPES_H_WJ112
 
+#include <cstddef>
 #include <cstdint>
 
 namespace oo {
@@ -37,6 +38,9 @@ namespace oo {
 typedef unsigned char byte;
 typedef uint32_t rune;
 
+// keep data that different threads write on separate cache lines
+const size_t kCacheLineSize = 64;
+
 }	// namespace
 
 #endif	// OOTYPES_H_WJ112
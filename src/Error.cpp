@@ -44,6 +44,7 @@ const int kIOError = -7;
 const int kRuntimeError = -8;
 const int kOSError = -9;
 const int kStringEncodingError = -10;
+const int kCancelledError = -11;
 
 static bool initError(void);
 static void terminate_handler(void);
@@ -96,7 +96,7 @@ size_t File::read(void *buf, size_t n) {
 	return bytes_read;
 }
 
-void File::write(const String& s) {
+void File::write(const StringView& s) {
 	if (w_.get() == nullptr) {
 		if (this == &Stdout || this == &Stderr) {
 			// it's OK to close stdout/stderr and still write to it
@@ -109,11 +109,9 @@ void File::write(const String& s) {
 		return;
 	}
 
-	std::string str = s.str();
+	size_t bytes_written = std::fwrite(s.data(), 1, s.len(), w_.get());
 
-	size_t bytes_written = std::fwrite(str.c_str(), 1, str.size(), w_.get());
-
-	if (bytes_written < str.size() && std::ferror(w_.get())) {
+	if (bytes_written < s.len() && std::ferror(w_.get())) {
 		throw IOError("write failed");
 	}
 }
@@ -298,9 +296,9 @@ void vfprint(File& f, const char *fmt, std::va_list ap) {
 		throw ReferenceError();
 	}
 
-	std::stringstream ss;
-	vssprint(ss, fmt, ap);
-	f.write(ss.str());
+	FormatBuffer buf;
+	buf.vformat(fmt, ap);
+	f.write(buf.view());
 }
 
 }	// namespace
@@ -35,6 +35,10 @@ void Mutex::lock(void) {
 	if (m_.get() == nullptr) {
 		throw ReferenceError();
 	}
+	if (stat_.get() != nullptr && lockstat_enabled()) {
+		lock_profiled();
+		return;
+	}
 	try {
 		m_->lock();
 	} catch(std::system_error) {
@@ -43,6 +47,25 @@ void Mutex::lock(void) {
 	state = MutexLocked;
 }
 
+// lock(), and count how often it was busy and how long we waited
+void Mutex::lock_profiled(void) {
+	bool contended = !m_->try_lock();
+	uint64_t wait_ns = 0;
+
+	if (contended) {
+		uint64_t t0 = LockStat::now_ns();
+		try {
+			m_->lock();
+		} catch(const std::system_error&) {
+			throw OSError("failed to lock Mutex");
+		}
+		wait_ns = LockStat::now_ns() - t0;
+	}
+	state = MutexLocked;
+	stat_->record(contended, wait_ns);
+	stat_->hold_begin();
+}
+
 void Mutex::unlock(void) {
 	if (m_.get() == nullptr) {
 		throw ReferenceError();
@@ -52,6 +75,9 @@ void Mutex::unlock(void) {
 	}
 
 	state = MutexUnlocked;
+	if (stat_.get() != nullptr) {
+		stat_->hold_end();
+	}
 	try {
 		m_->unlock();
 	} catch(std::system_error) {
@@ -63,12 +89,20 @@ bool Mutex::trylock(void) {
 	if (m_.get() == nullptr) {
 		throw ReferenceError();
 	}
-	if (m_->try_lock()) {
+	// if it fails, somebody else holds the lock; leave state alone
+	bool locked = m_->try_lock();
+	if (locked) {
 		state = MutexLocked;
-	} else {
-		state = MutexUnlocked;
 	}
-	return state;
+	if (stat_.get() != nullptr && lockstat_enabled()) {
+		if (locked) {
+			stat_->record(false);
+			stat_->hold_begin();
+		} else {
+			stat_->busy();
+		}
+	}
+	return locked;
 }
 
 }	// namespace oo
@@ -28,92 +28,708 @@
  */
 
 #include "oo/Observer.h"
+#include "oo/HashDict.h"
+#include "oo/RWMutex.h"
+#include "oo/ThreadPool.h"
+#include "oo/go.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <unordered_map>
 
 #include <stdlib.h>
 
 namespace oo {
 
+/*
+	the table of interned event names
+	It is created on first use and never destroyed, so that static
+	objects can intern events. Names are never freed either
+*/
+struct EventNames {
+	RWMutex mx;
+	HashDict<EventId> ids;
+	std::vector<const char *> names;	// names[id]; names[0] is for kNoEvent
+
+	EventNames() : mx(), ids(), names(1, nullptr) { }
+};
+
+static EventNames& event_names(void) {
+	static EventNames *en = new EventNames();
+	return *en;
+}
+
+EventId event_id(const char *name) {
+	if (name == nullptr) {
+		throw ReferenceError();
+	}
+	EventId id = find_event_id(name);
+	if (id != kNoEvent) {
+		return id;
+	}
+
+	EventNames& en = event_names();
+	WriteLock lk(en.mx);
+
+	// look again; another thread may have interned it in the meantime
+	EventId *p = en.ids.find(name);
+	if (p != nullptr) {
+		return *p;
+	}
+	id = (EventId)en.names.size();
+	en.names.push_back(::strdup(name));
+	en.ids[name] = id;
+	return id;
+}
+
+EventId find_event_id(const char *name) {
+	if (name == nullptr) {
+		throw ReferenceError();
+	}
+	EventNames& en = event_names();
+	ReadLock lk(en.mx);
+
+	const EventId *p = en.ids.find(name);
+	return (p == nullptr) ? kNoEvent : *p;
+}
+
+const char *event_name(EventId id) {
+	EventNames& en = event_names();
+	ReadLock lk(en.mx);
+
+	if (id >= en.names.size()) {
+		return nullptr;
+	}
+	return en.names[id];
+}
+
+// while the guard is up, a table that we loaded will not be freed
+// The last one out of an epoch frees what waited for it
+class NotifyGuard {
+public:
+	explicit NotifyGuard(NotificationCenter& nc) : nc_(nc), epoch_(nc.epoch_.load(std::memory_order_seq_cst)) {
+		nc_.readers_[epoch_].fetch_add(1, std::memory_order_seq_cst);
+	}
+
+	~NotifyGuard() {
+		if (nc_.readers_[epoch_].fetch_sub(1, std::memory_order_seq_cst) == 1
+			&& nc_.retired_.load(std::memory_order_seq_cst)) {
+			nc_.try_reclaim();
+		}
+	}
+
+private:
+	NotificationCenter& nc_;
+	uint32_t epoch_;
+};
+
+// set while this thread calls an observer for a NotifyQueue
+static thread_local bool delivering = false;
+
+/*
+	NotifyQueue does the asynchronous delivery for a NotificationCenter
+
+	Posted events wait in queue_ until they are due. The dispatcher
+	thread takes them out, and puts a Delivery in the mailbox of every
+	observer of the event. A mailbox that has mail gets a task on the
+	pool, that delivers everything in it, one at a time; there is
+	never more than one such task per mailbox, so that an observer
+	sees its notifications in order
+
+	A mailbox holds at most one undelivered Delivery per event, and at
+	most cap_ of them. While any mailbox is full, the dispatcher leaves
+	the queue alone; so a slow observer fills up the queue, and then
+	post() blocks
+*/
+class NotifyQueue {
+public:
+	NotifyQueue(NotificationCenter&, ThreadPool&, size_t, std::chrono::milliseconds);
+	~NotifyQueue();
+
+	NotifyQueue(const NotifyQueue&) = delete;
+	NotifyQueue& operator=(const NotifyQueue&) = delete;
+
+	bool post(EventId, bool);
+	void flush(void);
+	void purge(Observer *, EventId);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Item {
+		EventId id;
+		Clock::time_point due;
+	};
+
+	struct Delivery {
+		EventId id;
+		const char *name;
+	};
+
+	struct Mailbox {
+		std::deque<Delivery> mail;
+		std::vector<bool> has;		// has[id]: the event is in mail
+		bool scheduled;				// there is a task for it
+		bool busy;					// the observer is being called
+		std::thread::id thread;		// by this thread
+
+		Mailbox() : mail(), has(), scheduled(false), busy(false), thread() { }
+	};
+
+	NotificationCenter& nc_;
+	ThreadPool& pool_;
+	size_t cap_;
+	Clock::duration window_;
+
+	std::mutex mx_;
+	std::condition_variable work_, not_full_, idle_;
+	std::deque<Item> queue_;
+	std::vector<bool> queued_;		// queued_[id]: the event is in queue_
+	std::unordered_map<Observer *, Mailbox> mailboxes_;
+	size_t in_flight_;				// posted, but not delivered yet
+	size_t full_;					// number of full mailboxes
+	bool stop_;
+	std::thread dispatcher_;
+
+	void dispatch_main(void);
+	void deliver(Observer *);
+	void done(size_t);
+	void unfull(size_t, const Mailbox&);
+};
+
+NotifyQueue::NotifyQueue(NotificationCenter& nc, ThreadPool& pool, size_t cap, std::chrono::milliseconds window) :
+	nc_(nc), pool_(pool), cap_(cap), window_(window), mx_(), work_(), not_full_(), idle_(), queue_(), queued_(),
+	mailboxes_(), in_flight_(0), full_(0), stop_(false), dispatcher_() {
+	dispatcher_ = std::thread(&NotifyQueue::dispatch_main, this);
+}
+
+NotifyQueue::~NotifyQueue() {
+	flush();
+	{
+		std::lock_guard<std::mutex> lk(mx_);
+		stop_ = true;
+	}
+	work_.notify_one();
+	dispatcher_.join();
+}
+
+// returns false if the queue was full, and block is false
+bool NotifyQueue::post(EventId id, bool block) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	if (id < queued_.size() && queued_[id]) {
+		// coalesce with the one that is waiting
+		return true;
+	}
+	if (queue_.size() >= cap_ && !delivering) {
+		if (!block) {
+			return false;
+		}
+		not_full_.wait(lk, [this, id]() {
+			return this->queue_.size() < this->cap_ || (id < this->queued_.size() && this->queued_[id]);
+		});
+		if (id < queued_.size() && queued_[id]) {
+			return true;
+		}
+	}
+
+	if (id >= queued_.size()) {
+		queued_.resize(id + 1);
+	}
+	queued_[id] = true;
+	queue_.push_back(Item{id, Clock::now() + window_});
+	in_flight_++;
+
+	if (queue_.size() == 1) {
+		work_.notify_one();
+	}
+	return true;
+}
+
+void NotifyQueue::flush(void) {
+	std::unique_lock<std::mutex> lk(mx_);
+	idle_.wait(lk, [this]() { return this->in_flight_ == 0; });
+}
+
+// n items were delivered, or dropped; the lock must be held
+void NotifyQueue::done(size_t n) {
+	in_flight_ -= n;
+	if (in_flight_ == 0) {
+		idle_.notify_all();
+	}
+}
+
+// mail was taken out of a mailbox that had n in it; the lock must be held
+void NotifyQueue::unfull(size_t n, const Mailbox& box) {
+	if (n >= cap_ && box.mail.size() < cap_) {
+		full_--;
+		if (full_ == 0) {
+			work_.notify_one();
+		}
+	}
+}
+
+void NotifyQueue::dispatch_main(void) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	for(;;) {
+		if (queue_.empty()) {
+			if (stop_) {
+				break;
+			}
+			work_.wait(lk);
+			continue;
+		}
+		if (full_ > 0) {
+			// an observer is behind; wait for it to catch up
+			work_.wait(lk);
+			continue;
+		}
+		Clock::time_point now = Clock::now();
+		if (queue_.front().due > now) {
+			work_.wait_until(lk, queue_.front().due);
+			continue;
+		}
+
+		// take everything that is due, until a mailbox fills up
+		size_t taken = 0;
+		while(!queue_.empty() && queue_.front().due <= now && full_ == 0) {
+			EventId id = queue_.front().id;
+			queue_.pop_front();
+			queued_[id] = false;
+			taken++;
+
+			NotifyGuard guard(nc_);
+			const NotificationCenter::ObserverList *list = nc_.observers(id);
+			if (list == nullptr) {
+				continue;
+			}
+			for(Observer *o : list->observers) {
+				Mailbox& box = mailboxes_[o];
+				if (id < box.has.size() && box.has[id]) {
+					// coalesce with the one that is waiting in the mailbox
+					continue;
+				}
+				if (id >= box.has.size()) {
+					box.has.resize(id + 1);
+				}
+				box.has[id] = true;
+				box.mail.push_back(Delivery{id, list->name});
+				in_flight_++;
+				if (box.mail.size() == cap_) {
+					full_++;
+				}
+
+				if (!box.scheduled) {
+					box.scheduled = true;
+					pool_.submit(std::bind(&NotifyQueue::deliver, this, o));
+				}
+			}
+		}
+		not_full_.notify_all();
+		done(taken);
+	}
+}
+
+// deliver the mail of one observer; runs on the pool
+// The mailbox stays in the map for as long as this runs
+void NotifyQueue::deliver(Observer *o) {
+	std::unique_lock<std::mutex> lk(mx_);
+	Mailbox& box = mailboxes_[o];
+
+	box.thread = std::this_thread::get_id();
+	while(!box.mail.empty()) {
+		Delivery d = box.mail.front();
+		box.mail.pop_front();
+		box.has[d.id] = false;
+		unfull(box.mail.size() + 1, box);
+		box.busy = true;
+
+		lk.unlock();
+		delivering = true;
+		o->notify(d.name);
+		delivering = false;
+		lk.lock();
+
+		box.busy = false;
+		done(1);
+		idle_.notify_all();		// for purge()
+	}
+	mailboxes_.erase(o);
+}
+
+// forget the mail for an observer that is being removed
+// If it is removed for all events, wait for a delivery to it that
+// is in progress, so that it may be destroyed when we return
+void NotifyQueue::purge(Observer *o, EventId id) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	auto it = mailboxes_.find(o);
+	if (it == mailboxes_.end()) {
+		return;
+	}
+	Mailbox& box = it->second;
+
+	size_t n = box.mail.size();
+	if (id == kNoEvent) {
+		box.mail.clear();
+		box.has.clear();
+	} else if (id < box.has.size() && box.has[id]) {
+		// there is only one of it
+		box.mail.erase(std::find_if(box.mail.begin(), box.mail.end(), [id](const Delivery& d) {
+			return d.id == id;
+		}));
+		box.has[id] = false;
+	}
+	done(n - box.mail.size());
+	unfull(n, box);
+
+	// an observer that removes itself need not wait for itself
+	if (id != kNoEvent || box.thread == std::this_thread::get_id()) {
+		return;
+	}
+	idle_.wait(lk, [this, o]() {
+		auto i = this->mailboxes_.find(o);
+		return i == this->mailboxes_.end() || !i->second.busy;
+	});
+}
+
 // global var
 NotificationCenter defaultNotificationCenter;
 
 
+NotificationCenter::NotificationCenter() : table_(new ObserverTable()), epoch_(0), readers_(), retired_(false), mx_(),
+	old_tables_(), async_(nullptr) {
+	readers_[0] = 0;
+	readers_[1] = 0;
+}
+
+NotificationCenter::~NotificationCenter() {
+	stop_async();
+
+	delete table_.load(std::memory_order_relaxed);
+	for(const std::vector<const ObserverTable *>& old : old_tables_) {
+		for(const ObserverTable *t : old) {
+			delete t;
+		}
+	}
+}
+
+// swap in a new table; the lock must be held
+void NotificationCenter::publish(ObserverTable *t) {
+	old_tables_[epoch_.load(std::memory_order_relaxed)].push_back(table_.exchange(t, std::memory_order_seq_cst));
+
+	// either reclaim() sees that the readers are gone, or the last of
+	// them sees this, and reclaims
+	retired_.store(true, std::memory_order_seq_cst);
+	reclaim();
+}
+
+/*
+	free the old tables that nobody can be looking at; the lock must be held
+
+	A notify() counts in readers_[epoch_], and then loads the table
+	A table retired in epoch e may be in use by calls that count in
+	readers_[e], or in readers_[e ^ 1] if they saw the epoch before it
+	was e. So once readers_[e ^ 1] is zero, we switch to epoch e ^ 1;
+	new calls count there, and readers_[e] only goes down. When it is
+	zero, the tables of epoch e are free. A single counter would hardly
+	ever be zero under load
+*/
+void NotificationCenter::reclaim(void) {
+	for(;;) {
+		uint32_t cur = epoch_.load(std::memory_order_relaxed);
+		uint32_t prev = cur ^ 1;
+
+		if (readers_[prev].load(std::memory_order_seq_cst) != 0) {
+			break;
+		}
+		for(const ObserverTable *old : old_tables_[prev]) {
+			delete old;
+		}
+		old_tables_[prev].clear();
+
+		if (old_tables_[cur].empty()) {
+			break;
+		}
+		epoch_.store(prev, std::memory_order_seq_cst);
+	}
+	retired_.store(!old_tables_[0].empty() || !old_tables_[1].empty(), std::memory_order_seq_cst);
+}
+
+// the last notify() of an epoch may free tables, but never waits for the lock
+// If it is taken, whoever holds it reclaims, or the next one out does
+void NotificationCenter::try_reclaim(void) {
+	std::unique_lock<std::mutex> lk(mx_, std::try_to_lock);
+	if (lk.owns_lock()) {
+		reclaim();
+	}
+}
+
 // register observer for a specific event
 void NotificationCenter::add_observer(Observer& o, const char *event) {
 	if (event == nullptr) {
 		throw ReferenceError();
 	}
+	add_observer(o, event_id(event));
+}
 
-	String key = event;
-	Array<Observer *> a;
+void NotificationCenter::add_observer(Observer& o, EventId id) {
+	if (id == kNoEvent) {
+		throw ValueError();
+	}
+
+	std::lock_guard<std::mutex> lk(mx_);
 
-	if (this->all_observers.has_key(key)) {
-		a = this->all_observers[key];
+	ObserverTable *t = new ObserverTable(*table_.load(std::memory_order_relaxed));
+	if (id >= t->size()) {
+		t->resize(id + 1);
+	}
+	ObserverList *list;
+	if ((*t)[id].get() != nullptr) {
+		list = new ObserverList(*(*t)[id]);
+	} else {
+		list = new ObserverList();
+		list->name = event_name(id);
+		if (list->name == nullptr) {
+			delete list;
+			delete t;
+			throw ValueError();
+		}
 	}
-	a.append(&o);
-	this->all_observers[key] = a;
+	list->observers.push_back(&o);
+	(*t)[id].reset(list);
+
+	publish(t);
 }
 
 // default argument: event = nullptr
 void NotificationCenter::remove_observer(Observer& o, const char *event) {
-	String key;
-	Array<Observer *> a;
-
 	if (event == nullptr) {
 		// remove all occurrences of o
+		remove_observer(o, kNoEvent);
+		return;
+	}
 
-		Array<String> keys = this->all_observers.keys();
+	// remove o only for event
+	EventId id = find_event_id(event);
+	if (id != kNoEvent) {
+		remove_observer(o, id);
+	}
+}
 
-		foreach(i, keys) {
-			key = keys[i];
-			a = this->all_observers[key];
-			if (a.remove(&o)) {
-				this->all_observers[key] = a;
-			}
-		}
-	} else {
-		// remove o only for event
+// remove o for event id, or for all events if id is kNoEvent
+void NotificationCenter::remove_observer(Observer& o, EventId id) {
+	remove_observer_(o, id);
 
-		key = event;
+	// drop deliveries to o that were still on their way
+	NotifyQueue *q = async_.load(std::memory_order_acquire);
+	if (q != nullptr) {
+		q->purge(&o, id);
+	}
+}
 
-		if (this->all_observers.has_key(key)) {
-			a = this->all_observers[key];
-			if (a.remove(&o)) {
-				this->all_observers[key] = a;
-			}
+void NotificationCenter::remove_observer_(Observer& o, EventId id) {
+	std::lock_guard<std::mutex> lk(mx_);
+
+	const ObserverTable *cur = table_.load(std::memory_order_relaxed);
+	ObserverTable *t = nullptr;
+
+	size_t lo = id, hi = id + 1;
+	if (id == kNoEvent) {
+		lo = 1;
+		hi = cur->size();
+	}
+	for(size_t i = lo; i < hi && i < cur->size(); i++) {
+		const ObserverList *old = (*cur)[i].get();
+		if (old == nullptr) {
+			continue;
 		}
+		// like Array::remove(), remove the first occurrence
+		std::vector<Observer *>::const_iterator it = std::find(old->observers.begin(), old->observers.end(), &o);
+		if (it == old->observers.end()) {
+			continue;
+		}
+		if (t == nullptr) {
+			t = new ObserverTable(*cur);
+		}
+		ObserverList *list = new ObserverList(*old);
+		list->observers.erase(list->observers.begin() + (it - old->observers.begin()));
+		if (list->observers.empty()) {
+			delete list;
+			list = nullptr;
+		}
+		(*t)[i].reset(list);
+	}
+
+	if (t != nullptr) {
+		publish(t);
+	}
+}
+
+
+// returns nullptr if there are no observers
+// the caller must hold a NotifyGuard
+const NotificationCenter::ObserverList *NotificationCenter::observers(EventId id) const {
+	const ObserverTable *t = table_.load(std::memory_order_seq_cst);
+	if (id >= t->size()) {
+		return nullptr;
 	}
+	return (*t)[id].get();
 }
 
 void NotificationCenter::notify(const char *event) {
 	if (event == nullptr) {
 		throw ReferenceError();
 	}
+	EventId id = find_event_id(event);
+	if (id == kNoEvent) {
+		return;
+	}
 
-	String key = event;
-
-	if (this->all_observers.has_key(key)) {
-		Array<Observer *> a = this->all_observers[key];
-
+	NotifyGuard guard(*this);
+	const ObserverList *list = observers(id);
+	if (list != nullptr) {
 		// call notify event in all registered observers
-		foreach(i, a) {
-			a[i]->notify(event);
+		// they get the caller's pointer, so they may compare it
+		for(Observer *o : list->observers) {
+			o->notify(event);
 		}
 	}
 }
 
+void NotificationCenter::notify(EventId id) {
+	NotifyGuard guard(*this);
+	const ObserverList *list = observers(id);
+	if (list != nullptr) {
+		for(Observer *o : list->observers) {
+			o->notify(list->name);
+		}
+	}
+}
+
+void NotificationCenter::start_async(size_t queue_len, std::chrono::milliseconds window) {
+	start_async(go_pool(), queue_len, window);
+}
+
+void NotificationCenter::start_async(ThreadPool& pool, size_t queue_len, std::chrono::milliseconds window) {
+	if (queue_len == 0) {
+		throw ValueError();
+	}
+
+	std::lock_guard<std::mutex> lk(mx_);
+	if (async_.load(std::memory_order_relaxed) != nullptr) {
+		throw RuntimeError("asynchronous delivery was already started");
+	}
+	async_.store(new NotifyQueue(*this, pool, queue_len, window), std::memory_order_release);
+}
+
+// delivers what was posted, and stops
+// Mind that it must not run at the same time as post(), try_post(),
+// flush() or remove_observer(); they use the queue without a lock
+void NotificationCenter::stop_async(void) {
+	NotifyQueue *q;
+	{
+		std::lock_guard<std::mutex> lk(mx_);
+		q = async_.exchange(nullptr, std::memory_order_acq_rel);
+	}
+	delete q;
+}
+
+NotifyQueue *NotificationCenter::async_queue(void) {
+	NotifyQueue *q = async_.load(std::memory_order_acquire);
+	if (q != nullptr) {
+		return q;
+	}
+
+	std::lock_guard<std::mutex> lk(mx_);
+	q = async_.load(std::memory_order_relaxed);
+	if (q == nullptr) {
+		q = new NotifyQueue(*this, go_pool(), kNotifyQueueLen, std::chrono::milliseconds(0));
+		async_.store(q, std::memory_order_release);
+	}
+	return q;
+}
+
+void NotificationCenter::post(const char *event) {
+	if (event == nullptr) {
+		throw ReferenceError();
+	}
+	// an event that was never interned has no observers
+	EventId id = find_event_id(event);
+	if (id != kNoEvent) {
+		async_queue()->post(id, true);
+	}
+}
+
+void NotificationCenter::post(EventId id) {
+	if (id != kNoEvent) {
+		async_queue()->post(id, true);
+	}
+}
+
+bool NotificationCenter::try_post(const char *event) {
+	if (event == nullptr) {
+		throw ReferenceError();
+	}
+	EventId id = find_event_id(event);
+	if (id == kNoEvent) {
+		return true;
+	}
+	return async_queue()->post(id, false);
+}
+
+bool NotificationCenter::try_post(EventId id) {
+	if (id == kNoEvent) {
+		return true;
+	}
+	return async_queue()->post(id, false);
+}
+
+// wait until everything that was posted has been delivered
+void NotificationCenter::flush(void) {
+	NotifyQueue *q = async_.load(std::memory_order_acquire);
+	if (q != nullptr) {
+		q->flush();
+	}
+}
+
 void add_observer(Observer& o, const char *event) {
 	defaultNotificationCenter.add_observer(o, event);
 }
 
+void add_observer(Observer& o, EventId id) {
+	defaultNotificationCenter.add_observer(o, id);
+}
+
 // default argument: event = nullptr
 void remove_observer(Observer& o, const char *event) {
 	defaultNotificationCenter.remove_observer(o, event);
 }
 
+void remove_observer(Observer& o, EventId id) {
+	defaultNotificationCenter.remove_observer(o, id);
+}
+
 void notify(const char *event) {
 	defaultNotificationCenter.notify(event);
 }
 
+void notify(EventId id) {
+	defaultNotificationCenter.notify(id);
+}
+
+void post(const char *event) {
+	defaultNotificationCenter.post(event);
+}
+
+void post(EventId id) {
+	defaultNotificationCenter.post(id);
+}
+
 }	// namespace
 
 // EOB
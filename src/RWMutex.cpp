@@ -0,0 +1,167 @@
+/*
+	RWMutex.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/RWMutex.h"
+
+#include <climits>
+#include <sstream>
+#include <thread>
+
+namespace oo {
+
+static bool spinning_helps(void) {
+	static const bool multi_cpu = (std::thread::hardware_concurrency() > 1);
+	return multi_cpu;
+}
+
+void SpinMutex::lock_slow(void) {
+	if (spinning_helps()) {
+		// spin up to twice as long as it took on average, but at least a little
+		int limit = 2 * spins_.load(std::memory_order_relaxed) + 10;
+		if (limit > kMaxSpins) {
+			limit = kMaxSpins;
+		}
+		for(int n = 1; n <= limit; n++) {
+			cpu_relax();
+
+			uint32_t s = state_.load(std::memory_order_relaxed);
+			if (s == kUnlocked && state_.compare_exchange_weak(s, kLocked, std::memory_order_acquire, std::memory_order_relaxed)) {
+				// learn; move the average an eighth of the way
+				int avg = spins_.load(std::memory_order_relaxed);
+				spins_.store(avg + (n - avg) / 8, std::memory_order_relaxed);
+				return;
+			}
+		}
+		// spinning did not pay off; spin less next time
+		int avg = spins_.load(std::memory_order_relaxed);
+		spins_.store(avg + (limit - avg) / 8, std::memory_order_relaxed);
+	}
+
+	// go to sleep; mark the lock as contended so that unlock() wakes us
+	// once we own it this way, it stays marked as contended, so we may
+	// make one needless wakeup call later
+	while(state_.exchange(kContended, std::memory_order_acquire) != kUnlocked) {
+		futex_wait(&state_, kContended);
+	}
+}
+
+std::string RWMutex::repr(void) const {
+	uint32_t s = state_.load(std::memory_order_relaxed);
+	if (s & kWriter) {
+		if (s & kReaderMask) {
+			return "<RWMutex: writer waiting>";
+		}
+		return "<RWMutex: locked>";
+	}
+	if (s & kReaderMask) {
+		std::stringstream ss;
+		ss << "<RWMutex: " << (s & kReaderMask) << " readers>";
+		return ss.str();
+	}
+	return "<RWMutex>";
+}
+
+void RWMutex::lock(void) {
+	wmx_.lock();
+
+	// keep new readers out, then wait for the ones inside to leave
+	// writer_seq_ is read before looking at the readers; a reader that
+	// leaves after that changes writer_seq_, so we do not miss the wakeup
+	state_.fetch_or(kWriter, std::memory_order_seq_cst);
+	for(;;) {
+		uint32_t seq = writer_seq_.load(std::memory_order_seq_cst);
+		if ((state_.load(std::memory_order_seq_cst) & kReaderMask) == 0) {
+			break;
+		}
+		futex_wait(&writer_seq_, seq);
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+void RWMutex::unlock(void) {
+	uint32_t s = state_.fetch_and(~(kWriter | kReadersParked), std::memory_order_release);
+	wmx_.unlock();
+
+	if (s & kReadersParked) {
+		futex_wake(&state_, INT_MAX);
+	}
+}
+
+bool RWMutex::try_lock(void) {
+	if (!wmx_.try_lock()) {
+		return false;
+	}
+	uint32_t s = state_.load(std::memory_order_relaxed);
+	if ((s & kReaderMask) == 0 && state_.compare_exchange_strong(s, s | kWriter, std::memory_order_acquire, std::memory_order_relaxed)) {
+		return true;
+	}
+	wmx_.unlock();
+	return false;
+}
+
+void RWMutex::lock_shared_slow(void) {
+	uint32_t s = state_.load(std::memory_order_relaxed);
+	for(;;) {
+		if (!(s & kWriter)) {
+			if (state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return;
+			}
+			continue;
+		}
+
+		// a writer has it, or wants it; sleep until it unlocks
+		if (!(s & kReadersParked)) {
+			if (!state_.compare_exchange_weak(s, s | kReadersParked, std::memory_order_relaxed)) {
+				continue;
+			}
+			s |= kReadersParked;
+		}
+		futex_wait(&state_, s);
+		s = state_.load(std::memory_order_relaxed);
+	}
+}
+
+bool RWMutex::try_lock_shared(void) {
+	uint32_t s = state_.load(std::memory_order_relaxed);
+	while(!(s & kWriter)) {
+		if (state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void RWMutex::wake_writer(void) {
+	writer_seq_.fetch_add(1, std::memory_order_seq_cst);
+	futex_wake(&writer_seq_, 1);
+}
+
+}	// namespace
+
+// EOB
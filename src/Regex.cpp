@@ -161,7 +161,7 @@ void Regex::compile(int options) {
 	study_ = std::shared_ptr<pcre_extra>(extra, PcreStudyDeleter());
 }
 
-Match Regex::search(const String& s, int options) {
+Match Regex::search(const StringView& s, int options) {
 	precompile(options);
 
 	Match m;
@@ -172,7 +172,7 @@ Match Regex::search(const String& s, int options) {
 	return m;
 }
 
-Array<Array<String> > Regex::findall(const String& s, int options) {
+Array<Array<String> > Regex::findall(const StringView& s, int options) {
 	precompile(options);
 
 	Array<Array<String> > out;
@@ -184,12 +184,9 @@ Array<Array<String> > Regex::findall(const String& s, int options) {
 	capcount++;
 	int ovector[capcount * 3];
 
-	const char *subject = s.c_str();
-	if (subject == nullptr) {
-		throw ReferenceError();
-	}
-
-	int subject_len = std::strlen(subject);
+	// the subject need not be nul-terminated; pcre_exec() gets the length
+	const char *subject = s.data();
+	int subject_len = s.len();
 	int offset = 0;
 
 	// keep only options that can be passed to pcre_exec()
@@ -327,7 +324,7 @@ String Regex::escape(void) const {
 	return out;
 }
 
-void Match::prepare_(const String& subj, const pcre *re, const pcre_extra *sd) {
+void Match::prepare_(const StringView& subj, const pcre *re, const pcre_extra *sd) {
 	// prepare for execution; set ovector, copy nametable
 
 	if (pcre_fullinfo(re, sd, PCRE_INFO_CAPTURECOUNT, &ovecsize_) < 0) {
@@ -0,0 +1,138 @@
+/*
+	Select.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/Select.h"
+
+#include <algorithm>
+
+namespace oo {
+
+int Select::add(SelectCase *c) {
+	cases_.push_back(std::unique_ptr<SelectCase>(c));
+	enabled_.push_back(true);
+	return (int)cases_.size() - 1;
+}
+
+void Select::disable(int idx) {
+	if (idx < 0 || (size_t)idx >= cases_.size()) {
+		throw IndexError();
+	}
+	enabled_[idx] = false;
+}
+
+void Select::enable(int idx) {
+	if (idx < 0 || (size_t)idx >= cases_.size()) {
+		throw IndexError();
+	}
+	enabled_[idx] = true;
+}
+
+int Select::try_wait(void) {
+	size_t n = cases_.size();
+
+	for(size_t i = 0; i < n; i++) {
+		size_t idx = (next_ + i) % n;
+		if (enabled_[idx] && cases_[idx]->try_complete()) {
+			next_ = idx + 1;
+			return (int)idx;
+		}
+	}
+	return -1;
+}
+
+// unregister the first n cases
+void Select::disarm(SelectWaiter *waiter, size_t n) {
+	for(size_t i = 0; i < n; i++) {
+		if (enabled_[i]) {
+			cases_[i]->disarm(waiter);
+		}
+	}
+}
+
+int Select::wait(void) {
+	return wait_(nullptr);
+}
+
+int Select::wait_until(const std::chrono::steady_clock::time_point& deadline) {
+	return wait_(&deadline);
+}
+
+int Select::wait_(const std::chrono::steady_clock::time_point *deadline) {
+	if (std::find(enabled_.begin(), enabled_.end(), true) == enabled_.end()) {
+		// it would block forever
+		throw ValueError("select without cases");
+	}
+
+	SelectWaiter waiter;
+
+	for(;;) {
+		int idx = try_wait();
+		if (idx >= 0) {
+			return idx;
+		}
+
+		// register with all channels. A case may have become ready
+		// after we tried it; arm() checks again under the channel lock
+		waiter.reset();
+		bool ready = false;
+		size_t armed = 0;
+		try {
+			for(; armed < cases_.size(); armed++) {
+				if (enabled_[armed] && cases_[armed]->arm(&waiter)) {
+					armed++;
+					ready = true;
+					break;
+				}
+			}
+		} catch(...) {
+			disarm(&waiter, armed);
+			throw;
+		}
+
+		bool timeout = false;
+		if (!ready) {
+			if (deadline == nullptr) {
+				waiter.wait();
+			} else {
+				timeout = !waiter.wait_until(*deadline);
+			}
+		}
+
+		disarm(&waiter, armed);
+
+		if (timeout) {
+			// one last try
+			return try_wait();
+		}
+	}
+}
+
+}	// namespace
+
+// EOB
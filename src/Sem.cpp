@@ -31,8 +31,11 @@
 
 #include <cstdlib>
 #include <cerrno>
+#include <ctime>
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace oo {
 
@@ -71,6 +74,154 @@ bool Sem::trywait(void) {
 	return true;
 }
 
+void FastSem::wait_slow(void) {
+	waiters_.fetch_add(1, std::memory_order_seq_cst);
+	for(;;) {
+		uint32_t v = value_.load(std::memory_order_seq_cst);
+		if (v > 0) {
+			if (value_.compare_exchange_weak(v, v - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				break;
+			}
+			continue;
+		}
+		futex_wait(&value_, 0);
+	}
+	waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool FastSem::timedwait_slow(const std::chrono::steady_clock::time_point& deadline) {
+	bool ok = false;
+
+	waiters_.fetch_add(1, std::memory_order_seq_cst);
+	for(;;) {
+		uint32_t v = value_.load(std::memory_order_seq_cst);
+		if (v > 0) {
+			if (value_.compare_exchange_weak(v, v - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				ok = true;
+				break;
+			}
+			continue;
+		}
+		std::chrono::nanoseconds left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+		if (!futex_wait_for(&value_, 0, left)) {
+			// timed out, but take it if it came in just now
+			ok = trywait();
+			break;
+		}
+	}
+	waiters_.fetch_sub(1, std::memory_order_relaxed);
+	return ok;
+}
+
+/*
+	the sem_t lives in a page of anonymous shared memory, so that
+	it is shared with child processes. Only the process that created
+	it destroys it; in a child, it is only unmapped
+*/
+class SharedSemDeleter {
+public:
+	SharedSemDeleter() : pid_(::getpid()) { }
+
+	void operator()(sem_t *s) const {
+		if (s != nullptr) {
+			if (::getpid() == pid_) {
+				::sem_destroy(s);
+			}
+			::munmap(s, sizeof(sem_t));
+		}
+	}
+
+private:
+	pid_t pid_;
+};
+
+SharedSem::SharedSem(unsigned int value) : Base(), sem_() {
+	void *p = ::mmap(nullptr, sizeof(sem_t), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		throw OSError("failed to allocate shared memory for semaphore");
+	}
+	sem_t *s = (sem_t *)p;
+	if (::sem_init(s, 1, value) != 0) {
+		::munmap(p, sizeof(sem_t));
+		throw OSError("failed to initialize semaphore");
+	}
+	sem_ = std::shared_ptr<sem_t>(s, SharedSemDeleter());
+}
+
+std::string SharedSem::repr(void) const {
+	if (sem_.get() == nullptr) {
+		return "<SharedSem>";
+	}
+	std::stringstream ss;
+	ss << "<SharedSem: " << value() << ">";
+	return ss.str();
+}
+
+sem_t *SharedSem::get(void) const {
+	if (sem_.get() == nullptr) {
+		throw ReferenceError();
+	}
+	return sem_.get();
+}
+
+void SharedSem::wait(void) {
+	sem_t *s = get();
+	while(::sem_wait(s) != 0) {
+		if (errno != EINTR) {
+			throw OSError("semaphore wait failed");
+		}
+	}
+}
+
+void SharedSem::post(void) {
+	if (::sem_post(get()) != 0) {
+		throw OSError("semaphore post failed");
+	}
+}
+
+bool SharedSem::trywait(void) {
+	if (::sem_trywait(get()) != 0) {
+		if (errno == EAGAIN) {
+			return false;
+		}
+		throw OSError("semaphore trywait failed");
+	}
+	return true;
+}
+
+bool SharedSem::timedwait_ns(std::chrono::nanoseconds timeout) {
+	sem_t *s = get();
+
+	// sem_timedwait() takes a deadline on the realtime clock
+	struct timespec ts;
+	::clock_gettime(CLOCK_REALTIME, &ts);
+	long long ns = ts.tv_nsec + (long long)timeout.count();
+	ts.tv_sec += ns / 1000000000LL;
+	ts.tv_nsec = ns % 1000000000LL;
+	if (ts.tv_nsec < 0) {
+		ts.tv_sec--;
+		ts.tv_nsec += 1000000000LL;
+	}
+
+	while(::sem_timedwait(s, &ts) != 0) {
+		if (errno == ETIMEDOUT) {
+			return false;
+		}
+		if (errno != EINTR) {
+			throw OSError("semaphore timedwait failed");
+		}
+	}
+	return true;
+}
+
+int SharedSem::value(void) const {
+	int v = 0;
+	if (::sem_getvalue(get(), &v) != 0) {
+		throw OSError("semaphore getvalue failed");
+	}
+	return v;
+}
+
 }	// namespace
 
 // EOB
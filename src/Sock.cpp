@@ -365,9 +365,9 @@ void vfprint(Sock& sock, const char *fmt, std::va_list ap) {
 		throw ReferenceError();
 	}
 
-	std::stringstream ss;
-	vssprint(ss, fmt, ap);
-	sock.write(ss.str());
+	FormatBuffer buf;
+	buf.vformat(fmt, ap);
+	sock.write(buf.view());
 }
 
 }	// namespace
@@ -28,68 +28,69 @@
  */
 
 #include "oo/String.h"
+#include "oo/Dict.h"
+#include "oo/memsearch.h"
 #include "oo/print.h"
 
+#include <algorithm>
 #include <cctype>
+#include <vector>
 
 namespace oo {
 
 const String kStringStripDefaultCharSet = String(" \t\r\n\v\f");
-const size_t kSmallestString = 15;
+const size_t kSmallestString = 15;	// capacity of the inline buffer, minus nul byte
 
 
 String::String(const String& s) {
 	s_len = s.s_len;
-	s_cap = s.s_cap;
-	s_data = new char[s_cap];
-	std::memcpy(s_data, s.s_data, s_cap);
+	alloc(s_len + 1);
+	std::memcpy(s_data, s.s_data, s_len + 1);
+	s_hash.store(s.s_hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
 }
 
 String::String(const std::string& s) {
 	s_len = s.length();
-	s_cap = s_len + 1;
-	s_data = new char[s_cap];
-	std::memcpy(s_data, s.c_str(), s_cap);
+	alloc(s_len + 1);
+	std::memcpy(s_data, s.c_str(), s_len + 1);
 }
 
 String::String(const char *s) {
 	if (s == nullptr) {
 		s_len = 0;
-		s_cap = kSmallestString;
-		s_data = new char[s_cap];
+		alloc(1);
 		*s_data = 0;
 	} else {
 		s_len = std::strlen(s);
-		s_cap = s_len + 1;
-		s_data = new char[s_cap];
-		std::memcpy(s_data, s, s_cap);
+		alloc(s_len + 1);
+		std::memcpy(s_data, s, s_len + 1);
 	}
 }
 
 String::String(const char *s, size_t n) {
 	if (s == nullptr) {
 		s_len = 0;
-		s_cap = kSmallestString;
-		s_data = new char[s_cap];
+		alloc(1);
 		*s_data = 0;
 	} else {
-		s_cap = n + 1;
-		s_data = new char[s_cap];
-		std::strncpy(s_data, s, n);
+		// copy at most n bytes, but stop at a terminating nul byte
+		const char *z = (const char *)std::memchr(s, 0, n);
+		if (z != nullptr) {
+			n = z - s;
+		}
+		alloc(n + 1);
+		std::memcpy(s_data, s, n);
 		s_data[n] = 0;
-		s_len = std::strlen(s_data);
+		s_len = n;
 	}
 }
 
 String::String(const rune *r) {
-	if (r == nullptr) {
-		s_len = 0;
-		s_cap = kSmallestString;
-		s_data = new char[s_cap];
-		*s_data = 0;
-	} else {
-		s_len = s_cap = 0;
-		s_data = nullptr;
+	s_len = 0;
+	alloc(1);
+	*s_data = 0;
+
+	if (r != nullptr) {
 		grow(utf8_encoded_len(r) + 1);
 		utf8_encode(r, s_data, s_cap);
 		s_len = std::strlen(s_data);
@@ -99,8 +100,11 @@ String::String(const rune *r) {
 String::String(rune code) {
 	rune r[2] = { code, 0 };
 
-	s_len = s_cap = 0;
-	s_data = nullptr;
+	s_len = 0;
+	alloc(1);
+	*s_data = 0;
+
+	// a single rune is at most 4 bytes; always fits in the inline buffer
 	grow(utf8_encoded_len(r) + 1);
 	utf8_encode(r, s_data, s_cap);
 	s_len = std::strlen(s_data);
@@ -118,10 +122,9 @@ void String::grow(size_t n) {
 	n &= ~15;
 
 	char *new_data = new char[n];
-	new_data[0] = 0;
+	std::memcpy(new_data, s_data, s_len + 1);
 
-	if (s_data != nullptr) {
-		std::memcpy(new_data, s_data, s_len + 1);
+	if (s_data != s_buf) {
 		delete [] s_data;
 	}
 	s_data = new_data;
@@ -155,6 +158,7 @@ String& String::operator+=(const String& s) {
 	grow(s_len + s.s_len + 1);
 	std::memcpy(s_data + s_len, s.s_data, s.s_len + 1);
 	s_len += s.s_len;
+	invalidate_hash();
 	return *this;
 }
 
@@ -169,6 +173,7 @@ String& String::operator+=(rune code) {
 	rune r[2] = { code, 0 };
 	utf8_encode(r, s_data + s_len, n + 1);
 	s_len += n;
+	invalidate_hash();
 	return *this;
 }
 
@@ -191,221 +196,21 @@ String& String::operator*=(int n) {
 	}
 	s_len = data_len;
 	s_data[s_len] = 0;
+	invalidate_hash();
 	return *this;
 }
 
-// default arguments start=0, end=0
-int String::find(rune r, int start, int end) const {
-	if (r >= 0x80) {
-		String s(r);
-		return find(s, start, end);
-	}
-
-	if (start < 0) {
-		start += s_len;
-
-		if (start < 0) {
-			return -1;
-		}
-	}
-	if (end <= 0) {
-		end += s_len;
-
-		if (end <= 0) {
-			return -1;
-		}
-	}
-	if ((size_t)end > s_len) {
-		end = s_len;
-	}
-	if ((size_t)start >= s_len || start >= end) {
-		return -1;
-	}
-
-	for(int pos = start; (size_t)pos <= end; pos++) {
-		if (s_data[pos] == r) {
-			return pos;
-		}
-	}
-	return -1;
-}
-
-// default arguments start=0, end=0
-int String::rfind(rune r, int start, int end) const {
-	if (r >= 0x80) {
-		String s(r);
-		return rfind(s, start, end);
-	}
-
-	if (start < 0) {
-		start += s_len;
-
-		if (start < 0) {
-			return -1;
-		}
-	}
-	if (end <= 0) {
-		end += s_len;
-
-		if (end <= 0) {
-			return -1;
-		}
-	}
-	if ((size_t)end > s_len) {
-		end = s_len;
-	}
-	if ((size_t)start >= s_len || start >= end) {
-		return -1;
-	}
-
-	for(int pos = end-1; pos >= start; pos--) {
-		if (s_data[pos] == r) {
-			return pos;
-		}
-	}
-	return -1;
-}
-
-// default arguments start=0, end=0
-int String::find(const String& s, int start, int end) const {
-	if (start < 0) {
-		start += s_len;
-
-		if (start < 0) {
-			return -1;
-		}
-	}
-
-	// end must be at least at 'distance' of length of search string
-	end -= s.len();
-
-	if (end <= 0) {
-		end += s_len;
-
-		if (end <= 0) {
-			return -1;
-		}
-	}
-	if ((size_t)end > s_len) {
-		end = len();
-	}
-	if ((size_t)start >= s_len || start > end) {
-		return -1;
-	}
-
-	for(int pos = start; pos <= end; pos++) {
-		if (!std::strncmp(s_data + pos, s.s_data, s.s_len)) {
-			return pos;
-		}
-	}
-	return -1;
-}
-
-// default arguments start=0, end=0
-int String::rfind(const String& s, int start, int end) const {
-	if (start < 0) {
-		start += s_len;
-
-		if (start < 0) {
-			return -1;
-		}
-	}
-
-	// end must be at least at 'distance' of length of search string
-	end -= s.len();
-
-	if (end <= 0) {
-		end += s_len;
-
-		if (end <= 0) {
-			return -1;
-		}
-	}
-	if ((size_t)end > s_len) {
-		end = len();
-	}
-	if ((size_t)start >= s_len || start > end) {
-		return -1;
-	}
-
-	for(int pos = end; pos >= start; pos--) {
-		if (!std::strncmp(s_data + pos, s.s_data, s.s_len)) {
-			return pos;
-		}
-	}
-	return -1;
-}
-
-// default argument is a default strippin charset
-String String::strip(const String& charset) const {
-	if (!s_len) {
-		return String(*this);
-	}
-
-	// lstrip
-	char *p = s_data;
-	while(*p) {
-		if (charset.find(*p) == -1) {
-			break;
-		}
-		p++;
-	}
-	if (!*p) {
-		return String();
-	}
-
-	String s(p);
-
-	// rstrip
-	int l = s.len() - 1;
-	while(l >= 0) {
-		if (charset.find(s.s_data[l]) == -1) {
-			break;
-		}
-		s.s_data[l--] = 0;
-		s.s_len--;
-	}
-	if (!s) {
-		return String();
-	}
-	return s;
+// default argument is a default stripping charset
+String String::strip(const StringView& charset) const {
+	return String(view().strip(charset));
 }
 
-String String::lstrip(const String& charset) const {
-	if (!s_len) {
-		return String(*this);
-	}
-
-	// lstrip
-	char *p = s_data;
-	while(*p) {
-		if (charset.find(*p) == -1) {
-			break;
-		}
-		p++;
-	}
-	if (!*p) {
-		return String();
-	}
-	return String(p);
+String String::lstrip(const StringView& charset) const {
+	return String(view().lstrip(charset));
 }
 
-String String::rstrip(const String& charset) const {
-	String s(*this);
-
-	// rstrip
-	int l = s.len() - 1;
-	while(l >= 0) {
-		if (charset.find(s.s_data[l]) == -1) {
-			break;
-		}
-		s.s_data[l--] = 0;
-		s.s_len--;
-	}
-	if (!s) {
-		return String();
-	}
-	return s;
+String String::rstrip(const StringView& charset) const {
+	return String(view().rstrip(charset));
 }
 
 String String::upper(void) const {
@@ -418,6 +223,7 @@ String String::upper(void) const {
 		}
 		p++;
 	}
+	s.invalidate_hash();
 	return s;
 }
 
@@ -431,6 +237,7 @@ String String::lower(void) const {
 		}
 		p++;
 	}
+	s.invalidate_hash();
 	return s;
 }
 
@@ -441,6 +248,7 @@ String String::capitalize(void) const {
 	if (*p >= 'a' && *p <= 'z') {
 		*p -= ' ';
 	}
+	s.invalidate_hash();
 	return s;
 }
 
@@ -463,6 +271,7 @@ String String::capwords(void) const {
 		}
 		p++;
 	}
+	s.invalidate_hash();
 	return s;
 }
 
@@ -494,56 +303,150 @@ String String::slice(int idx1, int idx2) const {
 }
 
 // default argument n == -1 (replace all)
-String String::replace(const String& sub, const String& repl, int n) const {
+String String::replace(const StringView& sub, const StringView& repl, int n) const {
 	if (!n) {
 		return *this;
 	}
 
-	std::string s = s_data;
+	const char *end = s_data + s_len;
+	const char *p;
 
-	size_t pos = 0;
+	// first count the matches, so we can allocate the result in one go
+	size_t count = 0;
+	if (sub.empty()) {
+		// insert repl before every byte, and at the end
+		count = s_len + 1;
+		if (n > 0 && count > (size_t)n) {
+			count = n;
+		}
+	} else {
+		p = s_data;
+		while(n < 0 || count < (size_t)n) {
+			p = memfind(p, end - p, sub.data(), sub.len());
+			if (p == nullptr) {
+				break;
+			}
+			count++;
+			p += sub.len();
+		}
+	}
+	if (!count) {
+		return *this;
+	}
 
-	while(true) {
-		pos = s.find(sub.s_data, pos);
-		if (pos == std::string::npos) {
-			break;
+	String s;
+	s.grow(s_len - count * sub.len() + count * repl.len() + 1);
+
+	char *out = s.s_data;
+	const char *q;
+	p = s_data;
+
+	for(size_t i = 0; i < count; i++) {
+		q = sub.empty() ? p : memfind(p, end - p, sub.data(), sub.len());
+
+		std::memcpy(out, p, q - p);
+		out += q - p;
+		std::memcpy(out, repl.data(), repl.len());
+		out += repl.len();
+		p = q + sub.len();
+
+		if (sub.empty() && p < end) {
+			*out++ = *p++;
 		}
-		s.replace(pos, sub.len(), repl.s_data);
-		pos += repl.len();
+	}
+	std::memcpy(out, p, end - p);
+	out += end - p;
+	*out = 0;
+	s.s_len = out - s.s_data;
+	return s;
+}
 
-		if (n > 0) {
-			n--;
-			if (!n) {
+String String::replace_many(const Dict<String>& d) const {
+	typedef std::pair<const String, String> Entry;
+
+	// index the keys by their first byte, longest keys first
+	std::vector<std::vector<const Entry *> > table(256);
+
+	for(auto it = d.cbegin(); it != d.cend(); ++it) {
+		if (!it->first.empty()) {
+			table[(byte)it->first.s_data[0]].push_back(&*it);
+		}
+	}
+	for(auto& candidates : table) {
+		std::stable_sort(candidates.begin(), candidates.end(),
+			[](const Entry *a, const Entry *b) {
+				return a->first.s_len > b->first.s_len;
+			});
+	}
+
+	// scan once and remember where the matches are
+	std::vector<std::pair<size_t, const Entry *> > matches;
+	size_t new_len = s_len;
+
+	size_t pos = 0;
+	while(pos < s_len) {
+		const Entry *found = nullptr;
+
+		for(auto kv : table[(byte)s_data[pos]]) {
+			if (kv->first.s_len <= s_len - pos
+				&& !std::memcmp(s_data + pos, kv->first.s_data, kv->first.s_len)) {
+				found = kv;
 				break;
 			}
 		}
+		if (found == nullptr) {
+			pos++;
+			continue;
+		}
+		matches.push_back(std::make_pair(pos, found));
+		new_len = new_len - found->first.s_len + found->second.s_len;
+		pos += found->first.s_len;
 	}
-	return String(s);
+	if (matches.empty()) {
+		return *this;
+	}
+
+	// build the result in a single allocation
+	String s;
+	s.grow(new_len + 1);
+
+	char *out = s.s_data;
+	pos = 0;
+	for(auto& m : matches) {
+		std::memcpy(out, s_data + pos, m.first - pos);
+		out += m.first - pos;
+		std::memcpy(out, m.second->second.s_data, m.second->second.s_len);
+		out += m.second->second.s_len;
+		pos = m.first + m.second->first.s_len;
+	}
+	std::memcpy(out, s_data + pos, s_len - pos);
+	out += s_len - pos;
+	*out = 0;
+	s.s_len = out - s.s_data;
+	return s;
 }
 
 // default argument sep = ' '
 Array<String> String::split(rune sep) const {
+	Array<String> a;
+
 	if (!s_len) {
-		return Array<String>();
+		return a;
 	}
+	for(const StringView& field : isplit(sep)) {
+		a.append(String(field));
+	}
+	return a;
+}
 
-	const String search(sep);
-
+Array<String> String::split(const StringView& sep) const {
 	Array<String> a;
 
-	char *p = s_data;
-	int pos, start = 0;
-	while(true) {
-		pos = find(search, start);
-		if (pos == -1) {
-			a.append(String(p));
-			break;
-		}
-
-		a.append(String(p, pos - start));
-
-		start = pos + search.len();
-		p = s_data + start;
+	if (!s_len) {
+		return a;
+	}
+	for(const StringView& field : isplit(sep)) {
+		a.append(String(field));
 	}
 	return a;
 }
@@ -739,11 +642,9 @@ String vsprint(const char *fmt, va_list ap) {
 		return String();
 	}
 
-	std::stringstream ss;
-
-	vssprint(ss, fmt, ap);
-
-	return String(ss.str());
+	FormatBuffer buf;
+	buf.vformat(fmt, ap);
+	return String(buf.view());
 }
 
 }	// namespace
@@ -0,0 +1,327 @@
+/*
+	StringView.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/StringView.h"
+#include "oo/String.h"
+#include "oo/memsearch.h"
+
+namespace oo {
+
+const StringView kStringViewStripDefaultCharSet = StringView(" \t\r\n\v\f");
+
+
+rune StringView::operator[](int idx) const {
+	if (!len_) {
+		throw IndexError();
+	}
+	if (idx < 0) {
+		idx += len_;
+		if (idx < 0) {
+			throw IndexError();
+		}
+	}
+	if ((size_t)idx > len_) {
+		throw IndexError();
+	}
+	if ((size_t)idx == len_) {
+		return 0;
+	}
+	return data_[idx] & 0xff;
+}
+
+bool StringView::operator<(const StringView& v) const {
+	size_t n = (len_ < v.len_) ? len_ : v.len_;
+
+	int cmp = std::memcmp(data_, v.data_, n);
+	if (cmp != 0) {
+		return cmp < 0;
+	}
+	return len_ < v.len_;
+}
+
+// default arguments start=0, end=0
+int StringView::find(rune r, int start, int end) const {
+	if (r >= 0x80) {
+		// a String of a single rune fits in its inline buffer
+		String s(r);
+		return find(StringView(s), start, end);
+	}
+
+	if (start < 0) {
+		start += len_;
+
+		if (start < 0) {
+			return -1;
+		}
+	}
+	if (end <= 0) {
+		end += len_;
+
+		if (end <= 0) {
+			return -1;
+		}
+	}
+	if ((size_t)end > len_) {
+		end = len_;
+	}
+	if ((size_t)start >= len_ || start >= end) {
+		return -1;
+	}
+
+	const char *p = memfind_byte(data_ + start, end - start, (char)r);
+	if (p == nullptr) {
+		return -1;
+	}
+	return p - data_;
+}
+
+// default arguments start=0, end=0
+int StringView::rfind(rune r, int start, int end) const {
+	if (r >= 0x80) {
+		String s(r);
+		return rfind(StringView(s), start, end);
+	}
+
+	if (start < 0) {
+		start += len_;
+
+		if (start < 0) {
+			return -1;
+		}
+	}
+	if (end <= 0) {
+		end += len_;
+
+		if (end <= 0) {
+			return -1;
+		}
+	}
+	if ((size_t)end > len_) {
+		end = len_;
+	}
+	if ((size_t)start >= len_ || start >= end) {
+		return -1;
+	}
+
+	const char *p = memrfind_byte(data_ + start, end - start, (char)r);
+	if (p == nullptr) {
+		return -1;
+	}
+	return p - data_;
+}
+
+// default arguments start=0, end=0
+int StringView::find(const StringView& s, int start, int end) const {
+	if (start < 0) {
+		start += len_;
+
+		if (start < 0) {
+			return -1;
+		}
+	}
+
+	// end 0 means: up to the end; a negative end counts from the end
+	if (end <= 0) {
+		end += len_;
+
+		if (end < 0) {
+			return -1;
+		}
+	}
+	if ((size_t)end > len_) {
+		end = len_;
+	}
+	if ((size_t)start >= len_ || s.len_ > (size_t)end) {
+		return -1;
+	}
+
+	// the last position where the search string fits
+	// a match may take up the whole view
+	end -= s.len_;
+	if (start > end) {
+		return -1;
+	}
+
+	// search positions start .. end (inclusive)
+	const char *p = memfind(data_ + start, end - start + s.len_, s.data_, s.len_);
+	if (p == nullptr) {
+		return -1;
+	}
+	return p - data_;
+}
+
+// default arguments start=0, end=0
+int StringView::rfind(const StringView& s, int start, int end) const {
+	if (start < 0) {
+		start += len_;
+
+		if (start < 0) {
+			return -1;
+		}
+	}
+
+	// end 0 means: up to the end; a negative end counts from the end
+	if (end <= 0) {
+		end += len_;
+
+		if (end < 0) {
+			return -1;
+		}
+	}
+	if ((size_t)end > len_) {
+		end = len_;
+	}
+	if ((size_t)start >= len_ || s.len_ > (size_t)end) {
+		return -1;
+	}
+
+	// the last position where the search string fits
+	// a match may take up the whole view
+	end -= s.len_;
+	if (start > end) {
+		return -1;
+	}
+
+	const char *p = memrfind(data_ + start, end - start + s.len_, s.data_, s.len_);
+	if (p == nullptr) {
+		return -1;
+	}
+	return p - data_;
+}
+
+// default argument is a default stripping charset
+StringView StringView::strip(const StringView& charset) const {
+	return lstrip(charset).rstrip(charset);
+}
+
+StringView StringView::lstrip(const StringView& charset) const {
+	size_t i = 0;
+	while(i < len_) {
+		if (charset.find(data_[i] & 0xff) == -1) {
+			break;
+		}
+		i++;
+	}
+	return StringView(data_ + i, len_ - i);
+}
+
+StringView StringView::rstrip(const StringView& charset) const {
+	size_t l = len_;
+	while(l > 0) {
+		if (charset.find(data_[l - 1] & 0xff) == -1) {
+			break;
+		}
+		l--;
+	}
+	return StringView(data_, l);
+}
+
+StringView StringView::slice(int idx1, int idx2) const {
+	if (idx1 < 0) {
+		idx1 += len_;
+
+		if (idx1 < 0)
+			idx1 = 0;
+	}
+	if ((size_t)idx1 >= len_) {
+		return StringView();
+	}
+	if (idx2 < 0) {
+		idx2 += len_;
+
+		if (idx2 < 0) {
+			idx2 = 0;
+		}
+	}
+	if ((size_t)idx2 > len_) {
+		idx2 = len_;
+	}
+	if (idx1 >= idx2) {
+		return StringView();
+	}
+	return StringView(data_ + idx1, idx2 - idx1);
+}
+
+SplitIter::SplitIter(const StringView& s, rune r) : rest_(s), sep_(), lines_(false), done_(false) {
+	if (!r) {
+		throw ValueError("empty separator");
+	}
+
+	String enc(r);
+	sep_.assign(enc.c_str(), enc.len());
+}
+
+bool SplitIter::next(StringView& field) {
+	if (done_) {
+		return false;
+	}
+
+	if (lines_) {
+		if (rest_.empty()) {
+			done_ = true;
+			return false;
+		}
+
+		int pos = rest_.find('\n');
+		if (pos == -1) {
+			field = rest_;
+			rest_ = StringView();
+			done_ = true;
+			return true;
+		}
+
+		size_t l = pos;
+		if (l > 0 && rest_.data()[l - 1] == '\r') {
+			l--;
+		}
+		field = StringView(rest_.data(), l);
+		rest_ = StringView(rest_.data() + pos + 1, rest_.len() - pos - 1);
+		return true;
+	}
+
+	const StringView s = sep();
+
+	// the separator may be all that is left, as in "a,"
+	const char *p = memfind(rest_.data(), rest_.len(), s.data(), s.len());
+	if (p == nullptr) {
+		field = rest_;
+		rest_ = StringView();
+		done_ = true;
+		return true;
+	}
+
+	size_t pos = p - rest_.data();
+	field = StringView(rest_.data(), pos);
+	rest_ = StringView(p + s.len(), rest_.len() - pos - s.len());
+	return true;
+}
+
+}	// namespace
+
+// EOB
@@ -0,0 +1,163 @@
+/*
+	TaskGroup.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/TaskGroup.h"
+#include "oo/futex.h"
+
+namespace oo {
+
+void WaitGroup::add(uint32_t n) {
+	uint32_t prev = state_.fetch_add(n, std::memory_order_relaxed);
+	if ((prev & kCountMask) + n > kCountMask) {
+		state_.fetch_sub(n, std::memory_order_relaxed);
+		throw ValueError("WaitGroup count overflow");
+	}
+}
+
+void WaitGroup::done(void) {
+	uint32_t prev = state_.fetch_sub(1, std::memory_order_acq_rel);
+
+	if (!(prev & kCountMask)) {
+		state_.fetch_add(1, std::memory_order_relaxed);
+		throw RuntimeError("WaitGroup::done() without add()");
+	}
+	if ((prev & kCountMask) == 1 && (prev & kWaiters)) {
+		// only the address is used; the waiter may be gone already
+		futex_wake(&state_);
+	}
+}
+
+void WaitGroup::wait(void) {
+	uint32_t s = state_.load(std::memory_order_acquire);
+
+	for(;;) {
+		if (!(s & kCountMask)) {
+			break;
+		}
+		if (!(s & kWaiters)) {
+			// tell done() to wake us up
+			if (!state_.compare_exchange_weak(s, s | kWaiters, std::memory_order_acq_rel, std::memory_order_acquire)) {
+				continue;
+			}
+			s |= kWaiters;
+		}
+		futex_wait(&state_, s);
+		s = state_.load(std::memory_order_acquire);
+	}
+
+	// the count is zero; clear the waiters bit for the next round
+	// (if some other waiter still sleeps, it is woken up all the same)
+	state_.compare_exchange_strong(s, 0, std::memory_order_relaxed);
+}
+
+TaskGroup::~TaskGroup() {
+	wait_();
+}
+
+bool TaskGroup::TaskQueue::pop(std::function<void()>& f) {
+	std::lock_guard<std::mutex> lk(mx);
+	if (tasks.empty()) {
+		return false;
+	}
+	f = std::move(tasks.front());
+	tasks.pop_front();
+	return true;
+}
+
+void TaskGroup::submit(std::function<void()> f) {
+	wg_.add(1);
+	{
+		std::lock_guard<std::mutex> lk(queue_->mx);
+		queue_->tasks.push_back([this, f]() {
+			this->run(f);
+		});
+	}
+	// the pool runs the next one; unless the waiter beat it to it
+	std::shared_ptr<TaskQueue> q = queue_;
+	try {
+		pool_.submit([q]() {
+			std::function<void()> task;
+			if (q->pop(task)) {
+				task();
+			}
+		});
+	} catch(...) {
+		// take it back, unless the waiter already ran it
+		std::lock_guard<std::mutex> lk(queue_->mx);
+		if (!queue_->tasks.empty()) {
+			queue_->tasks.pop_back();
+			wg_.done();
+		}
+		throw;
+	}
+}
+
+void TaskGroup::run(const std::function<void()>& f) {
+	if (!token_.cancelled()) {
+		try {
+			f();
+		} catch(...) {
+			std::lock_guard<std::mutex> lk(mx_);
+			if (!error_) {
+				error_ = std::current_exception();
+			}
+			token_.cancel();
+		}
+	}
+	// after this, the group may be gone
+	wg_.done();
+}
+
+// wait, but do not throw
+void TaskGroup::wait_(void) {
+	// run what has not started yet, then wait for the rest
+	std::function<void()> task;
+	while(queue_->pop(task)) {
+		task();
+	}
+	wg_.wait();
+}
+
+void TaskGroup::wait(void) {
+	wait_();
+
+	std::exception_ptr e;
+	{
+		std::lock_guard<std::mutex> lk(mx_);
+		e = error_;
+		error_ = nullptr;
+	}
+	if (e) {
+		std::rethrow_exception(e);
+	}
+}
+
+}	// namespace
+
+// EOB
@@ -0,0 +1,468 @@
+/*
+	ThreadPool.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/ThreadPool.h"
+#include "oo/Error.h"
+#include "oo/go.h"
+
+#include <cstdlib>
+#include <new>
+#include <system_error>
+
+namespace oo {
+
+thread_local ThreadPool *ThreadPool::current_pool_ = nullptr;
+thread_local ThreadPool::Worker *ThreadPool::current_worker_ = nullptr;
+
+ThreadPool::ThreadPool(size_t n) : ThreadPool(n, n) { }
+
+ThreadPool::ThreadPool(size_t min_threads, size_t max_threads, std::chrono::milliseconds linger) : Base(),
+	mx_(), work_(), done_(), stalled_(), queue_(), queue_len_(0), slots_(), free_slots_(), snapshot_(nullptr),
+	old_snapshots_(), monitor_(), min_threads_(min_threads), max_threads_(max_threads), core_threads_(0),
+	linger_(linger), threads_(0), idle_(0), pending_(0), monitor_asleep_(false), stop_(false) {
+
+	if (max_threads < 1 || min_threads > max_threads) {
+		throw ValueError();
+	}
+
+	// up to one worker per CPU is started right away
+	size_t ncpu = std::thread::hardware_concurrency();
+	core_threads_ = (ncpu > min_threads_) ? ncpu : min_threads_;
+	if (core_threads_ < 1) {
+		core_threads_ = 1;
+	}
+	if (core_threads_ > max_threads_) {
+		core_threads_ = max_threads_;
+	}
+
+	snapshot_.store(new WorkerList(), std::memory_order_release);
+
+	std::lock_guard<std::mutex> lk(mx_);
+	while(threads_ < min_threads_) {
+		spawn();
+	}
+
+	// a task may block while its children wait in its deque;
+	// the monitor adds a worker to get them going
+	if (max_threads_ > core_threads_) {
+		try {
+			monitor_ = std::thread(&ThreadPool::monitor_main, this);
+		} catch(const std::system_error&) {
+			throw OSError("failed to start thread");
+		}
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	shutdown();
+
+	for(Worker *w : slots_) {
+		delete_worker(w);
+	}
+	delete snapshot_.load(std::memory_order_relaxed);
+	for(const WorkerList *list : old_snapshots_) {
+		delete list;
+	}
+}
+
+bool ThreadPool::operator!(void) const {
+	std::lock_guard<std::mutex> lk(mx_);
+	return stop_;
+}
+
+// operator new does not align to a cache line (before C++17)
+ThreadPool::Worker *ThreadPool::new_worker(void) {
+	void *mem = nullptr;
+	if (::posix_memalign(&mem, alignof(Worker), sizeof(Worker)) != 0) {
+		throw MemoryError();
+	}
+	return new(mem) Worker();
+}
+
+void ThreadPool::delete_worker(Worker *w) {
+	w->~Worker();
+	std::free(w);
+}
+
+// start a worker; the lock must be held
+void ThreadPool::spawn(void) {
+	Worker *w;
+
+	if (!free_slots_.empty()) {
+		w = free_slots_.back();
+		free_slots_.pop_back();
+	} else {
+		w = new_worker();
+		w->seed = (uint32_t)(slots_.size() + 1) * 2654435761U;
+		slots_.push_back(w);
+
+		// thieves look at a copy of the list, so they need no lock
+		old_snapshots_.push_back(snapshot_.load(std::memory_order_relaxed));
+		snapshot_.store(new WorkerList(slots_), std::memory_order_release);
+	}
+
+	try {
+		w->thread = std::thread(&ThreadPool::worker_main, this, w);
+	} catch(const std::system_error&) {
+		free_slots_.push_back(w);
+		throw OSError("failed to start thread");
+	}
+	threads_++;
+}
+
+void ThreadPool::submit(std::function<void()> f) {
+	Task *task = new Task(std::move(f));
+
+	if (current_pool_ == this) {
+		pending_++;
+		push_local(current_worker_, task);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lk(mx_);
+
+	if (stop_) {
+		delete task;
+		throw RuntimeError("submit on stopped thread pool");
+	}
+
+	// every idle worker will take one task from the queue
+	// if there are more tasks than that, we need a new worker
+	size_t idle = idle_;
+	bool busy = (queue_.size() >= idle);
+	bool spawned = false;
+	if (busy && threads_ < core_threads_) {
+		try {
+			spawn();
+		} catch(...) {
+			delete task;
+			throw;
+		}
+		spawned = true;
+	}
+
+	queue_.push_back(task);
+	queue_len_++;
+	pending_++;
+
+	if (idle > 0) {
+		work_.notify_one();
+	}
+	if (busy && !spawned && threads_ < max_threads_) {
+		wake_monitor();
+	}
+}
+
+// a task submits a task; it goes on the deque of the worker
+void ThreadPool::push_local(Worker *w, Task *task) {
+	w->deque.push(task);
+
+	// pairs with a worker or the monitor that goes to sleep:
+	// either they see the task, or we see them
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (idle_.load(std::memory_order_seq_cst) > 0
+		|| monitor_asleep_.load(std::memory_order_seq_cst)
+		|| threads_.load(std::memory_order_relaxed) < core_threads_) {
+		std::lock_guard<std::mutex> lk(mx_);
+
+		if (idle_ > 0) {
+			work_.notify_one();
+		} else if (threads_ < core_threads_ && !stop_) {
+			try {
+				spawn();
+			} catch(const OSError&) {
+				// the task is queued; the workers we have will run it
+			}
+		}
+		if (monitor_asleep_) {
+			stalled_.notify_one();
+		}
+	}
+}
+
+void ThreadPool::worker_main(Worker *me) {
+	current_pool_ = this;
+	current_worker_ = me;
+
+	uint32_t tick = 0;
+
+	for(;;) {
+		Task *task = next_task(me, tick++);
+		if (task != nullptr) {
+			run(me, task);
+			continue;
+		}
+
+		// nothing to do; go to sleep
+		std::unique_lock<std::mutex> lk(mx_);
+
+		idle_++;
+		if (work_waiting()) {
+			idle_--;
+			continue;
+		}
+		if (stop_) {
+			idle_--;
+			break;
+		}
+		if (threads_ > min_threads_) {
+			if (work_.wait_for(lk, linger_) == std::cv_status::timeout
+				&& !work_waiting() && !stop_ && threads_ > min_threads_) {
+				idle_--;
+				retire(me);
+				break;
+			}
+		} else {
+			work_.wait(lk);
+		}
+		idle_--;
+	}
+
+	current_pool_ = nullptr;
+	current_worker_ = nullptr;
+}
+
+// own deque first, newest first; then the shared queue; then steal
+ThreadPool::Task *ThreadPool::next_task(Worker *me, uint32_t tick) {
+	Task *task;
+
+	// now and then, look at the shared queue first;
+	// a task that keeps on spawning would starve it otherwise
+	if (tick % kThreadPoolFairness == 0 && (task = take_queued()) != nullptr) {
+		return task;
+	}
+	if (me->deque.pop(task)) {
+		return task;
+	}
+	if ((task = take_queued()) != nullptr) {
+		return task;
+	}
+	return steal(me);
+}
+
+ThreadPool::Task *ThreadPool::take_queued(void) {
+	if (!queue_len_.load(std::memory_order_relaxed)) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lk(mx_);
+
+	if (queue_.empty()) {
+		return nullptr;
+	}
+	Task *task = queue_.front();
+	queue_.pop_front();
+	queue_len_--;
+	return task;
+}
+
+// take the oldest task of some other worker
+ThreadPool::Task *ThreadPool::steal(Worker *me) {
+	const WorkerList *list = snapshot_.load(std::memory_order_acquire);
+	size_t n = list->size();
+	if (n < 2) {
+		return nullptr;
+	}
+
+	for(int attempt = 0; attempt < 2; attempt++) {
+		// start at a random victim, so thieves don't all go for the same one
+		me->seed ^= me->seed << 13;
+		me->seed ^= me->seed >> 17;
+		me->seed ^= me->seed << 5;
+		size_t start = me->seed % n;
+
+		bool aborted = false;
+		for(size_t i = 0; i < n; i++) {
+			Worker *victim = (*list)[(start + i) % n];
+			if (victim == me) {
+				continue;
+			}
+
+			Task *task;
+			StealResult r = victim->deque.steal(task);
+			if (r == StealOK) {
+				return task;
+			}
+			if (r == StealAbort) {
+				aborted = true;
+			}
+		}
+		if (!aborted) {
+			break;
+		}
+	}
+	return nullptr;
+}
+
+bool ThreadPool::work_waiting(void) const {
+	if (queue_len_.load(std::memory_order_seq_cst) > 0) {
+		return true;
+	}
+	const WorkerList *list = snapshot_.load(std::memory_order_acquire);
+	for(const Worker *w : *list) {
+		if (!w->deque.empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t ThreadPool::tasks_started(void) const {
+	uint64_t n = 0;
+
+	const WorkerList *list = snapshot_.load(std::memory_order_acquire);
+	for(const Worker *w : *list) {
+		n += w->started.load(std::memory_order_relaxed);
+	}
+	return n;
+}
+
+void ThreadPool::run(Worker *me, Task *task) {
+	me->started.store(me->started.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	// a task is not a goroutine, and has no tid; go() gives it one
+	// The tid of a task that waits, and runs this one, is put back
+	unsigned int tid = swap_tid__((unsigned int)-1);
+	(*task)();
+	swap_tid__(tid);
+	delete task;
+
+	if (pending_.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> lk(mx_);
+		done_.notify_all();
+	}
+}
+
+// a surplus worker leaves the pool; the lock must be held
+void ThreadPool::retire(Worker *me) {
+	me->thread.detach();
+	free_slots_.push_back(me);
+	threads_--;
+}
+
+// the lock must be held
+void ThreadPool::wake_monitor(void) {
+	// if it is not asleep, it is watching already
+	if (monitor_asleep_) {
+		stalled_.notify_one();
+	}
+}
+
+/*
+	the monitor adds a worker when tasks are waiting, and for a while
+	no worker was free to start one. This means the workers are blocked,
+	and without an extra worker the pool might never get unstuck
+	Adding workers only then keeps a burst of short tasks from starting
+	a thread for each of them
+*/
+void ThreadPool::monitor_main(void) {
+	std::unique_lock<std::mutex> lk(mx_);
+
+	while(!stop_) {
+		if (!work_waiting()) {
+			// submit() and push_local() wake us up when tasks have to wait
+			monitor_asleep_ = true;
+			if (!work_waiting() && !stop_) {
+				stalled_.wait(lk);
+			}
+			monitor_asleep_ = false;
+			continue;
+		}
+
+		uint64_t seen = tasks_started();
+		stalled_.wait_for(lk, kThreadPoolStall, [this](){ return this->stop_; });
+
+		if (!stop_ && !idle_ && threads_ < max_threads_ && tasks_started() == seen && work_waiting()) {
+			try {
+				spawn();
+			} catch(const OSError&) {
+				// try again later
+			}
+		}
+	}
+}
+
+bool ThreadPool::run_one(void) {
+	if (current_pool_ != this) {
+		return false;
+	}
+
+	// tick 1 skips the fairness check; we want our own work first
+	Task *task = next_task(current_worker_, 1);
+	if (task == nullptr) {
+		return false;
+	}
+	run(current_worker_, task);
+	return true;
+}
+
+void ThreadPool::wait(void) {
+	std::unique_lock<std::mutex> lk(mx_);
+	done_.wait(lk, [this](){ return this->pending_ == 0; });
+}
+
+void ThreadPool::shutdown(void) {
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> lk(mx_);
+		stop_ = true;
+		work_.notify_all();
+		stalled_.notify_all();
+
+		for(Worker *w : slots_) {
+			if (w->thread.joinable()) {
+				threads.push_back(std::move(w->thread));
+			}
+		}
+	}
+
+	if (monitor_.joinable()) {
+		monitor_.join();
+	}
+	for(auto& t : threads) {
+		t.join();
+	}
+}
+
+size_t ThreadPool::threads(void) const {
+	return threads_;
+}
+
+size_t ThreadPool::idle(void) const {
+	return idle_;
+}
+
+size_t ThreadPool::pending(void) const {
+	return pending_;
+}
+
+}	// namespace
+
+// EOB
@@ -0,0 +1,115 @@
+/*
+	futex.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/futex.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace oo {
+
+#ifdef __linux__
+
+void futex_wait(std::atomic<uint32_t> *addr, uint32_t expected) {
+	// errors (EAGAIN, EINTR) are like spurious wakeups
+	::syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+bool futex_wait_for(std::atomic<uint32_t> *addr, uint32_t expected, std::chrono::nanoseconds timeout) {
+	if (timeout.count() <= 0) {
+		return false;
+	}
+	struct timespec ts;
+	ts.tv_sec = timeout.count() / 1000000000LL;
+	ts.tv_nsec = timeout.count() % 1000000000LL;
+
+	if (::syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0) == -1 && errno == ETIMEDOUT) {
+		return false;
+	}
+	return true;
+}
+
+void futex_wake(std::atomic<uint32_t> *addr, int n) {
+	::syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+}
+
+#else
+
+// addresses are hashed onto a fixed set of condition variables
+// waking up wakes the whole bucket; the extra wakeups are spurious
+
+struct FutexBucket {
+	std::mutex mx;
+	std::condition_variable cond;
+};
+
+static const size_t kFutexBuckets = 64;
+
+static FutexBucket futex_buckets[kFutexBuckets];
+
+static FutexBucket& futex_bucket(std::atomic<uint32_t> *addr) {
+	return futex_buckets[((uintptr_t)addr >> 4) % kFutexBuckets];
+}
+
+void futex_wait(std::atomic<uint32_t> *addr, uint32_t expected) {
+	FutexBucket& b = futex_bucket(addr);
+	std::unique_lock<std::mutex> lk(b.mx);
+	if (addr->load() == expected) {
+		b.cond.wait(lk);
+	}
+}
+
+bool futex_wait_for(std::atomic<uint32_t> *addr, uint32_t expected, std::chrono::nanoseconds timeout) {
+	FutexBucket& b = futex_bucket(addr);
+	std::unique_lock<std::mutex> lk(b.mx);
+	if (addr->load() == expected) {
+		return b.cond.wait_for(lk, timeout) == std::cv_status::no_timeout;
+	}
+	return true;
+}
+
+void futex_wake(std::atomic<uint32_t> *addr, int n) {
+	FutexBucket& b = futex_bucket(addr);
+	std::lock_guard<std::mutex> lk(b.mx);
+	b.cond.notify_all();
+}
+
+#endif	// __linux__
+
+}	// namespace
+
+// EOB
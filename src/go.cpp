@@ -30,9 +30,9 @@
 #include "oo/go.h"
 #include "oo/Error.h"
 #include "oo/Mutex.h"
+#include "oo/ThreadPool.h"
 
 #include <cstdlib>
-#include <map>
 #include <cerrno>
 #include <vector>
 #include <thread>
@@ -40,25 +40,26 @@
 #include <atomic>
 
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 namespace oo {
 
 /*
-	tid_mgr maps thread ids to simple integers
+	every thread has a simple integer "tid", kept in a thread_local
 	so std::thread::id's like 0x1290a8ff become thread #3
 	get the current thread "tid" via gettid()
+	The main thread is #0; threads that were not started by go() are -1
 
 	Mind that this is OK until you fork() ... which copies eternal_tid
 	and you get duplicate tids in the system
 	You may use jump_tid() to prevent tid clashes
 */
-static std::vector<std::thread> thread_mgr;
-static std::mutex thread_mgr_lock;
+static std::atomic<ThreadPool *> go_pool_ptr(nullptr);
+static std::mutex go_pool_lock;
 static std::atomic<unsigned int> eternal_tid;
-static std::map<std::thread::id, unsigned int> tid_mgr;
-static std::mutex tid_mgr_lock;
+static thread_local unsigned int current_tid = (unsigned int)-1;
 
 static bool initialize(void);
 
@@ -66,73 +67,74 @@ static bool initialized = initialize();
 
 static bool initialize(void) {
 	// called from main thread
-	tid_mgr[std::this_thread::get_id()] = 0;
+	current_tid = 0;
 	eternal_tid = 1;
 	return true;
 }
 
 static void assign_tid(void) {
-	std::lock_guard<std::mutex> guard(tid_mgr_lock);
-	tid_mgr[std::this_thread::get_id()] = eternal_tid++;
+	current_tid = eternal_tid++;
 }
 
-// run a bound function in a thread
-// launched by go_trampoline()
-// This takes a copy of func (on purpose; it prevents crashes)
-static void go_thread_main(std::function<void()> func, std::atomic<int> *start) {
-	assign_tid();
-
-	(*start)++;
-
-	func();
+// after fork() the pool's threads are gone; the child starts a new pool
+// The old one is deliberately leaked; its locks may be held by threads
+// that do not exist here
+static void go_atfork_child(void) {
+	go_pool_ptr = nullptr;
 }
 
-// launch function as thread
-// invoked by go(func, arg1, arg2, ...)
-void go_trampoline__(const std::function<void()>& func) {
-	std::lock_guard<std::mutex> guard(thread_mgr_lock);
+/*
+	go() runs on an elastic thread pool without limit, so a goroutine
+	that blocks never keeps the others from running. The pool is
+	never destroyed; idle workers simply go away at exit
+*/
+ThreadPool& go_pool(void) {
+	ThreadPool *pool = go_pool_ptr.load(std::memory_order_acquire);
+	if (pool != nullptr) {
+		return *pool;
+	}
 
-	std::atomic<int> start;
-	start = 0;
+	std::lock_guard<std::mutex> guard(go_pool_lock);
 
-	try {
-		// keep the thread as variable in the thread_mgr array
-		thread_mgr.push_back(std::thread(go_thread_main, func, &start));
-	} catch(std::system_error) {
-		throw OSError("failed to start thread");
+	pool = go_pool_ptr.load(std::memory_order_relaxed);
+	if (pool == nullptr) {
+		static bool atfork_installed = false;
+		if (!atfork_installed) {
+			::pthread_atfork(nullptr, nullptr, go_atfork_child);
+			atfork_installed = true;
+		}
+		pool = new ThreadPool(0, kThreadPoolUnlimited);
+		go_pool_ptr.store(pool, std::memory_order_release);
 	}
+	return *pool;
+}
 
-	// spinlock ... eek
-	// how to improve this, without destroying locks before the thread ever
-	// got to them, etc. ?
-	while(start == 0);
+// launch function on the pool
+// invoked by go(func, arg1, arg2, ...)
+void go_trampoline__(const std::function<void()>& func) {
+	// every goroutine gets its own tid, even when it reuses a thread
+	// It may run inside another task (that waits), whose tid we give back
+	go_pool().submit([func]() {
+		unsigned int prev = swap_tid__(eternal_tid++);
+		func();
+		swap_tid__(prev);
+	});
 }
 
-// join all threads, and cleanup the thread manager
+// wait for all goroutines
 void join(void) {
-	std::lock_guard<std::mutex> guard_thrd(thread_mgr_lock);
-
-	for(auto& t : thread_mgr) {
-		t.join();
-	}
-
-	thread_mgr.clear();
-
-	std::lock_guard<std::mutex> guard_tid(tid_mgr_lock);
-	tid_mgr.clear();
+	go_pool().wait();
 }
 
 // get current thread id
 unsigned int gettid(void) {
-	unsigned int tid = (unsigned int)-1;
-
-	std::lock_guard<std::mutex> guard(tid_mgr_lock);
+	return current_tid;
+}
 
-	std::thread::id my_id = std::this_thread::get_id();
-	if (tid_mgr.find(my_id) != tid_mgr.end()) {
-		tid = tid_mgr[my_id];
-	}
-	return tid;
+unsigned int swap_tid__(unsigned int tid) {
+	unsigned int prev = current_tid;
+	current_tid = tid;
+	return prev;
 }
 
 void child_trampoline__(const std::function<void()>& func) {
@@ -0,0 +1,134 @@
+/*
+	hash.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/hash.h"
+
+#include <cstring>
+
+namespace oo {
+
+static const uint64_t kHashSecret0 = 0xa0761d6478bd642fULL;
+static const uint64_t kHashSecret1 = 0xe7037ed1a0b428dbULL;
+static const uint64_t kHashSecret2 = 0x8ebc6af09c88c6e3ULL;
+static const uint64_t kHashSecret3 = 0x589965cc75374cc3ULL;
+
+// multiply 64x64 -> 128 bits; return low and high halves in a and b
+static inline void hash_mul(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+	hash_mul(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+	uint64_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t read32(const uint8_t *p) {
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// 1 to 3 bytes
+static inline uint64_t read_small(const uint8_t *p, size_t n) {
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[n >> 1] << 8) | p[n - 1];
+}
+
+uint64_t hash_bytes(const void *data, size_t n, uint64_t seed) {
+	const uint8_t *p = (const uint8_t *)data;
+	uint64_t a, b;
+
+	seed ^= hash_mix(seed ^ kHashSecret0, kHashSecret1);
+
+	if (n <= 16) {
+		if (n >= 4) {
+			// two overlapping reads cover 4 to 16 bytes
+			size_t k = (n >> 3) << 2;
+			a = (read32(p) << 32) | read32(p + k);
+			b = (read32(p + n - 4) << 32) | read32(p + n - 4 - k);
+		} else if (n > 0) {
+			a = read_small(p, n);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = n;
+		if (i > 48) {
+			// three independent lanes
+			uint64_t seed1 = seed, seed2 = seed;
+			do {
+				seed = hash_mix(read64(p) ^ kHashSecret1, read64(p + 8) ^ seed);
+				seed1 = hash_mix(read64(p + 16) ^ kHashSecret2, read64(p + 24) ^ seed1);
+				seed2 = hash_mix(read64(p + 32) ^ kHashSecret3, read64(p + 40) ^ seed2);
+				p += 48;
+				i -= 48;
+			} while(i > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while(i > 16) {
+			seed = hash_mix(read64(p) ^ kHashSecret1, read64(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		// the last 16 bytes; may overlap with what was already done
+		a = read64(p + i - 16);
+		b = read64(p + i - 8);
+	}
+
+	a ^= kHashSecret1;
+	b ^= seed;
+	hash_mul(&a, &b);
+	uint64_t h = hash_mix(a ^ kHashSecret0 ^ n, b ^ kHashSecret1);
+
+	// zero is reserved, see String::hash()
+	return h ? h : 1;
+}
+
+}	// namespace
+
+// EOB
@@ -0,0 +1,229 @@
+/*
+	lockstat.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/lockstat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace oo {
+
+std::atomic<bool> lockstat_enabled_(false);
+
+/*
+	the list of all LockStats
+	Locks may be static objects, so this is created on first use,
+	and never destroyed
+*/
+class LockStatList {
+public:
+	static LockStatList& get(void) {
+		static LockStatList *list = new LockStatList();
+		return *list;
+	}
+
+	void add(LockStat *st) {
+		std::lock_guard<std::mutex> lk(mx_);
+		st->prev_ = nullptr;
+		st->next_ = head_;
+		if (head_ != nullptr) {
+			head_->prev_ = st;
+		}
+		head_ = st;
+	}
+
+	void remove(LockStat *st) {
+		std::lock_guard<std::mutex> lk(mx_);
+		if (st->prev_ != nullptr) {
+			st->prev_->next_ = st->next_;
+		} else {
+			head_ = st->next_;
+		}
+		if (st->next_ != nullptr) {
+			st->next_->prev_ = st->prev_;
+		}
+	}
+
+	// a copy of the counters, so we do not hold the lock while formatting
+	struct Record {
+		std::string name;
+		uint64_t acquired, contended, wait_ns, max_wait_ns, max_hold_ns;
+	};
+
+	std::vector<Record> records(void) {
+		std::vector<Record> v;
+		{
+			std::lock_guard<std::mutex> lk(mx_);
+			for(LockStat *st = head_; st != nullptr; st = st->next_) {
+				v.push_back(Record{st->name(), st->acquired(), st->contended(), st->wait_ns(),
+					st->max_wait_ns(), st->max_hold_ns()});
+			}
+		}
+		std::stable_sort(v.begin(), v.end(), [](const Record& a, const Record& b) {
+			return a.wait_ns > b.wait_ns;
+		});
+		return v;
+	}
+
+	void reset(void) {
+		std::lock_guard<std::mutex> lk(mx_);
+		for(LockStat *st = head_; st != nullptr; st = st->next_) {
+			st->reset();
+		}
+	}
+
+private:
+	LockStatList() : mx_(), head_(nullptr) { }
+
+	std::mutex mx_;
+	LockStat *head_;
+};
+
+static void store_max(std::atomic<uint64_t>& a, uint64_t v) {
+	uint64_t old = a.load(std::memory_order_relaxed);
+	while(v > old && !a.compare_exchange_weak(old, v, std::memory_order_relaxed)) {
+	}
+}
+
+LockStat::LockStat(const char *name) : name_((name != nullptr) ? name : "(null)"),
+	acquired_(0), contended_(0), wait_ns_(0), max_wait_ns_(0), max_hold_ns_(0), hold_start_(0),
+	prev_(nullptr), next_(nullptr) {
+	LockStatList::get().add(this);
+}
+
+LockStat::~LockStat() {
+	LockStatList::get().remove(this);
+}
+
+uint64_t LockStat::now_ns(void) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LockStat::record(bool contended, uint64_t wait_ns) {
+	acquired_.fetch_add(1, std::memory_order_relaxed);
+	if (contended) {
+		contended_.fetch_add(1, std::memory_order_relaxed);
+		wait_ns_.fetch_add(wait_ns, std::memory_order_relaxed);
+		store_max(max_wait_ns_, wait_ns);
+	}
+}
+
+void LockStat::hold_end_(void) {
+	// hold_start_ is zero if profiling was switched on while the lock was held
+	uint64_t t0 = hold_start_.exchange(0, std::memory_order_relaxed);
+	if (t0 != 0) {
+		store_max(max_hold_ns_, now_ns() - t0);
+	}
+}
+
+void LockStat::reset(void) {
+	acquired_.store(0, std::memory_order_relaxed);
+	contended_.store(0, std::memory_order_relaxed);
+	wait_ns_.store(0, std::memory_order_relaxed);
+	max_wait_ns_.store(0, std::memory_order_relaxed);
+	max_hold_ns_.store(0, std::memory_order_relaxed);
+}
+
+void lockstat_enable(bool on) {
+	lockstat_enabled_.store(on, std::memory_order_relaxed);
+}
+
+void lockstat_reset(void) {
+	LockStatList::get().reset();
+}
+
+std::string lockstat_report(void) {
+	std::vector<LockStatList::Record> v = LockStatList::get().records();
+
+	std::string s;
+	char line[256];
+
+	std::snprintf(line, sizeof(line), "%-32s %12s %12s %8s %12s %12s %12s\n",
+		"name", "acquired", "contended", "%", "wait us", "max wait us", "max hold us");
+	s += line;
+
+	for(const LockStatList::Record& r : v) {
+		double pct = (r.acquired > 0) ? 100.0 * r.contended / r.acquired : 0.0;
+		std::snprintf(line, sizeof(line), "%-32s %12llu %12llu %8.2f %12.1f %12.1f %12.1f\n",
+			r.name.c_str(), (unsigned long long)r.acquired, (unsigned long long)r.contended, pct,
+			r.wait_ns / 1000.0, r.max_wait_ns / 1000.0, r.max_hold_ns / 1000.0);
+		s += line;
+	}
+	return s;
+}
+
+static std::string json_quote(const std::string& str) {
+	std::string s("\"");
+	for(char c : str) {
+		if (c == '"' || c == '\\') {
+			s += '\\';
+			s += c;
+		} else if ((unsigned char)c < 0x20) {
+			char esc[8];
+			std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+			s += esc;
+		} else {
+			s += c;
+		}
+	}
+	s += '"';
+	return s;
+}
+
+std::string lockstat_json(void) {
+	std::vector<LockStatList::Record> v = LockStatList::get().records();
+
+	std::string s("[");
+	char buf[256];
+
+	for(size_t i = 0; i < v.size(); i++) {
+		const LockStatList::Record& r = v[i];
+
+		if (i > 0) {
+			s += ',';
+		}
+		s += "\n\t{\"name\": ";
+		s += json_quote(r.name);
+		std::snprintf(buf, sizeof(buf), ", \"acquired\": %llu, \"contended\": %llu, \"wait_ns\": %llu, "
+			"\"max_wait_ns\": %llu, \"max_hold_ns\": %llu}",
+			(unsigned long long)r.acquired, (unsigned long long)r.contended, (unsigned long long)r.wait_ns,
+			(unsigned long long)r.max_wait_ns, (unsigned long long)r.max_hold_ns);
+		s += buf;
+	}
+	s += "\n]\n";
+	return s;
+}
+
+}	// namespace
+
+// EOB
@@ -0,0 +1,319 @@
+/*
+	memsearch.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/memsearch.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OO_MEMSEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace oo {
+
+typedef const char *(*FindFunc)(const char *, size_t, const char *, size_t);
+typedef const char *(*FindByteFunc)(const char *, size_t, char);
+
+
+// portable versions; also used for the tail ends of the SIMD loops
+
+static const char *memfind_scalar(const char *s, size_t n, const char *needle, size_t m) {
+	if (m > n) {
+		return nullptr;
+	}
+
+	const char *last = s + n - m;
+	const char *p = s;
+	while(p <= last) {
+		p = (const char *)std::memchr(p, *needle, last - p + 1);
+		if (p == nullptr) {
+			return nullptr;
+		}
+		if (!std::memcmp(p + 1, needle + 1, m - 1)) {
+			return p;
+		}
+		p++;
+	}
+	return nullptr;
+}
+
+static const char *memrfind_scalar(const char *s, size_t n, const char *needle, size_t m) {
+	if (m > n) {
+		return nullptr;
+	}
+
+	size_t i = n - m + 1;
+	while(i > 0) {
+		i--;
+		if (s[i] == *needle && !std::memcmp(s + i + 1, needle + 1, m - 1)) {
+			return s + i;
+		}
+	}
+	return nullptr;
+}
+
+static const char *memrfind_byte_scalar(const char *s, size_t n, char c) {
+	while(n > 0) {
+		n--;
+		if (s[n] == c) {
+			return s + n;
+		}
+	}
+	return nullptr;
+}
+
+#ifdef OO_MEMSEARCH_X86
+
+/*
+	for a block of starting positions, test the first and last byte
+	of the needle in one go; a set bit in the mask is a candidate match
+*/
+
+static const char *memfind_sse2(const char *s, size_t n, const char *needle, size_t m) {
+	if (m > n) {
+		return nullptr;
+	}
+
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[m - 1]);
+
+	// number of possible starting positions
+	const size_t k = n - m + 1;
+
+	size_t i = 0;
+	for(; i + 16 <= k; i += 16) {
+		__m128i block_first = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i block_last = _mm_loadu_si128((const __m128i *)(s + i + m - 1));
+
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+			_mm_cmpeq_epi8(block_last, last)));
+
+		while(mask != 0) {
+			unsigned int bit = __builtin_ctz(mask);
+			if (!std::memcmp(s + i + bit + 1, needle + 1, m - 2)) {
+				return s + i + bit;
+			}
+			mask &= mask - 1;
+		}
+	}
+	return memfind_scalar(s + i, n - i, needle, m);
+}
+
+static const char *memrfind_sse2(const char *s, size_t n, const char *needle, size_t m) {
+	if (m > n) {
+		return nullptr;
+	}
+
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[m - 1]);
+
+	size_t k = n - m + 1;
+
+	while(k >= 16) {
+		size_t i = k - 16;
+
+		__m128i block_first = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i block_last = _mm_loadu_si128((const __m128i *)(s + i + m - 1));
+
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+			_mm_cmpeq_epi8(block_last, last)));
+
+		while(mask != 0) {
+			unsigned int bit = 31 - __builtin_clz(mask);
+			if (!std::memcmp(s + i + bit + 1, needle + 1, m - 2)) {
+				return s + i + bit;
+			}
+			mask &= ~(1U << bit);
+		}
+		k = i;
+	}
+	return memrfind_scalar(s, k + m - 1, needle, m);
+}
+
+static const char *memrfind_byte_sse2(const char *s, size_t n, char c) {
+	const __m128i needle = _mm_set1_epi8(c);
+
+	while(n >= 16) {
+		n -= 16;
+
+		__m128i block = _mm_loadu_si128((const __m128i *)(s + n));
+		unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+		if (mask != 0) {
+			return s + n + 31 - __builtin_clz(mask);
+		}
+	}
+	return memrfind_byte_scalar(s, n, c);
+}
+
+__attribute__((target("avx2")))
+static const char *memfind_avx2(const char *s, size_t n, const char *needle, size_t m) {
+	if (m > n) {
+		return nullptr;
+	}
+
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+
+	const size_t k = n - m + 1;
+
+	size_t i = 0;
+	for(; i + 32 <= k; i += 32) {
+		__m256i block_first = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i block_last = _mm256_loadu_si256((const __m256i *)(s + i + m - 1));
+
+		unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+			_mm256_cmpeq_epi8(block_last, last)));
+
+		while(mask != 0) {
+			unsigned int bit = __builtin_ctz(mask);
+			if (!std::memcmp(s + i + bit + 1, needle + 1, m - 2)) {
+				return s + i + bit;
+			}
+			mask &= mask - 1;
+		}
+	}
+	return memfind_sse2(s + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static const char *memrfind_avx2(const char *s, size_t n, const char *needle, size_t m) {
+	if (m > n) {
+		return nullptr;
+	}
+
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+
+	size_t k = n - m + 1;
+
+	while(k >= 32) {
+		size_t i = k - 32;
+
+		__m256i block_first = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i block_last = _mm256_loadu_si256((const __m256i *)(s + i + m - 1));
+
+		unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+			_mm256_cmpeq_epi8(block_last, last)));
+
+		while(mask != 0) {
+			unsigned int bit = 31 - __builtin_clz(mask);
+			if (!std::memcmp(s + i + bit + 1, needle + 1, m - 2)) {
+				return s + i + bit;
+			}
+			mask &= ~(1U << bit);
+		}
+		k = i;
+	}
+	return memrfind_sse2(s, k + m - 1, needle, m);
+}
+
+__attribute__((target("avx2")))
+static const char *memrfind_byte_avx2(const char *s, size_t n, char c) {
+	const __m256i needle = _mm256_set1_epi8(c);
+
+	while(n >= 32) {
+		n -= 32;
+
+		__m256i block = _mm256_loadu_si256((const __m256i *)(s + n));
+		unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+		if (mask != 0) {
+			return s + n + 31 - __builtin_clz(mask);
+		}
+	}
+	return memrfind_byte_sse2(s, n, c);
+}
+
+#endif	// OO_MEMSEARCH_X86
+
+// the implementation to use is chosen once, on first use
+
+struct SearchImpl {
+	FindFunc find, rfind;
+	FindByteFunc rfind_byte;
+
+	SearchImpl() {
+#ifdef OO_MEMSEARCH_X86
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2")) {
+			find = memfind_avx2;
+			rfind = memrfind_avx2;
+			rfind_byte = memrfind_byte_avx2;
+		} else {
+			find = memfind_sse2;
+			rfind = memrfind_sse2;
+			rfind_byte = memrfind_byte_sse2;
+		}
+#else
+		find = memfind_scalar;
+		rfind = memrfind_scalar;
+		rfind_byte = memrfind_byte_scalar;
+#endif
+	}
+};
+
+static const SearchImpl& search_impl(void) {
+	static const SearchImpl impl;
+	return impl;
+}
+
+
+const char *memfind(const char *haystack, size_t n, const char *needle, size_t m) {
+	if (!m) {
+		return haystack;
+	}
+	if (m == 1) {
+		return memfind_byte(haystack, n, *needle);
+	}
+	return search_impl().find(haystack, n, needle, m);
+}
+
+const char *memrfind(const char *haystack, size_t n, const char *needle, size_t m) {
+	if (!m) {
+		return haystack + n;
+	}
+	if (m == 1) {
+		return memrfind_byte(haystack, n, *needle);
+	}
+	return search_impl().rfind(haystack, n, needle, m);
+}
+
+const char *memfind_byte(const char *s, size_t n, char c) {
+	// the C library's memchr() is already vectorized
+	return (const char *)std::memchr(s, c, n);
+}
+
+const char *memrfind_byte(const char *s, size_t n, char c) {
+	return search_impl().rfind_byte(s, n, c);
+}
+
+}	// namespace
+
+// EOB
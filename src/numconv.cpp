@@ -0,0 +1,427 @@
+/*
+	numconv.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oo/numconv.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <locale.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+namespace oo {
+
+// powers of ten that are exactly representable as a double
+static const double kExactPowersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+	1e21, 1e22
+};
+
+static const char kDigitPairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// the "C" locale; for the few cases where we fall back to the C library
+static locale_t c_locale(void) {
+	static locale_t loc = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+	return loc;
+}
+
+static inline bool is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// trim whitespace off both ends
+static void trim(const char *& p, const char *& end) {
+	while(p < end && is_space(*p)) {
+		p++;
+	}
+	while(end > p && is_space(end[-1])) {
+		end--;
+	}
+}
+
+// parse digits; returns false on overflow or if there are no digits
+static bool parse_digits(const char *p, const char *end, uint64_t& v) {
+	if (p >= end) {
+		return false;
+	}
+
+	v = 0;
+	while(p < end) {
+		if (!is_digit(*p)) {
+			return false;
+		}
+		unsigned int digit = *p - '0';
+		if (v > (UINT64_MAX - digit) / 10) {
+			return false;
+		}
+		v = v * 10 + digit;
+		p++;
+	}
+	return true;
+}
+
+bool parse_int(const StringView& s, int64_t& v) {
+	const char *p = s.data();
+	const char *end = p + s.len();
+	trim(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	uint64_t u;
+	if (!parse_digits(p, end, u)) {
+		return false;
+	}
+	if (negative) {
+		if (u > (uint64_t)INT64_MAX + 1) {
+			return false;
+		}
+		v = (int64_t)(0 - u);
+	} else {
+		if (u > (uint64_t)INT64_MAX) {
+			return false;
+		}
+		v = (int64_t)u;
+	}
+	return true;
+}
+
+bool parse_uint(const StringView& s, uint64_t& v) {
+	const char *p = s.data();
+	const char *end = p + s.len();
+	trim(p, end);
+
+	if (p < end && *p == '+') {
+		p++;
+	}
+	return parse_digits(p, end, v);
+}
+
+bool parse_double(const StringView& s, double& v) {
+	const char *p = s.data();
+	const char *end = p + s.len();
+	trim(p, end);
+
+	const char *start = p;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	// collect up to 19 significant digits; that fits in a uint64_t
+	uint64_t mantissa = 0;
+	int num_digits = 0;
+	int exp10 = 0;
+	bool any_digits = false;
+	bool truncated = false;
+
+	while(p < end && is_digit(*p)) {
+		any_digits = true;
+		if (num_digits < 19) {
+			if (mantissa || *p != '0') {
+				mantissa = mantissa * 10 + (*p - '0');
+				num_digits++;
+			}
+		} else {
+			exp10++;
+			truncated = true;
+		}
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while(p < end && is_digit(*p)) {
+			any_digits = true;
+			if (num_digits < 19) {
+				if (mantissa || *p != '0') {
+					mantissa = mantissa * 10 + (*p - '0');
+					num_digits++;
+				}
+				exp10--;
+			} else {
+				truncated = true;
+			}
+			p++;
+		}
+	}
+	if (!any_digits) {
+		return false;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool exp_negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			exp_negative = (*p == '-');
+			p++;
+		}
+		if (p >= end || !is_digit(*p)) {
+			return false;
+		}
+		int e = 0;
+		while(p < end && is_digit(*p)) {
+			if (e < 100000) {
+				e = e * 10 + (*p - '0');
+			}
+			p++;
+		}
+		exp10 += exp_negative ? -e : e;
+	}
+	if (p != end) {
+		return false;
+	}
+
+	// fast path: both the mantissa and the power of ten are exact
+	// doubles, so a single multiply or divide is correctly rounded
+	if (!truncated && mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+		double d = (double)mantissa;
+		if (exp10 < 0) {
+			d /= kExactPowersOfTen[-exp10];
+		} else {
+			d *= kExactPowersOfTen[exp10];
+		}
+		v = negative ? -d : d;
+		return true;
+	}
+	if (!mantissa && !truncated) {
+		v = negative ? -0.0 : 0.0;
+		return true;
+	}
+
+	// slow path: let the C library do the rounding
+	// the syntax has been checked, so it will parse the whole thing
+	std::string tmp(start, end - start);
+	double d = strtod_l(tmp.c_str(), nullptr, c_locale());
+	if (std::isinf(d)) {
+		return false;
+	}
+	v = d;
+	return true;
+}
+
+size_t format_uint(uint64_t v, char *buf) {
+	char tmp[kFormatNumberSize];
+	char *p = tmp + sizeof(tmp);
+
+	while(v >= 100) {
+		unsigned int i = (v % 100) * 2;
+		v /= 100;
+		*--p = kDigitPairs[i + 1];
+		*--p = kDigitPairs[i];
+	}
+	if (v >= 10) {
+		unsigned int i = v * 2;
+		*--p = kDigitPairs[i + 1];
+		*--p = kDigitPairs[i];
+	} else {
+		*--p = '0' + v;
+	}
+
+	size_t n = tmp + sizeof(tmp) - p;
+	std::memcpy(buf, p, n);
+	buf[n] = 0;
+	return n;
+}
+
+size_t format_int(int64_t v, char *buf) {
+	if (v < 0) {
+		*buf = '-';
+		return format_uint(0 - (uint64_t)v, buf + 1) + 1;
+	}
+	return format_uint(v, buf);
+}
+
+size_t format_double(double v, char *buf) {
+	if (std::isnan(v)) {
+		std::strcpy(buf, "nan");
+		return 3;
+	}
+	if (std::isinf(v)) {
+		std::strcpy(buf, (v < 0) ? "-inf" : "inf");
+		return (v < 0) ? 4 : 3;
+	}
+
+	// integral values are quick
+	if (v == std::floor(v) && std::fabs(v) < 1e15) {
+		if (v == 0 && std::signbit(v)) {
+			std::strcpy(buf, "-0");
+			return 2;
+		}
+		return format_int((int64_t)v, buf);
+	}
+
+	// try fixed notation with as few decimals as possible
+	// m / 10^k is correctly rounded (like parse_double() does), so if
+	// that gives back v, then the string reads back as v, too
+	double a = std::fabs(v);
+	if (a >= 1e-4 && a < 1e15) {
+		for(int k = 1; k <= 17; k++) {
+			double scaled = a * kExactPowersOfTen[k];
+			if (scaled >= 9007199254740992.0) {	// 2^53
+				break;
+			}
+			uint64_t m = (uint64_t)(scaled + 0.5);
+			if ((double)m / kExactPowersOfTen[k] != a) {
+				continue;
+			}
+
+			char digits[kFormatNumberSize];
+			size_t num_digits = format_uint(m, digits);
+
+			char *p = buf;
+			if (v < 0) {
+				*p++ = '-';
+			}
+			if (num_digits <= (size_t)k) {
+				*p++ = '0';
+				*p++ = '.';
+				for(size_t i = num_digits; i < (size_t)k; i++) {
+					*p++ = '0';
+				}
+				std::memcpy(p, digits, num_digits);
+				p += num_digits;
+			} else {
+				std::memcpy(p, digits, num_digits - k);
+				p += num_digits - k;
+				*p++ = '.';
+				std::memcpy(p, digits + num_digits - k, k);
+				p += k;
+			}
+			*p = 0;
+			return p - buf;
+		}
+	}
+
+	// use as few digits as possible, while still reading back as v
+	// Up to 15 digits always survive the round trip, and %g drops the
+	// trailing zeros; but subnormals have fewer bits, and may need less
+	locale_t old_locale = uselocale(c_locale());
+
+	int n = 0;
+	for(int precision = (a < DBL_MIN) ? 1 : 15; precision <= 17; precision++) {
+		n = std::snprintf(buf, kFormatNumberSize, "%.*g", precision, v);
+		if (strtod_l(buf, nullptr, c_locale()) == v) {
+			break;
+		}
+	}
+
+	uselocale(old_locale);
+	return n;
+}
+
+size_t format_fixed(double v, int precision, char *buf, size_t bufsize) {
+	// fast path for not too large numbers and precisions
+	// rounding is to nearest, ties to even, on the exact value like printf() does
+	double a = std::fabs(v);
+	if (precision >= 0 && precision <= 22 && a < 1e12 && bufsize >= kFormatNumberSize) {
+		double scale = kExactPowersOfTen[precision];
+		double scaled = a * scale;
+
+		if (scaled < 1099511627776.0) {		// 2^40
+			// scaled + err is the exact product
+			double err = std::fma(a, scale, -scaled);
+			double fl = std::floor(scaled);
+			double frac = scaled - fl;
+
+			uint64_t m = (uint64_t)fl;
+			if (frac > 0.5 || (frac == 0.5 && (err > 0 || (err == 0 && (m & 1))))) {
+				m++;
+			}
+
+			char digits[kFormatNumberSize];
+			size_t num_digits = format_uint(m, digits);
+
+			char *p = buf;
+			if (std::signbit(v)) {
+				*p++ = '-';
+			}
+			if (!precision) {
+				std::memcpy(p, digits, num_digits);
+				p += num_digits;
+			} else if (num_digits <= (size_t)precision) {
+				*p++ = '0';
+				*p++ = '.';
+				for(size_t i = num_digits; i < (size_t)precision; i++) {
+					*p++ = '0';
+				}
+				std::memcpy(p, digits, num_digits);
+				p += num_digits;
+			} else {
+				std::memcpy(p, digits, num_digits - precision);
+				p += num_digits - precision;
+				*p++ = '.';
+				std::memcpy(p, digits + num_digits - precision, precision);
+				p += precision;
+			}
+			*p = 0;
+			return p - buf;
+		}
+	}
+
+	locale_t old_locale = uselocale(c_locale());
+	int n = std::snprintf(buf, bufsize, "%.*f", precision, v);
+	uselocale(old_locale);
+
+	if (n < 0) {
+		// should not happen
+		*buf = 0;
+		return 0;
+	}
+	return n;
+}
+
+}	// namespace
+
+// EOB
@@ -32,301 +32,526 @@
 #include "oo/Error.h"
 #include "oo/String.h"
 #include "oo/Mutex.h"
+#include "oo/numconv.h"
 
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 namespace oo {
 
 // the printer lock ensures screen output of multiple threads doesn't get messed up
-static Mutex printer_lock;
+static Mutex printer_lock("printer_lock");
 
 
-void vssprint(std::stringstream& s, const char *fmt, std::va_list ap) {
-	if (fmt == nullptr) {
-		throw ReferenceError();
-	}
-	if (!*fmt) {
-		return;
-	}
+/*
+	a format string is parsed once into a list of FormatItems:
+	literal text followed by a conversion
+*/
+
+struct FormatItem {
+	size_t lit_offset, lit_len;		// literal text before the conversion
+	char conv;						// conversion character; 0 means: just text
+	bool left, zero, width_arg, has_precision, precision_arg, long_arg, size_arg;
+	int width, precision;
+};
+
+struct CompiledFormat {
+	const char *key;
+	std::string fmt;
+	std::vector<FormatItem> items;
+
+	CompiledFormat() : key(nullptr), fmt(), items() { }
+};
+
+static const size_t kFormatCacheSize = 64;
+static const size_t kFormatBufferKeep = 64 * 1024;
+
+// per-thread format cache and output buffer
+static thread_local CompiledFormat format_cache[kFormatCacheSize];
+static thread_local std::string format_buf;
+static thread_local bool format_buf_taken = false;
+static thread_local int format_depth = 0;		// nesting of vformat_append()
+
+
+static void compile_format(const char *fmt, CompiledFormat& cf) {
+	cf.key = fmt;
+	cf.fmt = fmt;
+	cf.items.clear();
+
+	const char *start = fmt;
+	const char *lit = fmt;
 
-	int width;
-	bool long_argument, size_argument;
-	
 	while(*fmt) {
-		if (*fmt == '%') {
-			// parse the format string
+		if (*fmt != '%') {
 			fmt++;
-			
-			width = 0;
-			long_argument = false;
-			size_argument = false;
-			
-			// by default, right justified
-			s << std::setiosflags(std::ios::right) << std::resetiosflags(std::ios::left)
-				<< std::setfill(' ')
-				<< std::dec
-				<< std::setiosflags(std::ios::fixed) << std::setprecision(6);
-
-			// justify left
-			if (*fmt == '-') {
-				fmt++;
-				s << std::setiosflags(std::ios::left) << std::resetiosflags(std::ios::right);
-			}
-			// leading zero's
-			while(*fmt == '0') {
-				fmt++;
-				s << std::setfill('0');
-			}
-			
-			// width specifier
-			while(*fmt >= '0' && *fmt <= '9') {
-				width *= 10;
-				width += (*fmt - '0');
+			continue;
+		}
+
+		FormatItem item;
+		item.lit_offset = lit - start;
+		item.lit_len = fmt - lit;
+		item.left = item.zero = item.width_arg = false;
+		item.has_precision = item.precision_arg = false;
+		item.long_arg = item.size_arg = false;
+		item.width = 0;
+		item.precision = 6;
+
+		// parse the format string
+		fmt++;
+
+		// justify left
+		if (*fmt == '-') {
+			fmt++;
+			item.left = true;
+		}
+		// leading zero's
+		while(*fmt == '0') {
+			fmt++;
+			item.zero = true;
+		}
+
+		// width specifier
+		while(*fmt >= '0' && *fmt <= '9') {
+			item.width *= 10;
+			item.width += (*fmt - '0');
+			fmt++;
+		}
+
+		if (*fmt == '*') {		// variable width
+			item.width_arg = true;
+			fmt++;
+		}
+
+		// floating point precision specifier
+		if (*fmt == '.') {
+			bool precision_ok = false;
+
+			fmt++;
+			if (*fmt == '*') {
+				item.precision_arg = true;
 				fmt++;
+				precision_ok = true;
+			} else {
+				item.precision = 0;
+				while(*fmt >= '0' && *fmt <= '9') {
+					item.precision *= 10;
+					item.precision += (*fmt - '0');
+					fmt++;
+					precision_ok = true;
+				}
 			}
 
-			if (*fmt == '*') {		// variable width
-				width = va_arg(ap, int);
-				if (width < 0) {
-					width = -width;
-					s << std::setiosflags(std::ios::left) << std::resetiosflags(std::ios::right);
-				}
-				fmt++;
+			// else error in format string
+			if (!precision_ok) {
+				throw ValueError("format string error (in precision field)");
 			}
+			item.has_precision = true;
+		}
 
-			// floating point precision specifier
-			if (*fmt == '.') {
-				int precision = 0;
-				bool precision_ok = false;
-				
-				fmt++;
-				if (*fmt == '*') {
-					precision = va_arg(ap, int);
-					if (precision < 0)
-						precision = -precision;
+		// 'long' argument
+		if (*fmt == 'l') {
+			fmt++;
+			item.long_arg = true;
+		}
 
-					fmt++;
-					precision_ok = true;
-				} else {
-					while(*fmt == '0') {    // skip leading zeroes
-						precision = 0;
-						fmt++;
-						precision_ok = true;
-					}
-					if (*fmt >= '1' && *fmt <= '9') {
-						precision = *fmt - '0';
-						fmt++;
-						precision_ok = true;
-					}
-					while(*fmt >= '0' && *fmt <= '9') {
-						precision *= 10;
-						precision += (*fmt - '0');
-						fmt++;
-						precision_ok = true;
-					}
+		// 'size_t' argument
+		if (*fmt == 'z') {
+			fmt++;
+			item.size_arg = true;
+		}
+
+		item.conv = *fmt;
+
+		switch(item.conv) {
+			case 'd':
+			case 'x':
+			case 'X':
+			case 'o':
+			case 'u':
+			case 'e':
+			case 'E':
+			case 'f':
+			case 'F':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+			case 'q':
+			case 'v':
+			case 'p':
+			case 't':
+			case 'U':
+			case 'r':
+			case '%':
+				break;
+
+			case 'C':
+			case 'c':
+				if (item.conv == 'C' || item.long_arg) {
+					throw ValueError("format string error (wchar_t is considered a broken type)");
 				}
+				break;
 
-				// else error in format string
-				if (!precision_ok) {
-					throw ValueError("format string error (in precision field)");
+			case 'S':
+			case 's':
+				if (item.conv == 'S' || item.long_arg) {
+					throw ValueError("format string error (wchar_t* is considered a broken type)");
 				}
-				
-				// set precision
-				s << std::setiosflags(std::ios::fixed) << std::setprecision(precision);
-			}
-			
-			// 'long' argument
-			if (*fmt == 'l') {
-				fmt++;
-				long_argument = true;
-			}
+				break;
 
-			// 'size_t' argument
-			if (*fmt == 'z') {
-				fmt++;
-				size_argument = true;
+			default:
+				throw ValueError("format string error (unsupported modifier)");
+		}
+
+		cf.items.push_back(item);
+
+		fmt++;
+		lit = fmt;
+	}
+
+	if (fmt > lit) {
+		// trailing text
+		FormatItem item;
+		item.lit_offset = lit - start;
+		item.lit_len = fmt - lit;
+		item.conv = 0;
+		cf.items.push_back(item);
+	}
+}
+
+// get compiled format from the cache
+// mind that fmt is usually a string literal, so its address is a good key,
+// but to be safe we also check that the string is still the same
+static const CompiledFormat& lookup_format(const char *fmt) {
+	size_t idx = ((uintptr_t)fmt >> 3) % kFormatCacheSize;
+	CompiledFormat& cf = format_cache[idx];
+
+	if (cf.key != fmt || std::strcmp(cf.fmt.c_str(), fmt) != 0) {
+		try {
+			compile_format(fmt, cf);
+		} catch(...) {
+			cf.key = nullptr;
+			throw;
+		}
+	}
+	return cf;
+}
+
+// append with padding to width
+static void append_padded(std::string& buf, const char *s, size_t n, int width, bool left, char fill) {
+	if (width <= 0 || (size_t)width <= n) {
+		buf.append(s, n);
+		return;
+	}
+
+	size_t pad = width - n;
+	if (left) {
+		buf.append(s, n);
+		buf.append(pad, fill);
+	} else {
+		buf.append(pad, fill);
+		buf.append(s, n);
+	}
+}
+
+// format unsigned value in base 8 or 16
+static size_t format_base(unsigned long v, unsigned int shift, bool upper, char *buf) {
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	const unsigned long mask = (1UL << shift) - 1;
+
+	char tmp[kFormatNumberSize];
+	char *p = tmp + sizeof(tmp);
+	do {
+		*--p = digits[v & mask];
+		v >>= shift;
+	} while(v);
+
+	size_t n = tmp + sizeof(tmp) - p;
+	std::memcpy(buf, p, n);
+	buf[n] = 0;
+	return n;
+}
+
+static void vformat_append(std::string& buf, const char *fmt, std::va_list ap) {
+	if (fmt == nullptr) {
+		throw ReferenceError();
+	}
+	if (!*fmt) {
+		return;
+	}
+
+	// a nested call (from within a repr(), say) does not use the cache;
+	// it might recompile the slot that the outer call is working from
+	CompiledFormat local;
+	if (format_depth > 0) {
+		compile_format(fmt, local);
+	}
+	const CompiledFormat& cf = (format_depth > 0) ? local : lookup_format(fmt);
+	const char *text = cf.fmt.c_str();
+
+	struct DepthGuard {
+		DepthGuard() { format_depth++; }
+		~DepthGuard() { format_depth--; }
+	} depth;
+
+	char num[kFormatNumberSize];
+	size_t n;
+
+	for(const FormatItem& item : cf.items) {
+		buf.append(text + item.lit_offset, item.lit_len);
+
+		if (!item.conv) {
+			break;
+		}
+
+		int width = item.width;
+		bool left = item.left;
+		char fill = item.zero ? '0' : ' ';
+
+		if (item.width_arg) {
+			width = va_arg(ap, int);
+			if (width < 0) {
+				width = -width;
+				left = true;
 			}
+		}
 
-			if (width > 0) {
-				s << std::setw(width);
+		int precision = item.precision;
+		if (item.precision_arg) {
+			precision = va_arg(ap, int);
+			if (precision < 0) {
+				precision = -precision;
 			}
+		}
 
-			// format specifier
-			switch(*fmt) {
-				// print integer value
-				case 'd':
-					if (long_argument) {
-						s << va_arg(ap, long);
-					} else {
-						if (size_argument) {
-							s << va_arg(ap, ssize_t);
-						} else {
-							s << va_arg(ap, int);
-						}
-					}
-					break;
-					
-				case 'x':
-					s << std::hex;
-					
-					if (long_argument) {
-						s << va_arg(ap, long);
+		switch(item.conv) {
+			// print integer value
+			case 'd':
+				if (item.long_arg) {
+					n = format_int(va_arg(ap, long), num);
+				} else {
+					if (item.size_arg) {
+						n = format_int(va_arg(ap, ssize_t), num);
 					} else {
-						if (size_argument) {
-							s << va_arg(ap, size_t);
-						} else {
-							s << va_arg(ap, int);
-						}
+						n = format_int(va_arg(ap, int), num);
 					}
-					break;
-					
-				case 'X':
-					s << std::uppercase << std::hex;
-					
-					if (long_argument) {
-						s << va_arg(ap, long);
+				}
+				append_padded(buf, num, n, width, left, fill);
+				break;
+
+			case 'x':
+			case 'X':
+			case 'o':
+				{
+					unsigned long v;
+					if (item.long_arg) {
+						v = (unsigned long)va_arg(ap, long);
 					} else {
-						if (size_argument) {
-							s << va_arg(ap, size_t);
+						if (item.size_arg) {
+							v = va_arg(ap, size_t);
 						} else {
-							s << va_arg(ap, int);
+							v = (unsigned int)va_arg(ap, int);
 						}
 					}
-					s << std::nouppercase;
-					break;
-					
-				case 'o':
-					s << std::oct;
-					
-					if (long_argument) {
-						s << va_arg(ap, long);
+					n = format_base(v, (item.conv == 'o') ? 3 : 4, item.conv == 'X', num);
+					append_padded(buf, num, n, width, left, fill);
+				}
+				break;
+
+			case 'u':
+				if (item.long_arg) {
+					n = format_uint(va_arg(ap, unsigned long), num);
+				} else {
+					if (item.size_arg) {
+						n = format_uint(va_arg(ap, size_t), num);
 					} else {
-						if (size_argument) {
-							s << va_arg(ap, size_t);
-						} else {
-							s << va_arg(ap, int);
-						}
+						n = format_uint(va_arg(ap, unsigned int), num);
 					}
-					break;
-					
-				case 'u':
-					if (long_argument) {
-						s << va_arg(ap, unsigned long);
+				}
+				append_padded(buf, num, n, width, left, fill);
+				break;
+
+			// print floating point values
+			case 'e':
+			case 'E':
+			case 'f':
+			case 'F':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				// note: this is nowhere near as versatile as printf()
+				// all of these print in fixed notation
+				{
+					double d = va_arg(ap, double);
+					n = format_fixed(d, precision, num, sizeof(num));
+					if (n < sizeof(num)) {
+						append_padded(buf, num, n, width, left, fill);
 					} else {
-						if (size_argument) {
-							s << va_arg(ap, size_t);
-						} else {
-							s << va_arg(ap, unsigned int);
-						}
+						// very large number
+						std::string big(n + 1, 0);
+						format_fixed(d, precision, &big[0], big.size());
+						append_padded(buf, big.data(), n, width, left, fill);
 					}
-					break;
-					
-				// print floating point values
-				case 'e':
-				case 'E':
-				case 'f':
-				case 'F':
-				case 'g':
-				case 'G':
-				case 'a':
-				case 'A':
-					// note: this is nowhere near as versatile as printf()
-					s << va_arg(ap, double);
-					break;
-					
-				case 'C':
-					long_argument = true;
-					// fall through
-					
-				case 'c':
-					if (long_argument) {
-						throw ValueError("format string error (wchar_t is considered a broken type)");
-					} else {
-						s << (char)va_arg(ap, int);
+				}
+				break;
+
+			case 'c':
+				num[0] = (char)va_arg(ap, int);
+				append_padded(buf, num, 1, width, left, fill);
+				break;
+
+			case 's':
+				{
+					const char *cs = va_arg(ap, const char *);
+					if (cs == nullptr) {
+						cs = "(nullptr)";
 					}
-					break;
-					
-				case 'S':
-					long_argument = true;
-					// fall through
-					
-				case 's':
-					if (long_argument) {
-						throw ValueError("format string error (wchar_t* is considered a broken type)");
+					append_padded(buf, cs, std::strlen(cs), width, left, fill);
+				}
+				break;
+
+			// print an object's repr()
+			case 'q':
+				{
+					Base *q = va_arg(ap, Base *);
+					std::string r = q->repr();
+					append_padded(buf, r.data(), r.size(), width, left, fill);
+				}
+				break;
+
+			// print an object's str()
+			case 'v':
+				{
+					Base *v = va_arg(ap, Base *);
+					std::string str = v->str();
+					append_padded(buf, str.data(), str.size(), width, left, fill);
+				}
+				break;
+
+			// print pointer value
+			case 'p':
+				{
+					void *p = va_arg(ap, void *);
+					if (p == nullptr) {
+						append_padded(buf, "(nullptr)", 9, width, left, fill);
 					} else {
-						char *cs = va_arg(ap, char *);
-						if (cs == nullptr) {
-							s << "(nullptr)";
-						} else {
-							s << cs;
-						}
-					}
-					break;
-					
-				// print an object's repr()
-				case 'q':
-					{
-						Base *q = va_arg(ap, Base *);
-						s << q->repr();
+						num[0] = '0';
+						num[1] = 'x';
+						n = format_base((unsigned long)p, 4, false, num + 2) + 2;
+						append_padded(buf, num, n, width, left, fill);
 					}
-					break;
+				}
+				break;
 
-				// print an object's str()
-				case 'v':
-					{
-						Base *v = va_arg(ap, Base *);
-						s << v->str();
-					}
-					break;
+			// boolean value
+			case 't':
+				if ((bool)va_arg(ap, int)) {
+					append_padded(buf, "true", 4, width, left, fill);
+				} else {
+					append_padded(buf, "false", 5, width, left, fill);
+				}
+				break;
 
-				// print pointer value
-				case 'p':
-					{
-						long p = (long)va_arg(ap, void *);
+			// unicode value
+			case 'U':
+				append_padded(buf, "U+", 2, width, left, fill);
+				n = format_base((rune)va_arg(ap, rune), 4, false, num);
+				append_padded(buf, num, n, 4, false, '0');
+				break;
 
-						if (!p) {
-							s << "(nullptr)";
-						} else {
-							s << std::hex << std::showbase << p << std::noshowbase;
-						}
-					}
-					break;
-				
-				// boolean value
-				case 't':
-					s << ((bool)va_arg(ap, int) ? "true" : "false");
-					break;
-
-				// unicode value
-				case 'U':
-					s << "U+" << std::setfill('0') << std::setw(4) << std::hex << std::noshowbase
-						<< (rune)va_arg(ap, rune);
-					break;
-
-				// rune
-				case 'r':
-					{
-						String rs((rune)va_arg(ap, rune));
-						s << rs.str();
-					}
-					break;
+			// rune
+			case 'r':
+				{
+					String rs((rune)va_arg(ap, rune));
+					append_padded(buf, rs.c_str(), rs.len(), width, left, fill);
+				}
+				break;
 
-				// the percent sign
-				case '%':
-					s << '%';
-					break;
+			// the percent sign
+			case '%':
+				append_padded(buf, "%", 1, width, left, fill);
+				break;
 
-				default:
-					throw ValueError("format string error (unsupported modifier)");
-			}
-		} else {
-			s << *fmt;
+			default:
+				// compile_format() does not let this happen
+				throw ValueError("format string error (unsupported modifier)");
 		}
-		if (*fmt) {
-			fmt++;
+	}
+}
+
+
+FormatBuffer::FormatBuffer() : buf_(nullptr), local_(), borrowed_(false) {
+	if (format_buf_taken) {
+		// nested call, eg. from within a repr()
+		buf_ = &local_;
+	} else {
+		format_buf_taken = true;
+		borrowed_ = true;
+		buf_ = &format_buf;
+		buf_->clear();
+	}
+}
+
+FormatBuffer::~FormatBuffer() {
+	if (borrowed_) {
+		// don't keep a huge buffer around forever
+		if (format_buf.capacity() > kFormatBufferKeep) {
+			std::string().swap(format_buf);
 		}
+		format_buf_taken = false;
+	}
+}
+
+void FormatBuffer::format(const char *fmt, ...) {
+	if (fmt == nullptr) {
+		throw ReferenceError();
+	}
+
+	std::va_list ap;
+	va_start(ap, fmt);
+
+	try {
+		vformat_append(*buf_, fmt, ap);
+	} catch(...) {
+		va_end(ap);
+		throw;
 	}
+	va_end(ap);
+}
+
+void FormatBuffer::vformat(const char *fmt, std::va_list ap) {
+	vformat_append(*buf_, fmt, ap);
+}
+
+void vssprint(std::stringstream& s, const char *fmt, std::va_list ap) {
+	if (fmt == nullptr) {
+		throw ReferenceError();
+	}
+	if (!*fmt) {
+		return;
+	}
+
+	FormatBuffer buf;
+	buf.vformat(fmt, ap);
+	s.write(buf.data(), buf.len());
 }
 
 void ssprint(std::stringstream& s, const char *fmt, ...) {
@@ -344,6 +569,424 @@ void ssprint(std::stringstream& s, const char *fmt, ...) {
 	va_end(ap);
 }
 
+/*
+	asynchronous printing
+
+	Every thread that prints gets its own ring buffer. Lines are
+	appended to the ring without locking; a single writer thread
+	drains all rings and writes the lines in batches with writev()
+
+	A record in the ring is a header (length, fd) followed by the
+	text, padded to a multiple of 8 bytes so that a header never
+	wraps around the end of the ring
+*/
+
+struct PrintRecordHeader {
+	uint32_t len;
+	uint32_t fd;
+};
+
+static const size_t kPrintRecordAlign = 8;
+static const int kPrintMaxIov = 256;
+
+class PrintRing {
+public:
+	PrintRing(size_t size) : closed(false), buf_(new char[size]), size_(size), head_(0), tail_(0) { }
+
+	// called by the owning thread only
+	bool push(int fd, const char *data, size_t n) {
+		size_t need = record_size(n);
+		uint64_t head = head_.load(std::memory_order_relaxed);
+		uint64_t tail = tail_.load(std::memory_order_acquire);
+
+		if (size_ - (head - tail) < need) {
+			return false;
+		}
+
+		PrintRecordHeader hdr;
+		hdr.len = n;
+		hdr.fd = fd;
+		std::memcpy(buf_.get() + (head & (size_ - 1)), &hdr, sizeof(hdr));
+		copy_in(head + sizeof(hdr), data, n);
+
+		head_.store(head + need, std::memory_order_release);
+		return true;
+	}
+
+	// called by the writer thread only
+	// returns false if there was nothing to write
+	bool drain(void) {
+		uint64_t tail = tail_.load(std::memory_order_relaxed);
+		uint64_t head = head_.load(std::memory_order_acquire);
+
+		if (tail == head) {
+			return false;
+		}
+
+		struct iovec iov[kPrintMaxIov];
+		int niov = 0;
+		int fd = -1;
+
+		while(tail != head) {
+			PrintRecordHeader hdr;
+			std::memcpy(&hdr, buf_.get() + (tail & (size_ - 1)), sizeof(hdr));
+
+			// write out the batch when it's full, or when the fd changes
+			if (niov > kPrintMaxIov - 2 || (fd != -1 && (int)hdr.fd != fd)) {
+				write_all(fd, iov, niov);
+				niov = 0;
+			}
+			fd = hdr.fd;
+
+			// the text may wrap around the end of the ring
+			size_t offset = (tail + sizeof(hdr)) & (size_ - 1);
+			size_t first = hdr.len;
+			if (offset + first > size_) {
+				first = size_ - offset;
+			}
+			iov[niov].iov_base = buf_.get() + offset;
+			iov[niov].iov_len = first;
+			niov++;
+			if (first < hdr.len) {
+				iov[niov].iov_base = buf_.get();
+				iov[niov].iov_len = hdr.len - first;
+				niov++;
+			}
+
+			tail += record_size(hdr.len);
+		}
+		write_all(fd, iov, niov);
+
+		tail_.store(tail, std::memory_order_release);
+		return true;
+	}
+
+	bool empty(void) const {
+		return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+	}
+
+	size_t size(void) const { return size_; }
+
+	static size_t record_size(size_t n) {
+		return (sizeof(PrintRecordHeader) + n + kPrintRecordAlign - 1) & ~(kPrintRecordAlign - 1);
+	}
+
+	std::atomic<bool> closed;	// owning thread has exited
+
+private:
+	std::unique_ptr<char[]> buf_;
+	size_t size_;		// power of two
+	std::atomic<uint64_t> head_, tail_;
+
+	void copy_in(uint64_t pos, const char *data, size_t n) {
+		size_t offset = pos & (size_ - 1);
+		size_t first = n;
+		if (offset + first > size_) {
+			first = size_ - offset;
+		}
+		std::memcpy(buf_.get() + offset, data, first);
+		std::memcpy(buf_.get(), data + first, n - first);
+	}
+
+	static void write_all(int fd, struct iovec *iov, int niov) {
+		while(niov > 0) {
+			ssize_t n = ::writev(fd, iov, niov);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				// nowhere to report this error
+				return;
+			}
+			// partial write; skip what was written
+			while(niov > 0 && (size_t)n >= iov->iov_len) {
+				n -= iov->iov_len;
+				iov++;
+				niov--;
+			}
+			if (niov > 0) {
+				iov->iov_base = (char *)iov->iov_base + n;
+				iov->iov_len -= n;
+			}
+		}
+	}
+};
+
+// holds the ring of the current thread; marks it closed when the thread exits
+struct PrintRingHolder {
+	std::shared_ptr<PrintRing> ring;
+
+	~PrintRingHolder() {
+		if (ring.get() != nullptr) {
+			ring->closed = true;
+		}
+	}
+};
+
+static std::atomic<bool> async_enabled(false);
+static std::atomic<int> async_users(0);		// threads busy pushing a line
+static std::atomic<size_t> async_dropped(0);
+static std::atomic<size_t> async_dropped_reported(0);
+static std::atomic<bool> writer_sleeping(false);
+static std::atomic<bool> writer_running(false);
+static std::atomic<int> space_waiters(0);
+static std::atomic<uint64_t> flush_requested(0);
+static std::atomic<uint64_t> flush_done(0);
+static PrintOverflow async_overflow = PrintBlock;
+static size_t async_bufsize = 0;
+
+static std::vector<std::shared_ptr<PrintRing> > async_rings;
+static std::mutex async_lock;
+static std::condition_variable writer_cond;		// wakes up the writer
+static std::condition_variable space_cond;		// there is room in a ring
+static std::condition_variable flush_cond;		// a flush completed
+static std::thread *writer_thread = nullptr;
+
+static thread_local PrintRingHolder my_ring;
+
+static void async_writer_main(void) {
+	std::vector<std::shared_ptr<PrintRing> > rings;
+
+	for(;;) {
+		uint64_t flush_gen = flush_requested.load();
+		bool running = writer_running.load();
+
+		{
+			std::lock_guard<std::mutex> guard(async_lock);
+
+			// forget about rings of threads that are gone
+			auto it = async_rings.begin();
+			while(it != async_rings.end()) {
+				if ((*it)->closed && (*it)->empty()) {
+					it = async_rings.erase(it);
+				} else {
+					++it;
+				}
+			}
+			rings = async_rings;
+		}
+
+		// drain until all rings are empty
+		bool busy = true;
+		bool wrote = false;
+		while(busy) {
+			busy = false;
+			for(auto& ring : rings) {
+				if (ring->drain()) {
+					busy = wrote = true;
+				}
+			}
+			if (busy && space_waiters > 0) {
+				std::lock_guard<std::mutex> guard(async_lock);
+				space_cond.notify_all();
+			}
+		}
+
+		if (async_overflow == PrintDropCount) {
+			size_t dropped = async_dropped.load();
+			size_t reported = async_dropped_reported.exchange(dropped);
+			if (dropped != reported) {
+				char msg[64];
+				int n = std::snprintf(msg, sizeof(msg), "print: %zu lines dropped\n", dropped - reported);
+				if (::write(2, msg, n) < 0) {
+					// ignore
+				}
+			}
+		}
+
+		if (flush_gen != flush_done.load()) {
+			std::lock_guard<std::mutex> guard(async_lock);
+			flush_done = flush_gen;
+			flush_cond.notify_all();
+		}
+
+		if (!running) {
+			break;
+		}
+		if (wrote) {
+			continue;
+		}
+
+		// nothing to do; sleep until a thread wakes us up
+		// the timeout is a safety net only
+		std::unique_lock<std::mutex> guard(async_lock);
+		writer_sleeping = true;
+
+		bool pending = (flush_requested.load() != flush_gen) || !writer_running.load();
+		for(auto& ring : rings) {
+			if (!ring->empty()) {
+				pending = true;
+				break;
+			}
+		}
+		if (!pending) {
+			writer_cond.wait_for(guard, std::chrono::milliseconds(100));
+		}
+		writer_sleeping = false;
+	}
+}
+
+static void wake_writer(void) {
+	if (writer_sleeping) {
+		std::lock_guard<std::mutex> guard(async_lock);
+		writer_cond.notify_one();
+	}
+}
+
+// in a forked child process there is no writer thread
+static void async_atfork_child(void) {
+	async_enabled = false;
+	writer_running = false;
+	writer_thread = nullptr;	// deliberately leaked; the thread does not exist here
+	async_rings.clear();
+	my_ring.ring.reset();
+}
+
+static void async_atexit(void) {
+	print_sync();
+}
+
+// queue a line for the writer thread
+// returns false if printing is not asynchronous
+static bool async_write(std::ostream& os, const char *data, size_t n) {
+	int fd;
+	if (&os == &std::cout) {
+		fd = 1;
+	} else if (&os == &std::cerr) {
+		fd = 2;
+	} else {
+		return false;
+	}
+
+	async_users++;
+	if (!async_enabled) {
+		async_users--;
+		return false;
+	}
+
+	if (my_ring.ring.get() == nullptr || my_ring.ring->size() != async_bufsize) {
+		if (my_ring.ring.get() != nullptr) {
+			my_ring.ring->closed = true;
+		}
+		my_ring.ring = std::make_shared<PrintRing>(async_bufsize);
+
+		std::lock_guard<std::mutex> guard(async_lock);
+		async_rings.push_back(my_ring.ring);
+	}
+
+	PrintRing *ring = my_ring.ring.get();
+
+	if (PrintRing::record_size(n) > ring->size()) {
+		// doesn't fit, ever
+		async_users--;
+		return false;
+	}
+
+	while(!ring->push(fd, data, n)) {
+		if (async_overflow != PrintBlock) {
+			async_dropped++;
+			async_users--;
+			return true;
+		}
+
+		// wait for the writer to make room
+		space_waiters++;
+		wake_writer();
+		{
+			std::unique_lock<std::mutex> guard(async_lock);
+			space_cond.wait_for(guard, std::chrono::milliseconds(10));
+		}
+		space_waiters--;
+	}
+	async_users--;
+
+	wake_writer();
+	return true;
+}
+
+void print_async(PrintOverflow overflow, size_t bufsize) {
+	if (bufsize < 1024) {
+		throw ValueError("print_async(): buffer size too small");
+	}
+
+	// round up to power of two
+	size_t size = 1024;
+	while(size < bufsize) {
+		size <<= 1;
+	}
+
+	print_sync();
+
+	static bool atfork_installed = false;
+	if (!atfork_installed) {
+		::pthread_atfork(nullptr, nullptr, async_atfork_child);
+		std::atexit(async_atexit);
+		atfork_installed = true;
+	}
+
+	// anything written through the iostreams should go out first
+	std::cout.flush();
+	std::cerr.flush();
+
+	async_overflow = overflow;
+	async_bufsize = size;
+	async_dropped = 0;
+	async_dropped_reported = 0;
+
+	writer_running = true;
+	try {
+		writer_thread = new std::thread(async_writer_main);
+	} catch(const std::system_error&) {
+		writer_running = false;
+		throw OSError("failed to start print writer thread");
+	}
+	async_enabled = true;
+}
+
+void print_sync(void) {
+	if (!async_enabled) {
+		return;
+	}
+	async_enabled = false;
+
+	// wait for threads that are still busy pushing a line
+	while(async_users > 0) {
+		std::this_thread::yield();
+	}
+
+	// the writer drains everything before it stops
+	writer_running = false;
+	{
+		std::lock_guard<std::mutex> guard(async_lock);
+		writer_cond.notify_one();
+	}
+	if (writer_thread != nullptr) {
+		writer_thread->join();
+		delete writer_thread;
+		writer_thread = nullptr;
+	}
+}
+
+void print_flush(void) {
+	if (!async_enabled) {
+		std::cout.flush();
+		std::cerr.flush();
+		return;
+	}
+
+	uint64_t gen = ++flush_requested;
+
+	std::unique_lock<std::mutex> guard(async_lock);
+	writer_cond.notify_one();
+	while(flush_done < gen && writer_running) {
+		flush_cond.wait_for(guard, std::chrono::milliseconds(100));
+	}
+}
+
+size_t print_dropped(void) {
+	return async_dropped;
+}
+
 // vprint to output stream
 void vosprint(std::ostream& os, const char *fmt, std::va_list ap) {
 	if (fmt == nullptr) {
@@ -352,12 +995,17 @@ void vosprint(std::ostream& os, const char *fmt, std::va_list ap) {
 	if (!*fmt) {
 		return;
 	}
-	std::stringstream s;
+	FormatBuffer buf;
+	buf.vformat(fmt, ap);
+	buf.append('\n');
 
-	vssprint(s, fmt, ap);
+	if (async_enabled && async_write(os, buf.data(), buf.len())) {
+		return;
+	}
 
 	printer_lock.lock();
-	os << s.str() << std::endl;
+	os.write(buf.data(), buf.len());
+	os.flush();
 	printer_lock.unlock();
 }
 
@@ -369,16 +1017,23 @@ void vosprintn(std::ostream& os, const char *fmt, std::va_list ap) {
 	if (!*fmt) {
 		return;
 	}
-	std::stringstream s;
+	FormatBuffer buf;
+	buf.vformat(fmt, ap);
 
-	vssprint(s, fmt, ap);
+	if (async_enabled && async_write(os, buf.data(), buf.len())) {
+		return;
+	}
 
 	printer_lock.lock();
-	os << s.str();
+	os.write(buf.data(), buf.len());
 	printer_lock.unlock();
 }
 
 void print(void) {
+	if (async_enabled && async_write(std::cout, "\n", 1)) {
+		return;
+	}
+
 	printer_lock.lock();
 	std::cout << std::endl;
 	printer_lock.unlock();
@@ -411,6 +1066,10 @@ void printn(const char *fmt, ...) {
 }
 
 void printerr(void) {
+	if (async_enabled && async_write(std::cerr, "\n", 1)) {
+		return;
+	}
+
 	printer_lock.lock();
 	std::cerr << std::endl;
 	printer_lock.unlock();
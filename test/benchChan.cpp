@@ -0,0 +1,132 @@
+/*
+	benchChan.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+
+using namespace oo;
+
+static const int kMessages = 204800;
+
+// one producer, one consumer; the channel fills up when the consumer
+// is slower, so deep channels really are kept deep
+template <typename C>
+void bench(const char *name, size_t depth) {
+	C c(depth);
+
+	// prefill, so that every read works on a full buffer
+	for(size_t i = 0; i < depth - 1; i++) {
+		c.put(0);
+	}
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	go([&c]() {
+		for(int i = 0; i < kMessages; i++) {
+			c.put(i);
+		}
+	});
+
+	long long sum = 0;
+	for(size_t i = 0; i < kMessages + depth - 1; i++) {
+		sum += c.get();
+	}
+	join();
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	if (sum != (long long)kMessages * (kMessages - 1) / 2) {
+		print("FAIL; messages were lost");
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	print("%-10s depth %-6zu %8.2f ms  %8.0f msgs/s", name, depth, ms, kMessages / ms * 1000.0);
+}
+
+// the same, in batches of 256 items
+template <typename C>
+void bench_batch(const char *name, size_t depth) {
+	const size_t kBatch = 256;
+	C c(depth);
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	go([&c]() {
+		int items[kBatch];
+		for(int i = 0; i < kMessages; i += kBatch) {
+			for(size_t j = 0; j < kBatch; j++) {
+				items[j] = i + j;
+			}
+			c.write_many(items, kBatch);
+		}
+	});
+
+	long long sum = 0;
+	int items[kBatch];
+	for(int i = 0; i < kMessages; ) {
+		size_t n = c.read_many(items, kBatch);
+		for(size_t j = 0; j < n; j++) {
+			sum += items[j];
+		}
+		i += n;
+	}
+	join();
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	if (sum != (long long)kMessages * (kMessages - 1) / 2) {
+		print("FAIL; messages were lost");
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	print("%-10s depth %-6zu %8.2f ms  %8.0f msgs/s  (batch)", name, depth, ms, kMessages / ms * 1000.0);
+}
+
+int main(void) {
+	bench<Chan<int> >("Chan", 1);
+	bench<Chan<int> >("Chan", 64);
+	bench<Chan<int> >("Chan", 4096);
+	bench<Chan<int> >("Chan", 10000);
+
+	bench<SpscChan<int> >("SpscChan", 1);
+	bench<SpscChan<int> >("SpscChan", 64);
+	bench<SpscChan<int> >("SpscChan", 4096);
+
+	bench<MpmcChan<int> >("MpmcChan", 1);
+	bench<MpmcChan<int> >("MpmcChan", 64);
+	bench<MpmcChan<int> >("MpmcChan", 4096);
+
+	bench_batch<Chan<int> >("Chan", 4096);
+	bench_batch<SpscChan<int> >("SpscChan", 4096);
+	bench_batch<MpmcChan<int> >("MpmcChan", 4096);
+	return 0;
+}
+
+// EOB
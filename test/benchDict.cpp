@@ -0,0 +1,106 @@
+/*
+	benchDict.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+#include <vector>
+
+using namespace oo;
+
+static const int kKeys = 200000;
+static const int kLookups = 2000000;
+
+static std::vector<String> keys;
+
+template <typename F>
+void bench(const char *name, F func) {
+	auto t0 = std::chrono::steady_clock::now();
+
+	size_t found = func();
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	print("%-24s %8.2f ms  (%zu)", name, ms, found);
+}
+
+int main(void) {
+	for(int i = 0; i < kKeys; i++) {
+		keys.push_back(sprint("/api/v1/route/%d/items", i * 7919));
+	}
+
+	Dict<int> d;
+	HashDict<int> h;
+
+	bench("Dict insert", [&]() -> size_t {
+		for(int i = 0; i < kKeys; i++) {
+			d[keys[i]] = i;
+		}
+		return len(d);
+	});
+	bench("HashDict insert", [&]() -> size_t {
+		for(int i = 0; i < kKeys; i++) {
+			h[keys[i]] = i;
+		}
+		return len(h);
+	});
+
+	bench("Dict has_key", [&]() -> size_t {
+		size_t found = 0;
+		for(int i = 0; i < kLookups; i++) {
+			found += d.has_key(keys[(i * 31) % kKeys]);
+		}
+		return found;
+	});
+	bench("HashDict has_key", [&]() -> size_t {
+		size_t found = 0;
+		for(int i = 0; i < kLookups; i++) {
+			found += h.has_key(keys[(i * 31) % kKeys]);
+		}
+		return found;
+	});
+	bench("HashDict has_key(char*)", [&]() -> size_t {
+		size_t found = 0;
+		for(int i = 0; i < kLookups; i++) {
+			found += h.has_key(keys[(i * 31) % kKeys].c_str());
+		}
+		return found;
+	});
+	bench("HashDict miss", [&]() -> size_t {
+		size_t found = 0;
+		for(int i = 0; i < kLookups; i++) {
+			found += h.has_key("/api/v1/route/none");
+		}
+		return found;
+	});
+	return 0;
+}
+
+// EOB
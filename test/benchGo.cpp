@@ -0,0 +1,110 @@
+/*
+	benchGo.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace oo;
+
+static const int kTasks = 20000;
+
+std::atomic<long> counter(0);
+
+void task(int n) {
+	counter += n;
+}
+
+// spawn a binary tree of tasks from within the pool
+void tree(ThreadPool *pool, int lo, int hi) {
+	if (hi - lo <= 1) {
+		counter += lo;
+		return;
+	}
+	int mid = lo + (hi - lo) / 2;
+	pool->go(tree, pool, lo, mid);
+	pool->go(tree, pool, mid, hi);
+}
+
+static void report(const char *name, std::chrono::steady_clock::time_point t0) {
+	auto t1 = std::chrono::steady_clock::now();
+
+	if (counter != (long)kTasks * (kTasks - 1) / 2) {
+		print("FAIL; tasks were lost");
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	print("%-16s %8.2f ms  %8.0f tasks/s", name, ms, kTasks / ms * 1000.0);
+}
+
+int main(void) {
+	// a thread per task, the way go() used to do it
+	counter = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	threads.reserve(kTasks);
+	for(int i = 0; i < kTasks; i++) {
+		threads.push_back(std::thread(task, i));
+	}
+	for(auto& t : threads) {
+		t.join();
+	}
+	report("std::thread", t0);
+
+	counter = 0;
+	t0 = std::chrono::steady_clock::now();
+	for(int i = 0; i < kTasks; i++) {
+		go(task, i);
+	}
+	join();
+	report("go()", t0);
+
+	ThreadPool pool(4);
+	counter = 0;
+	t0 = std::chrono::steady_clock::now();
+	for(int i = 0; i < kTasks; i++) {
+		pool.go(task, i);
+	}
+	pool.wait();
+	report("ThreadPool(4)", t0);
+
+	// every task but the first comes from within the pool
+	counter = 0;
+	t0 = std::chrono::steady_clock::now();
+	pool.go(tree, &pool, 0, kTasks);
+	pool.wait();
+	report("tree of tasks", t0);
+
+	return 0;
+}
+
+// EOB
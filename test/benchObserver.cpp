@@ -0,0 +1,91 @@
+/*
+	benchObserver.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace oo;
+
+static const int kEvents = 1000000;
+
+class Nop : public Observer {
+public:
+	Nop() : count(0) { }
+
+	void notify(const char *) { count++; }
+
+	long count;
+};
+
+template <typename F>
+void timeit(const char *name, F f) {
+	auto t0 = std::chrono::steady_clock::now();
+	f();
+	auto t1 = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / kEvents;
+	print("%-20s %6.1f ns per event", name, ns);
+}
+
+int main(void) {
+	Nop o[4];
+	const char *event = "bench event";
+
+	// some other events, so that the lookup has something to do
+	for(int i = 0; i < 100; i++) {
+		char name[32];
+		std::snprintf(name, sizeof(name), "event %d", i);
+		add_observer(o[0], name);
+	}
+	for(int i = 0; i < 4; i++) {
+		add_observer(o[i], event);
+	}
+	EventId id = event_id(event);
+
+	timeit("notify(const char *)", [&]() {
+		for(int i = 0; i < kEvents; i++) {
+			notify(event);
+		}
+	});
+	timeit("notify(EventId)", [&]() {
+		for(int i = 0; i < kEvents; i++) {
+			notify(id);
+		}
+	});
+	timeit("post(EventId)", [&]() {
+		for(int i = 0; i < kEvents; i++) {
+			post(id);
+		}
+		defaultNotificationCenter.flush();
+	});
+	return 0;
+}
+
+// EOB
@@ -0,0 +1,82 @@
+/*
+	benchPar.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+
+using namespace oo;
+
+static const int kRecords = 10000000;
+
+template <typename F>
+void timeit(const char *name, F f) {
+	auto t0 = std::chrono::steady_clock::now();
+	f();
+	auto t1 = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	print("%-12s %8.2f ms", name, ms);
+}
+
+int main(void) {
+	Array<int> a(kRecords);
+	for(int i = 0; i < kRecords; i++) {
+		a[i] = i % 1000;
+	}
+
+	auto twice = [](const int& x) { return 2 * x; };
+	auto small = [](const int& x) { return x < 100; };
+	auto add = [](const long& x, const long& y) { return x + y; };
+
+	Array<int> b, c;
+	long x = 0, y = 0;
+
+	print("%d records, %u CPUs", kRecords, std::thread::hardware_concurrency());
+
+	timeit("apply", [&]() { b = apply(twice, a); });
+	timeit("par_apply", [&]() { c = par_apply(twice, a); });
+	if (!(b == c)) {
+		print("FAIL; par_apply() differs");
+	}
+
+	timeit("filter", [&]() { b = filter(small, a); });
+	timeit("par_filter", [&]() { c = par_filter(small, a); });
+	if (!(b == c)) {
+		print("FAIL; par_filter() differs");
+	}
+
+	timeit("reduce", [&]() { x = reduce(add, a); });
+	timeit("par_reduce", [&]() { y = par_reduce(add, a); });
+	if (x != y) {
+		print("FAIL; par_reduce() differs");
+	}
+	return 0;
+}
+
+// EOB
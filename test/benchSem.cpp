@@ -0,0 +1,61 @@
+/*
+	benchSem.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+
+using namespace oo;
+
+static const int kLoops = 10000000;
+
+template <typename S>
+void bench(const char *name, S& sem) {
+	auto t0 = std::chrono::steady_clock::now();
+	for(int i = 0; i < kLoops; i++) {
+		sem.wait();
+		sem.post();
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / kLoops;
+	print("%-10s %6.1f ns per wait+post", name, ns);
+}
+
+int main(void) {
+	Sem sem("benchsem", 1);
+	SharedSem shared(1);
+	FastSem fast(1);
+
+	bench("Sem", sem);
+	bench("SharedSem", shared);
+	bench("FastSem", fast);
+	return 0;
+}
+
+// EOB
@@ -0,0 +1,202 @@
+/*
+	benchString.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using namespace oo;
+
+// count heap allocations made by the library
+
+static size_t num_allocs = 0;
+
+void *operator new(size_t n) {
+	num_allocs++;
+	void *p = std::malloc(n);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new[](size_t n) {
+	return operator new(n);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+	std::free(p);
+}
+
+static const int kLoops = 1000000;
+
+void bench(const char *name, void (*func)(void)) {
+	size_t allocs = num_allocs;
+	auto t0 = std::chrono::steady_clock::now();
+
+	func();
+
+	auto t1 = std::chrono::steady_clock::now();
+	allocs = num_allocs - allocs;
+
+	double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	print("%-16s %10zu allocs  %8.2f ms", name, allocs, ms);
+}
+
+void bench_default(void) {
+	for(int i = 0; i < kLoops; i++) {
+		String s;
+	}
+}
+
+void bench_short(void) {
+	for(int i = 0; i < kLoops; i++) {
+		String s("short key");
+	}
+}
+
+void bench_copy(void) {
+	String s("token");
+	for(int i = 0; i < kLoops; i++) {
+		String t(s);
+	}
+}
+
+void bench_rune(void) {
+	for(int i = 0; i < kLoops; i++) {
+		String s((rune)0x72ac);
+	}
+}
+
+void bench_split(void) {
+	String line("the quick brown fox jumps over the lazy dog");
+	for(int i = 0; i < kLoops / 10; i++) {
+		Array<String> a = line.split();
+	}
+}
+
+void bench_isplit(void) {
+	String line("the quick brown fox jumps over the lazy dog");
+	size_t total = 0;
+	for(int i = 0; i < kLoops / 10; i++) {
+		for(const StringView& field : line.isplit()) {
+			total += field.len();
+		}
+	}
+	if (!total) {
+		print("FAIL; nothing was split");
+	}
+}
+
+void bench_find(void) {
+	// search a 4 MB payload for a delimiter near the end
+	String payload = String("abcdefghijklmnopqrstuvwxyz0123456789") * (4 * 1024 * 1024 / 36);
+	payload += "\r\n\r\n";
+
+	int pos = 0;
+	for(int i = 0; i < 100; i++) {
+		pos += payload.find("\r\n\r\n");
+		pos += payload.find('\r');
+		pos += payload.rfind("xyz0123");
+	}
+	if (pos <= 0) {
+		print("FAIL; delimiter not found");
+	}
+}
+
+void bench_replace(void) {
+	String text = String("a,b;") * 100000;
+
+	Dict<String> d;
+	d[","] = ", ";
+	d[";"] = "; ";
+
+	for(int i = 0; i < 10; i++) {
+		String s = text.replace(",", ", ");
+		s = text.replace_many(d);
+	}
+}
+
+void bench_convert(void) {
+	const char *numbers[] = { "12345", "-987654321", "3.14159", "2.5e-3", "100.25" };
+	double total = 0;
+	for(int i = 0; i < kLoops; i++) {
+		total += convert<int>(numbers[i % 2]);
+		total += convert<double>(numbers[2 + i % 3]);
+	}
+	if (total == 0) {
+		print("FAIL; nothing converted");
+	}
+}
+
+void bench_format(void) {
+	for(int i = 0; i < kLoops; i++) {
+		String s = String::from(i * 7919);
+		s = String::from(i * 0.001);
+	}
+}
+
+void bench_sprint(void) {
+	String path("/index.html");
+	for(int i = 0; i < kLoops; i++) {
+		String s = sprint("%s %v %d %zu %.3f", "GET", &path, 200, (size_t)i, i * 0.5);
+	}
+}
+
+int main(void) {
+	print("%d loops", kLoops);
+	bench("String()", bench_default);
+	bench("String(short)", bench_short);
+	bench("String(copy)", bench_copy);
+	bench("String(rune)", bench_rune);
+	bench("split()", bench_split);
+	bench("isplit()", bench_isplit);
+	bench("find(4 MB)", bench_find);
+	bench("replace()", bench_replace);
+	bench("convert<T>()", bench_convert);
+	bench("String::from()", bench_format);
+	bench("sprint()", bench_sprint);
+	return 0;
+}
+
+// EOB
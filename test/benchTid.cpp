@@ -0,0 +1,90 @@
+/*
+	benchTid.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace oo;
+
+static const int kThreads = 64;
+static const int kCalls = 100000;
+
+// the way gettid() used to work: a map under a global lock
+static std::map<std::thread::id, unsigned int> tid_map;
+static std::mutex tid_map_lock;
+
+unsigned int map_gettid(void) {
+	std::lock_guard<std::mutex> guard(tid_map_lock);
+
+	auto it = tid_map.find(std::this_thread::get_id());
+	if (it == tid_map.end()) {
+		return (unsigned int)-1;
+	}
+	return it->second;
+}
+
+std::atomic<unsigned long> total(0);
+
+template <typename F>
+void bench(const char *name, F f) {
+	total = 0;
+	auto t0 = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for(int i = 0; i < kThreads; i++) {
+		threads.push_back(std::thread([f]() {
+			unsigned long sum = 0;
+			for(int n = 0; n < kCalls; n++) {
+				sum += f();
+			}
+			total += sum;
+		}));
+	}
+	for(auto& t : threads) {
+		t.join();
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	print("%-12s %d threads  %8.2f ms  %8.1f ns/call", name, kThreads, ms, ms * 1e6 / ((double)kThreads * kCalls));
+}
+
+int main(void) {
+	bench("map + lock", map_gettid);
+	bench("gettid()", oo::gettid);
+	return 0;
+}
+
+// EOB
@@ -134,6 +134,38 @@ int main(void) {
 	print("\nreduce(b) == %d", reduce(reducefunc, b));
 	print("reduce(lambda, b) == %d", reduce([](const int& x, const int& y) -> int { return x + y; }, b));
 
+	// parallel versions; big enough to be split up
+	Array<int> big(100000);
+	for(int i = 0; i < 100000; i++) {
+		big[i] = i % 1000;
+	}
+	Array<int> p = par_apply(mul10, big);
+	print("\npar_apply(mul10, big) == apply(): %s", (p == apply(mul10, big)) ? "true" : "false");
+	p = par_filter(val4, big);
+	print("par_filter(val4, big): len %zu, same as filter(): %s", len(p), (p == filter(val4, big)) ? "true" : "false");
+	print("par_reduce(big) == %d", par_reduce(reducefunc, big));
+	print("reduce(big) == %d", reduce(reducefunc, big));
+	int squares[16];
+	par_for(0, 16, [&squares](size_t i) { squares[i] = (int)(i * i); }, 1);
+	print("par_for(): squares[15] == %d", squares[15]);
+
+	// in a goroutine, with another one that waits for it
+	Chan<int> ch(1);
+	WaitGroup finished;
+	finished.add(2);
+	go([&ch, &finished, &squares]() {
+		go([&ch, &finished]() {
+			ch.get();
+			finished.done();
+		});
+		par_for(0, 16, [&squares](size_t i) { squares[i] = (int)i; }, 1);
+		ch.put(1);
+		finished.done();
+	});
+	finished.wait();
+	join();
+	print("par_for() in a goroutine: squares[15] == %d", squares[15]);
+
 	print("\nb = a + b");
 	b = a + b;
 	print("b: %v", &b);
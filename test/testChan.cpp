@@ -29,6 +29,8 @@
 
 #include "oolib"
 
+#include <memory>
+
 using namespace oo;
 
 Chan<int> chan(4);	// channel buffer depth
@@ -72,6 +74,49 @@ int main(void) {
 
 	print("len() : %zu  cap(): %zu", len(chan), cap(chan));
 
+	// batches
+	Chan<int> batch(8);
+	int items[20];
+	for(int i = 0; i < 20; i++) {
+		items[i] = i + 1;
+	}
+	go(
+		[&batch, &items]() {
+			batch.write_many(items, 20);
+		}
+	);
+	int got[20];
+	size_t total = 0;
+	while(total < 20) {
+		size_t n = batch.read_many(got + total, 20 - total, 4);
+		if (n < 4 && total + n < 20) {
+			print("read_many(): got %zu items    <-- BUG", n);
+		}
+		total += n;
+	}
+	join();
+	bool in_order = true;
+	for(int i = 0; i < 20; i++) {
+		if (got[i] != i + 1) {
+			in_order = false;
+		}
+	}
+	print("write_many() / read_many(): %s", in_order ? "OK" : "FAIL");
+
+	batch.write_many(items, 5);
+	Array<int> drained;
+	size_t drained_len = batch.drain(drained);
+	print("drain(): %zu items, len(): %zu", drained_len, len(batch));
+
+	// move-only items
+	Chan<std::unique_ptr<String> > ptrs(2);
+	ptrs.put(std::unique_ptr<String>(new String("first")));
+	ptrs.emplace(new String("second"));
+	std::unique_ptr<String> p = ptrs.get();
+	print("unique_ptr: %v", p.get());
+	ptrs.read(p);
+	print("unique_ptr: %v", p.get());
+
 //	del(chan);
 	chan.clear();
 	print("operator!(): %s", (!chan) ? "OK" : "FAIL");
@@ -0,0 +1,133 @@
+/*
+	testFuture.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+#include <thread>
+
+using namespace oo;
+
+int add(int a, int b) {
+	return a + b;
+}
+
+String greet(const char *name) {
+	return String("hello, ") + name;
+}
+
+int fail(void) {
+	throw ValueError("no such answer");
+}
+
+int slow(int n, int ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	return n;
+}
+
+int main(void) {
+	Future<int> f = async(add, 20, 22);
+	print("async(): %d", f.get());
+	print("get() again: %d", f.get());
+
+	Future<String> s = async(greet, "world");
+	print("async(): %v", &s.get());
+
+	Future<void> v = async([]() { print("void task runs"); });
+	v.get();
+	print("ready(): %s", v.ready() ? "true" : "false");
+
+	// errors come out of get()
+	Future<int> e = async(fail);
+	try {
+		e.get();
+		print("get() did not throw    <-- BUG");
+	} catch(ValueError err) {
+		print("get() threw: %v", &err);
+	}
+
+	// timeouts
+	Future<int> late = async(slow, 1, 200);
+	print("wait_for() timed out: %s", late.wait_for(std::chrono::milliseconds(10)) ? "FAIL" : "OK");
+	print("wait_for(): %s", late.wait_for(std::chrono::seconds(5)) ? "OK" : "FAIL");
+
+	// continuations
+	Future<int> doubled = async(add, 1, 2).then([](int n) { return n * 2; });
+	Future<String> text = doubled.then([](int n) { return String("six") + (n == 6 ? "" : "?"); });
+	print("then(): %d %v", doubled.get(), &text.get());
+
+	Future<int> skipped = e.then([](int n) { print("continuation of an error    <-- BUG"); return n; });
+	try {
+		skipped.get();
+	} catch(ValueError err) {
+		print("then() passes on: %v", &err);
+	}
+
+	// fan out, gather
+	Array<Future<int> > parts;
+	for(int i = 0; i < 10; i++) {
+		parts.push_back(async(add, i, i));
+	}
+	Future<Array<int> > all = when_all(parts);
+	int sum = 0;
+	for(size_t i = 0; i < all.get().len(); i++) {
+		sum += all.get()[i];
+	}
+	print("when_all(): %zu results, sum %d", all.get().len(), sum);
+
+	Array<Future<int> > race;
+	race.push_back(async(slow, 1, 500));
+	race.push_back(async(slow, 2, 1));
+	print("when_any(): %zu", when_any(race).get());
+
+	// by hand
+	Promise<int> p;
+	Future<int> pf = p.future();
+	go([&p]() { p.set_value(7); });
+	print("Promise: %d", pf.get());
+	join();
+	try {
+		p.set_value(8);
+		print("set_value() twice    <-- BUG");
+	} catch(RuntimeError err) {
+		print("set_value() twice: %v", &err);
+	}
+
+	Future<int> none;
+	print("valid(): %s", none.valid() ? "true" : "false");
+
+	// a pool of our own
+	ThreadPool pool(2);
+	print("async_on(): %d", async_on(pool, add, 2, 3).get());
+
+	join();
+	return 0;
+}
+
+// EOB
@@ -29,6 +29,8 @@
 
 #include "oolib"
 
+#include <atomic>
+
 #include <unistd.h>
 
 using namespace oo;
@@ -47,6 +49,32 @@ void testfunc2(void) {
 	oo::join();
 }
 
+// a goroutine keeps its tid, also when it runs other tasks while it
+// waits; tasks that are not goroutines have no tid
+void test_tid(void) {
+	go([]() {
+		unsigned int tid = gettid();
+		std::atomic<bool> task_had_tid(false);
+
+		TaskGroup g;
+		for(int i = 0; i < 8; i++) {
+			go([]() { });
+			g.go([&task_had_tid]() {
+				if (gettid() != (unsigned int)-1) {
+					task_had_tid = true;
+				}
+			});
+		}
+		g.wait();
+		print("goroutine kept its tid: %s", (gettid() == tid) ? "true" : "false");
+		print("TaskGroup task had a tid: %s", task_had_tid.load() ? "true" : "false");
+	});
+	oo::join();
+
+	Future<unsigned int> f = async([]() { return gettid(); });
+	print("async task had a tid: %s", (f.get() != (unsigned int)-1) ? "true" : "false");
+}
+
 int main(void) {
 	for(int i = 0; i < 3; i++) {
 		child(testfunc2);
@@ -54,6 +82,7 @@ int main(void) {
 		jump_tid(10);
 	}
 	oo::wait();
+	test_tid();
 	print("all done");
 	return 0;
 }
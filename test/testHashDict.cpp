@@ -0,0 +1,144 @@
+/*
+	testHashDict.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+using namespace oo;
+
+int main(void) {
+	HashDict<int> d;
+
+	d["aap"] = 1;
+	d["noot"] = 2;
+	d["mies"] = 3;
+
+	print("len(d): %zu", len(d));
+
+	if (d.has_key("aap"))
+		print("d['aap']: %d", d["aap"]);
+	else
+		print("FAIL; no key \"aap\"");
+
+	if (d.has_key("jet"))
+		print("FAIL; d['jet']: %d", d["jet"]);
+	else
+		print("no key \"jet\"");
+
+	// lookup by view does not create a String
+	String line = "noot mies";
+	StringView v = line.view().substr(0, 4);
+	const int *p = d.find(v);
+	if (p != nullptr)
+		print("find(view 'noot'): %d", *p);
+	else
+		print("FAIL; no key \"noot\"");
+
+	if (d.find("wim") == nullptr)
+		print("find('wim'): nullptr");
+	else
+		print("FAIL; find('wim') found something");
+
+	HashDict<int> d3 = d;
+	if (d3 == d)
+		print("d and d3 are equal");
+	else
+		print("FAIL; d and d3 are not seen as equal");
+
+	d["aap"] *= 10;
+	if (d3 == d)
+		print("FAIL; d and d3 are still seen as equal");
+	else
+		print("OK; d and d3 are no longer equal");
+
+	HashDict<int> d2 = d;
+	print("del('aap'): %d", (int)d.del("aap"));
+	print("del('jet'): %d", (int)d.del("jet"));
+	print("len(d): %zu", len(d));
+	print("len(d2): %zu", len(d2));
+	print("len(d3): %zu", len(d3));
+
+	d2.clear();
+	print("clear(): len(d2): %zu", len(d2));
+	print();
+
+	// the order is unspecified, so sort the keys
+	Array<String> keys = d3.keys();
+	keys.sort();
+	foreach(i, keys)
+		print("keys[%u]: %q", i, &keys[i]);
+	print();
+
+	print("C++11 range-based for-loop");
+	int sum = 0;
+	for(auto& kv : d3)
+		sum += kv.second;
+	print(" sum of values: %d", sum);
+	print();
+
+	// grow, delete, and grow again
+	HashDict<String> big;
+	for(int i = 0; i < 10000; i++) {
+		String key = sprint("key%d", i);
+		big[key] = String::from(i);
+	}
+	print("len(big): %zu", len(big));
+	for(int i = 0; i < 10000; i += 2) {
+		big.del(sprint("key%d", i));
+	}
+	print("len(big) after del: %zu", len(big));
+	for(int i = 0; i < 10000; i += 4) {
+		big[sprint("key%d", i)] = "again";
+	}
+	int errors = 0;
+	for(int i = 0; i < 10000; i++) {
+		String key = sprint("key%d", i);
+		const String *value = big.find(key);
+		if (i % 4 == 0) {
+			if (value == nullptr || *value != "again")
+				errors++;
+		} else if (i % 2 == 0) {
+			if (value != nullptr)
+				errors++;
+		} else {
+			if (value == nullptr || *value != String::from(i))
+				errors++;
+		}
+	}
+	print("len(big): %zu, errors: %d", len(big), errors);
+	print();
+
+	del(d);
+	print("del(d): len(d): %zu", len(d));
+	print("d.empty(): %s", d.empty() ? "OK" : "FAIL");
+	print("operator!(): %s", (!d) ? "OK" : "FAIL");
+
+	return 0;
+}
+
+// EOB
@@ -0,0 +1,148 @@
+/*
+	testLockFreeChan.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <memory>
+
+using namespace oo;
+
+const int kItems = 100000;
+
+SpscChan<int> spsc(16);
+MpmcChan<int> mpmc(16);
+MpmcChan<long> sums(4);
+Chan<int> done(4);
+
+void producer(void) {
+	for(int i = 1; i <= kItems; i++) {
+		mpmc.put(i);
+	}
+	done.put(1);
+}
+
+void consumer(void) {
+	long sum = 0;
+	for(;;) {
+		int n = mpmc.get();
+		if (n == -1) {
+			break;
+		}
+		sum += n;
+	}
+	sums.put(sum);
+}
+
+int main(void) {
+	print("SpscChan cap(): %zu", cap(spsc));
+
+	go(
+		[]() {
+			for(int i = 1; i <= kItems; i++) {
+				spsc.put(i);
+			}
+		}
+	);
+	long sum = 0;
+	for(int i = 1; i <= kItems; i++) {
+		sum += spsc.get();
+	}
+	join();
+	print("SpscChan sum: %s", (sum == (long)kItems * (kItems + 1) / 2) ? "OK" : "FAIL");
+
+	int n;
+	print("SpscChan try_get() on empty: %s", spsc.try_get(n) ? "FAIL" : "OK");
+
+	// four writers, four readers
+	const int num_threads = 4;
+	for(int i = 0; i < num_threads; i++) {
+		go(producer);
+		go(consumer);
+	}
+	// when all items have been written, tell the consumers to stop
+	for(int i = 0; i < num_threads; i++) {
+		done.get();
+	}
+	for(int i = 0; i < num_threads; i++) {
+		mpmc.put(-1);
+	}
+	sum = 0;
+	for(int i = 0; i < num_threads; i++) {
+		sum += sums.get();
+	}
+	join();
+	print("MpmcChan sum: %s", (sum == (long)num_threads * kItems * (kItems + 1) / 2) ? "OK" : "FAIL");
+
+	// fill it up
+	int count = 0;
+	while(mpmc.try_put(count)) {
+		count++;
+	}
+	print("MpmcChan try_put() until full: %d  len(): %zu", count, len(mpmc));
+
+	// batches
+	MpmcChan<int> batch(8);
+	int items[20];
+	for(int i = 0; i < 20; i++) {
+		items[i] = i + 1;
+	}
+	go(
+		[&batch, &items]() {
+			batch.write_many(items, 20);
+		}
+	);
+	int got[20];
+	size_t total = 0;
+	while(total < 20) {
+		total += batch.read_many(got + total, 20 - total, 20 - total);
+	}
+	join();
+	bool in_order = true;
+	for(int i = 0; i < 20; i++) {
+		if (got[i] != i + 1) {
+			in_order = false;
+		}
+	}
+	print("MpmcChan write_many() / read_many(): %s", in_order ? "OK" : "FAIL");
+
+	spsc.write_many(items, 5);
+	Array<int> drained;
+	size_t drained_len = spsc.drain(drained);
+	print("SpscChan drain(): %zu items, len(): %zu", drained_len, len(spsc));
+	print("SpscChan try_read_many() on empty: %zu", spsc.try_read_many(got, 20));
+
+	// move-only items
+	SpscChan<std::unique_ptr<String> > ptrs(2);
+	ptrs.emplace(new String("moved"));
+	std::unique_ptr<String> p = ptrs.get();
+	print("unique_ptr: %v", p.get());
+	return 0;
+}
+
+// EOB
@@ -0,0 +1,115 @@
+/*
+	testLockStat.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+#include <thread>
+
+using namespace oo;
+
+static const int kTasks = 4;
+static const int kLoops = 1000;
+
+int main(void) {
+	Mutex hot("hot");
+	Mutex here(OO_HERE);
+	Mutex anon;
+	Chan<int> chan(1, "chan");
+	WaitGroup wg;
+
+	print("anonymous Mutex has no stat: %s", (anon.stat() == nullptr) ? "true" : "false");
+	print("named after call site: %s", (here.stat()->name().find("testLockStat.cpp:") != std::string::npos) ? "true" : "false");
+
+	// nothing is counted while profiling is off
+	hot.lock();
+	hot.unlock();
+	print("disabled: acquired %lu", (unsigned long)hot.stat()->acquired());
+
+	lockstat_enable();
+
+	// hold the lock for a while, so that the others must wait
+	wg.add(kTasks);
+	for(int i = 0; i < kTasks; i++) {
+		go([&]() {
+			for(int j = 0; j < kLoops; j++) {
+				hot.lock();
+				if (j % 100 == 0) {
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+				hot.unlock();
+			}
+			wg.done();
+		});
+	}
+	wg.wait();
+
+	const LockStat *st = hot.stat();
+	print("hot: acquired %lu", (unsigned long)st->acquired());
+	print("hot: contended > 0: %s", (st->contended() > 0) ? "true" : "false");
+	print("hot: waited: %s", (st->wait_ns() > 0 && st->max_wait_ns() <= st->wait_ns()) ? "true" : "false");
+	print("hot: max hold >= 100 us: %s", (st->max_hold_ns() >= 100000) ? "true" : "false");
+
+	here.lock();
+	bool ok = true;
+	std::thread t([&]() { ok = here.trylock(); });
+	t.join();
+	print("trylock() while locked: %s", ok ? "true" : "false");
+	here.unlock();
+	print("here: acquired %lu, contended %lu", (unsigned long)here.stat()->acquired(),
+		(unsigned long)here.stat()->contended());
+
+	// a reader that has to wait for the writer
+	go([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		chan.write(1);
+	});
+	int x = 0;
+	chan.read(x);
+	chan.write(2);
+	chan.read(x);
+	join();
+	print("chan: acquired %lu, contended %lu", (unsigned long)chan.stat()->acquired(),
+		(unsigned long)chan.stat()->contended());
+	print("chan: waited >= 5 ms: %s", (chan.stat()->max_wait_ns() >= 5000000) ? "true" : "false");
+
+	std::string report = lockstat_report();
+	print("report lists hot first: %s", (report.find("\nhot ") != std::string::npos
+		&& report.find("\nhot ") < report.find("\nprinter_lock")) ? "true" : "false");
+
+	std::string json = lockstat_json();
+	print("json has printer_lock: %s", (json.find("{\"name\": \"printer_lock\", \"acquired\": ") != std::string::npos) ? "true" : "false");
+
+	lockstat_reset();
+	print("after reset: acquired %lu", (unsigned long)hot.stat()->acquired());
+	lockstat_enable(false);
+	return 0;
+}
+
+// EOB
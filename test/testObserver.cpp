@@ -29,6 +29,11 @@
 
 #include "oolib"
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
 using namespace oo;
 
 
@@ -55,6 +60,194 @@ private:
 };
 
 
+// counts, and may remove itself while being notified
+class Counter : public Observer {
+public:
+	Counter() : count(0), once(false) { }
+
+	void notify(const char *event) {
+		count++;
+		if (once) {
+			remove_observer(*this);
+		}
+	}
+
+	std::atomic<int> count;
+	bool once;
+};
+
+void test_event_id(void) {
+	EventId e3 = event_id("event #3");
+	print("event_id() is the same each time: %s", (event_id("event #3") == e3) ? "true" : "false");
+	print("find_event_id(): %s", (find_event_id("event #3") == e3) ? "true" : "false");
+	print("find_event_id() of unknown: %s", (find_event_id("no such event") == kNoEvent) ? "true" : "false");
+	print("event_name(): %s", event_name(e3));
+
+	MyObserver o3("o3");
+	add_observer(o3, e3);
+	notify(e3);
+	notify("event #3");
+	remove_observer(o3, e3);
+	notify(e3);		// not seen
+
+	// an observer that removes itself during notify
+	Counter c1, c2;
+	c1.once = true;
+	add_observer(c1, e3);
+	add_observer(c2, e3);
+	notify(e3);
+	notify(e3);
+	print("c1 removed itself: count %d, c2: count %d", c1.count.load(), c2.count.load());
+	remove_observer(c2);
+
+	// notify from threads, while observers come and go
+	Counter c3;
+	add_observer(c3, e3);
+	for(int i = 0; i < 4; i++) {
+		go([e3]() {
+			for(int j = 0; j < 10000; j++) {
+				notify(e3);
+			}
+		});
+	}
+	for(int i = 0; i < 1000; i++) {
+		add_observer(c2, e3);
+		remove_observer(c2, e3);
+	}
+	join();
+	print("c3: count %d", c3.count.load());
+	remove_observer(c3);
+}
+
+// remembers what it saw, and may take its time
+class Recorder : public Observer {
+public:
+	Recorder(int ms = 0) : delay(ms), started(false), seen(), mx() { }
+
+	void notify(const char *event) {
+		started = true;
+		if (delay > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+		}
+		std::lock_guard<std::mutex> lk(mx);
+		if (!seen.empty()) {
+			seen += " ";
+		}
+		seen += event;
+	}
+
+	String get(void) {
+		std::lock_guard<std::mutex> lk(mx);
+		return seen;
+	}
+
+	int delay;
+	std::atomic<bool> started;
+	String seen;
+	std::mutex mx;
+};
+
+void test_async(void) {
+	NotificationCenter nc;
+	nc.start_async(2, std::chrono::milliseconds(20));
+
+	EventId a = event_id("A"), b = event_id("B"), c = event_id("C");
+
+	// in order, per observer
+	Recorder r1;
+	nc.add_observer(r1, a);
+	nc.add_observer(r1, b);
+	nc.add_observer(r1, c);
+	nc.post(a);
+	nc.post(b);
+	nc.post(c);
+	nc.flush();
+	print("async: r1 saw: %v", &r1.seen);
+
+	// duplicates within the window are delivered once
+	Counter cnt;
+	nc.add_observer(cnt, a);
+	for(int i = 0; i < 10; i++) {
+		nc.post(a);
+	}
+	nc.flush();
+	print("async: 10 posts, %d delivered", cnt.count.load());
+
+	// the queue holds 2 events; the third one does not fit
+	bool ok1 = nc.try_post(a);
+	bool ok2 = nc.try_post(b);
+	bool ok3 = nc.try_post(c);
+	print("async: try_post(): %s %s %s", ok1 ? "true" : "false", ok2 ? "true" : "false", ok3 ? "true" : "false");
+	nc.flush();
+	nc.remove_observer(r1);
+	nc.remove_observer(cnt);
+
+	// a slow observer holds up neither the poster, nor the other observers
+	Recorder slow(200), fast;
+	nc.add_observer(slow, "D");
+	nc.add_observer(fast, "D");
+
+	auto t0 = std::chrono::steady_clock::now();
+	nc.post("D");
+	auto t1 = std::chrono::steady_clock::now();
+	print("async: post() returned right away: %s", (t1 - t0 < std::chrono::milliseconds(100)) ? "true" : "false");
+
+	while(fast.get().empty()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	print("async: fast observer done before slow one: %s", slow.get().empty() ? "true" : "false");
+
+	// remove_observer() waits for the delivery to finish
+	while(!slow.started) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	nc.remove_observer(slow);
+	print("async: slow observer saw: %v", &slow.seen);
+	nc.remove_observer(fast);
+	nc.stop_async();
+}
+
+// a slow observer that falls behind makes post() block
+void test_backpressure(void) {
+	NotificationCenter nc;
+	nc.start_async(4);
+
+	Recorder slow(20);
+	EventId ids[16];
+	for(int i = 0; i < 16; i++) {
+		ids[i] = event_id(sprint("P%d", i).c_str());
+		nc.add_observer(slow, ids[i]);
+	}
+
+	// the queue and the mailbox hold 4 each, the rest has to wait
+	auto t0 = std::chrono::steady_clock::now();
+	for(int i = 0; i < 16; i++) {
+		nc.post(ids[i]);
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	print("backpressure: post() blocked: %s", (t1 - t0 >= std::chrono::milliseconds(100)) ? "true" : "false");
+	nc.flush();
+	print("backpressure: slow observer saw %v", &slow.seen);
+	nc.remove_observer(slow);
+
+	// an event that is waiting in the mailbox is delivered once
+	Recorder slow2(200);
+	EventId x = event_id("X");
+	nc.add_observer(slow2, ids[0]);
+	nc.add_observer(slow2, x);
+	nc.post(ids[0]);
+	while(!slow2.started) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	nc.post(x);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	nc.post(x);
+	nc.flush();
+	print("backpressure: slow2 saw: %v", &slow2.seen);
+	nc.remove_observer(slow2);
+	nc.stop_async();
+}
+
 int main(int argc, char *argv[]) {
 	MyObserver o("o1");
 	add_observer(o, Event1);
@@ -76,6 +269,9 @@ int main(int argc, char *argv[]) {
 	notify(Event1);	// not seen; there are no observers
 	notify(Event2);
 
+	test_event_id();
+	test_async();
+	test_backpressure();
 	return 0;
 }
 
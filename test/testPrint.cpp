@@ -29,8 +29,32 @@
 
 #include "oolib"
 
+#include <cstring>
+
 using namespace oo;
 
+// format strings 512 bytes apart land in the same slot of the format cache
+static char formats[1024];
+static const char *outer_fmt = formats;
+static const char *inner_fmt = formats + 512;
+
+// repr() formats with a format string that takes the slot of the outer one
+class Nested : public Base {
+public:
+	std::string repr(void) const {
+		FormatBuffer buf;
+		buf.format(inner_fmt, 1, 2, 3, 4, 5, 6, 7, 8);
+		return std::string(buf.data(), buf.len());
+	}
+
+	bool operator!(void) const { return false; }
+};
+
+std::ostream& operator<<(std::ostream& os, const Nested& n) {
+	os << n.str();
+	return os;
+}
+
 int main(void) {
 	printn("This is a test ...");
 	print(" OK");
@@ -77,6 +101,29 @@ int main(void) {
 	print("unicode U+3069: %r", 0x3061);
 
 	print("the percent sign: %%");
+
+	// the inner format is longer, so recompiling the slot reallocates it
+	std::strcpy((char *)outer_fmt, "nested: [%v] then [%d] and [%s]");
+	std::strcpy((char *)inner_fmt, "a much longer inner format string: %d %d %d %d %d %d %d %d");
+	Nested nested;
+	print(outer_fmt, &nested, 7, "done");
+	print(outer_fmt, &nested, 8, "again");
+
+	print_async();
+	for(int i = 0; i < 4; i++) {
+		go(
+			[i]() {
+				for(int j = 0; j < 3; j++) {
+					print("async: thread %d line %d", i, j);
+				}
+			}
+		);
+	}
+	join();
+	print_flush();
+	printerr("async: stderr");
+	print_sync();
+	print("print_dropped: %zu", print_dropped());
 	return 0;
 }
 
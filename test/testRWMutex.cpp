@@ -0,0 +1,159 @@
+/*
+	testRWMutex.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace oo;
+
+static const int kTasks = 8;
+static const int kLoops = 100000;
+
+int main(void) {
+	// SpinMutex guards a plain int
+	SpinMutex smx;
+	int counter = 0;
+	WaitGroup wg;
+
+	print("%v", &smx);
+	wg.add(kTasks);
+	for(int i = 0; i < kTasks; i++) {
+		go([&]() {
+			for(int j = 0; j < kLoops; j++) {
+				std::lock_guard<SpinMutex> lk(smx);
+				counter++;
+			}
+			wg.done();
+		});
+	}
+	wg.wait();
+	print("SpinMutex: counter == %d: %s", counter, (counter == kTasks * kLoops) ? "OK" : "FAIL");
+	print("try_lock(): %s", smx.try_lock() ? "true" : "false");
+	print("%v", &smx);
+	print("try_lock() again: %s", smx.try_lock() ? "true" : "false");
+	smx.unlock();
+
+	// RWMutex; writers keep a == b, readers check that it is so
+	RWMutex rw;
+	int a = 0, b = 0;
+	std::atomic<int> bad(0);
+
+	print("%v", &rw);
+	wg.add(kTasks);
+	for(int i = 0; i < kTasks; i++) {
+		bool writer = (i % 4 == 0);
+		go([&, writer]() {
+			for(int j = 0; j < kLoops / 10; j++) {
+				if (writer) {
+					WriteLock lk(rw);
+					a++;
+					b++;
+				} else {
+					ReadLock lk(rw);
+					if (a != b) {
+						bad++;
+					}
+				}
+			}
+			wg.done();
+		});
+	}
+	wg.wait();
+	print("RWMutex: a == %d, b == %d, readers saw a != b %d times", a, b, bad.load());
+
+	// many readers at once
+	rw.lock_shared();
+	rw.lock_shared();
+	print("%v", &rw);
+	print("try_lock() with readers: %s", rw.try_lock() ? "true" : "false");
+
+	// a waiting writer keeps new readers out
+	std::atomic<bool> wrote(false);
+	std::thread t([&]() {
+		WriteLock lk(rw);
+		wrote = true;
+	});
+	while(rw.str() != "<RWMutex: writer waiting>") {
+		std::this_thread::yield();
+	}
+	print("%v", &rw);
+	print("try_lock_shared() with writer waiting: %s", rw.try_lock_shared() ? "true" : "false");
+	rw.unlock_shared();
+	rw.unlock_shared();
+	t.join();
+	print("writer got it: %s", wrote.load() ? "true" : "false");
+	print("%v", &rw);
+	print("operator!(): %s", (!rw) ? "OK" : "FAIL");
+
+	// StripedLock; one counter per stripe
+	StripedLock<16> stripes;
+	int counts[16] = { 0, };
+
+	print("%v with %zu locks", &stripes, stripes.len());
+	wg.add(kTasks);
+	for(int i = 0; i < kTasks; i++) {
+		go([&]() {
+			for(int key = 0; key < kLoops / 10; key++) {
+				std::lock_guard<SpinMutex> lk(stripes[key]);
+				counts[stripes.index(key)]++;
+			}
+			wg.done();
+		});
+	}
+	wg.wait();
+
+	int total = 0, used = 0;
+	for(int i = 0; i < 16; i++) {
+		total += counts[i];
+		if (counts[i] > 0) {
+			used++;
+		}
+	}
+	print("StripedLock: total %d, %d of 16 locks used", total, used);
+	print("same key, same lock: %s", (&stripes[String("hello")] == &stripes[String("hello")]) ? "true" : "false");
+
+	stripes.lock_all();
+	print("lock_all(): %v", &stripes.at(5));
+	stripes.unlock_all();
+	print("unlock_all(): %v", &stripes.at(5));
+
+	// striped reader-writer locks
+	StripedLock<8, RWMutex> rwstripes;
+	{
+		ReadLock lk1(rwstripes[1]);
+		ReadLock lk2(rwstripes[1]);
+		print("%v", &rwstripes[1]);
+	}
+	return 0;
+}
+
+// EOB
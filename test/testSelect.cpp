@@ -0,0 +1,191 @@
+/*
+	testSelect.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <chrono>
+#include <utility>
+
+using namespace oo;
+
+const int kItems = 1000;
+
+Chan<int> evens(4);
+Chan<int> odds(4);
+Chan<int> quit(1);
+
+void producer(Chan<int> *c, int start) {
+	for(int i = start; i <= kItems; i += 2) {
+		c->put(i);
+	}
+	c->close();
+}
+
+// whether Select::write() accepts a value of type T
+template <typename T>
+auto can_write(int) -> decltype(std::declval<Select&>().write(std::declval<Chan<int>&>(), std::declval<T>()), bool()) {
+	return true;
+}
+
+template <typename T>
+bool can_write(...) {
+	return false;
+}
+
+int main(void) {
+	// close
+	Chan<int> c(4);
+	c.put(1);
+	c.put(2);
+	c.close();
+	print("closed(): %s", c.closed() ? "true" : "false");
+	try {
+		c.put(3);
+		print("put() on closed channel    <-- BUG");
+	} catch(RuntimeError err) {
+		print("put() on closed channel: %v", &err);
+	}
+	int n = 0;
+	while(c.read(n)) {
+		print("read(): %d", n);
+	}
+	print("read() on closed and empty channel: false");
+	try {
+		c.get();
+		print("get() on closed channel    <-- BUG");
+	} catch(RuntimeError err) {
+		print("get() on closed channel: %v", &err);
+	}
+
+	// non-blocking
+	Chan<int> t(1);
+	bool ok;
+	print("try_read() on empty: %s", t.try_read(n) ? "true" : "false");
+	print("try_write(): %s", t.try_write(10) ? "true" : "false");
+	print("try_write() on full: %s", t.try_write(11) ? "true" : "false");
+	ok = t.try_read(n);
+	print("try_read(): %s %d", ok ? "true" : "false", n);
+
+	// timeouts
+	auto t0 = std::chrono::steady_clock::now();
+	ok = t.read_for(n, std::chrono::milliseconds(50));
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+	print("read_for() timed out: %s", (!ok && ms >= 50) ? "OK" : "FAIL");
+	t.put(12);
+	ok = t.write_for(13, std::chrono::milliseconds(10));
+	print("write_for() on full: %s", ok ? "true" : "false");
+	ok = t.read_until(n, std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+	print("read_until(): %s %d", ok ? "true" : "false", n);
+
+	// select
+	Select empty;
+	int x = 0;
+	int y = 0;
+	int tick = empty.read(t, x);
+	int r = empty.try_wait();
+	print("try_wait() on empty: %d", r);
+	r = empty.wait_for(std::chrono::milliseconds(20));
+	print("wait_for() timed out: %d", r);
+	t.put(14);
+	r = empty.wait_for(std::chrono::milliseconds(20));
+	print("wait_for(): %s %d", (r == tick) ? "OK" : "FAIL", x);
+
+	go(producer, &evens, 2);
+	go(producer, &odds, 1);
+
+	Select sel;
+	bool even_ok = false;
+	bool odd_ok = false;
+	int e = sel.read(evens, x, &even_ok);
+	int o = sel.read(odds, y, &odd_ok);
+
+	long sum = 0;
+	int open = 2;
+	int n_even = 0;
+	int n_odd = 0;
+	while(open > 0) {
+		r = sel.wait();
+		if (r == e) {
+			if (!even_ok) {
+				// closed
+				sel.disable(r);
+				open--;
+				continue;
+			}
+			if (x % 2 != 0) {
+				print("select: got %d from evens    <-- BUG", x);
+			}
+			sum += x;
+			n_even++;
+		} else if (r == o) {
+			if (!odd_ok) {
+				// closed
+				sel.disable(r);
+				open--;
+				continue;
+			}
+			if (y % 2 != 1) {
+				print("select: got %d from odds    <-- BUG", y);
+			}
+			sum += y;
+			n_odd++;
+		} else {
+			print("select: got case %d    <-- BUG", r);
+		}
+	}
+	join();
+	long expect = (long)kItems * (kItems + 1) / 2;
+	print("select: evens %d, odds %d, sum %s", n_even, n_odd, (sum == expect) ? "OK" : "FAIL");
+
+	// select with a write case
+	Chan<int> out(1);
+	Select sw;
+	int value = 42;
+	int w = sw.write(out, value);
+	int q = sw.read(quit, x);
+	r = sw.wait();
+	print("select write: %s", (r == w && out.get() == 42) ? "OK" : "FAIL");
+	out.put(0);
+	go(
+		[]() {
+			quit.put(1);
+		}
+	);
+	r = sw.wait();
+	join();
+	print("select quit: %s", (r == q) ? "OK" : "FAIL");
+
+	// a write case refers to the value; it can not be a temporary
+	print("write() of a variable: %s", can_write<int&>(0) ? "OK" : "FAIL");
+	print("write() of a temporary: %s", can_write<int>(0) ? "FAIL" : "OK");
+
+	return 0;
+}
+
+// EOB
@@ -31,6 +31,10 @@
 
 #include "oolib"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 using namespace oo;
 
 const int kNumConsumers = 3;
@@ -95,6 +99,64 @@ Sem get_mutex(void) {
 	return m;
 }
 
+// FastSem throttles threads; at most kSlots of them run at the same time
+const int kSlots = 2;
+
+FastSem slots(kSlots);
+std::atomic<int> running(0), max_running(0);
+
+void throttled(void) {
+	for(int i = 0; i < 1000; i++) {
+		slots.wait();
+		int n = ++running;
+		int m = max_running.load();
+		while(n > m && !max_running.compare_exchange_weak(m, n)) {
+		}
+		running--;
+		slots.post();
+	}
+}
+
+void test_fastsem(void) {
+	for(int i = 0; i < 4; i++)
+		go(throttled);
+	join();
+	print("FastSem: at most %d running: %s", kSlots, (max_running.load() <= kSlots) ? "OK" : "FAIL");
+	print("FastSem: %v", &slots);
+
+	FastSem sem;
+	print("trywait(): %s", sem.trywait() ? "true" : "false");
+	print("timedwait(10ms): %s", sem.timedwait(std::chrono::milliseconds(10)) ? "true" : "false");
+	go([&sem]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		sem.post();
+	});
+	print("timedwait(10s) with post: %s", sem.timedwait(std::chrono::seconds(10)) ? "true" : "false");
+	join();
+	print("operator!(): %s", (!sem) ? "OK" : "FAIL");
+}
+
+// SharedSem works across processes
+void test_sharedsem(void) {
+	SharedSem ready(0), done(0);
+
+	print("SharedSem: %v", &ready);
+	child([ready, done]() mutable {
+		ready.wait();
+		done.post();
+	});
+	ready.post();
+	print("child posted: %s", done.timedwait(std::chrono::seconds(10)) ? "true" : "false");
+	wait();
+
+	print("trywait(): %s", done.trywait() ? "true" : "false");
+	print("timedwait(10ms): %s", done.timedwait(std::chrono::milliseconds(10)) ? "true" : "false");
+	done.post();
+	print("SharedSem: %v", &done);
+	del(done);
+	print("operator!(): %s", (!done) ? "OK" : "FAIL");
+}
+
 int main(void) {
 	mutex = get_mutex();
 
@@ -114,6 +176,8 @@ int main(void) {
 	print("sem: %v", &mutex);
 	print("operator!(): %s", (!mutex) ? "OK" : "FAIL");
 
+	test_fastsem();
+	test_sharedsem();
 	return 0;
 }
 
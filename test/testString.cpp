@@ -88,6 +88,16 @@ int main(void) {
 	print("rfind(cab, -4, 28): %d", s1.rfind("cab", -4, 28));
 	print("rfind(cab, -4, 29): %d", s1.rfind("cab", -4, 29));
 
+	// a match may take up the whole string, or end at the very end
+	String abc = "abc";
+	print("find(abc) in abc: %d", abc.find("abc"));
+	print("rfind(abc) in abc: %d", abc.rfind("abc"));
+	print("find(bc) in abc: %d", abc.find("bc"));
+	print("rfind(bc) in abc: %d", abc.rfind("bc"));
+	print("find(abcd) in abc: %d", abc.find("abcd"));
+	print("find(bc, 0, 2) in abc: %d", abc.find("bc", 0, 2));
+	print("find(abc, 27): %d", s1.find("abc", 27));
+
 	s1 = "\t  strip tests ...	";
 	s2 = s1.lstrip();
 	print("s2: lstrip(): %q  len: %zu  cap: %zu", &s2, len(s2), cap(s2));
@@ -115,6 +125,17 @@ int main(void) {
 
 	s2 = s1.replace("the ", "a ");
 	print("s2: replace: %q  len: %zu  cap: %zu", &s2, len(s2), cap(s2));
+	s2 = s1.replace("the ", "", 1);
+	print("s2: replace: %q  len: %zu  cap: %zu", &s2, len(s2), cap(s2));
+
+	Dict<String> escapes;
+	escapes["<"] = "&lt;";
+	escapes[">"] = "&gt;";
+	escapes["&"] = "&amp;";
+	escapes["&&"] = "and";
+	String html = "if (a < b && c > d) { x = a & b; }";
+	s2 = html.replace_many(escapes);
+	print("s2: replace_many: %q  len: %zu", &s2, len(s2));
 
 	print("split():");
 	s1 = "the quick brown 狐 jumps over the lazy 犬";
@@ -122,6 +143,17 @@ int main(void) {
 	foreach(i, a)
 		print("a[%zu]: %q", i, &a[i]);
 
+	// consecutive and trailing separators give empty fields
+	String csv = "a,,";
+	Array<String> fields = csv.split(',');
+	print("split(a,,): %v", &fields);
+	csv = ",b,,c,";
+	fields = csv.split(',');
+	print("split(,b,,c,): %v", &fields);
+	csv = "x--y----";
+	fields = csv.split("--");
+	print("split(x--y----): %v", &fields);
+
 	s2 = s1.join(a, '.');
 	print("s2: join: %q  len: %zu  cap: %zu", &s2, len(s2), cap(s2));
 
@@ -135,6 +167,69 @@ int main(void) {
 	print("n == %d", n);
 	print("type conversion: %s", (n == 1234) ? "OK" : "FAIL");
 
+	double f = convert<double>(" 3.25e2 ");
+	print("convert<double>: %s", (f == 325.0) ? "OK" : "FAIL");
+	try {
+		convert<short>("70000");
+		print("FAIL; convert<short>(70000) did not throw");
+	} catch(ValueError err) {
+		print("convert<short>(70000): ValueError: OK");
+	}
+	print("convert<float>: %s", (convert<float>("-2.5e3") == -2500.0f) ? "OK" : "FAIL");
+	try {
+		convert<float>("1e300");
+		print("FAIL; convert<float>(1e300) did not throw");
+	} catch(ValueError err) {
+		print("convert<float>(1e300): ValueError: OK");
+	}
+	try {
+		convert<float>("-1e39");
+		print("FAIL; convert<float>(-1e39) did not throw");
+	} catch(ValueError err) {
+		print("convert<float>(-1e39): ValueError: OK");
+	}
+
+	s2 = String::from(-1234567890123LL);
+	print("from(int64): %q", &s2);
+	s2 = String::from(0.1);
+	print("from(double): %q", &s2);
+	s2 = String::from(2.0 / 3.0);
+	print("from(double): %q  round trip: %s", &s2, (convert<double>(s2) == 2.0 / 3.0) ? "OK" : "FAIL");
+	s2 = String::from(1e-300);
+	print("from(double): %q", &s2);
+	s2 = String::from(5e-324);
+	print("from(double): %q  round trip: %s", &s2, (convert<double>(s2) == 5e-324) ? "OK" : "FAIL");
+	s2 = String::from(-2.5e-310);
+	print("from(double): %q  round trip: %s", &s2, (convert<double>(s2) == -2.5e-310) ? "OK" : "FAIL");
+
+	s1 = "hash key";
+	s2 = "hash";
+	uint64_t h = s1.hash();
+	print("hash(): %s", (h == s1.view().hash()) ? "OK" : "FAIL");
+	s2 += " key";
+	print("hash() after +=: %s", (s2.hash() == h && s1 == s2) ? "OK" : "FAIL");
+	s2 += "s";
+	print("hash() changed: %s", (s2.hash() != h && s1 != s2) ? "OK" : "FAIL");
+
+	// case changes make a new hash, also when the original had one
+	s1 = "abc";
+	s2 = "ABC";
+	s1.hash();
+	s2.hash();
+	print("hash() after upper(): %s", (s1.upper() == s2 && s1.upper().hash() == s2.hash()) ? "OK" : "FAIL");
+	print("hash() after lower(): %s", (s2.lower() == s1) ? "OK" : "FAIL");
+	s1 = "hello world";
+	s2 = "Hello World";
+	s1.hash();
+	s2.hash();
+	print("hash() after capitalize(): %s", (s1.capitalize() == String("Hello world")) ? "OK" : "FAIL");
+	print("hash() after capwords(): %s", (s1.capwords() == s2) ? "OK" : "FAIL");
+	HashDict<int> hd;
+	hd["ABC"] = 1;
+	s1 = "abc";
+	s1.hash();
+	print("HashDict has_key(upper()): %s", hd.has_key(s1.upper()) ? "OK" : "FAIL");
+
 	s1 = "abc";
 	s2 = s1;
 	print("eq: %s", (s1 == s2) ? "OK" : "FAIL");
@@ -0,0 +1,111 @@
+/*
+	testStringView.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+using namespace oo;
+
+int main(void) {
+	const char *line = "GET /index.html HTTP/1.1";
+
+	StringView v = line;
+	print("v: %s  len: %zu", v.str().c_str(), v.len());
+
+	StringView method = v.slice(0, v.find(' '));
+	print("method: %s", method.str().c_str());
+	print("method == GET: %s", (method == "GET") ? "OK" : "FAIL");
+
+	int pos = v.rfind(' ');
+	StringView proto = v.slice(pos + 1, v.len());
+	print("proto: %s", proto.str().c_str());
+	print("find(HTTP): %d", v.find("HTTP"));
+	print("rfind(/): %d", v.rfind('/'));
+	print("find(Z): %d", v.find('Z'));
+
+	StringView padded = "  \t padded \n";
+	print("strip(): \"%s\"", padded.strip().str().c_str());
+	print("lstrip(): \"%s\"", padded.lstrip().str().c_str());
+	print("rstrip(): \"%s\"", padded.rstrip().str().c_str());
+
+	// String accepts a StringView, and converts to one
+	String s = "the quick brown 狐 jumps over the lazy 犬";
+	print("s.find(view): %d", s.find(StringView("brown")));
+	print("s.find(狐): %d", s.find((rune)0x72d0));
+
+	Array<String> a = s.split(StringView(" the "));
+	foreach(i, a)
+		print("a[%zu]: %q", i, &a[i]);
+
+	String t = s.view().slice(4, 9);
+	print("t: %q", &t);
+
+	Dict<int> d;
+	d["aap"] = 1;
+	print("has_key(view): %s", d.has_key(StringView("aap noot", 3)) ? "OK" : "FAIL");
+	print("has_key(view): %s", d.has_key(StringView("noot")) ? "FAIL" : "OK");
+
+	print("isplit():");
+	const char *csv = "2014-09-01,GET,/index.html,200,1024";
+	SplitIter it = StringView(csv).isplit(',');
+	StringView field;
+	it.next(field);
+	print("  date: %s", field.str().c_str());
+	it.next(field);
+	it.next(field);
+	print("  path: %s", field.str().c_str());
+	print("  rest: %s", it.rest().str().c_str());
+
+	for(const StringView& f : s.isplit(StringView(" the ")))
+		print("  field: \"%s\"", f.str().c_str());
+
+	for(const StringView& f : StringView("a,,").isplit(','))
+		print("  field: \"%s\"", f.str().c_str());
+
+	// the separator may be a temporary; the iterator keeps a copy
+	String sep = ";";
+	String csv2 = "a; b;  c";
+	for(const StringView& f : csv2.isplit(sep + " "))
+		print("  field: \"%s\"", f.str().c_str());
+	String long_sep = "--------------------";
+	String parts = String("left") + long_sep + String("right");
+	for(const StringView& f : parts.isplit(String(long_sep)))
+		print("  field: \"%s\"", f.str().c_str());
+
+	print("isplitlines():");
+	String text = "line one\r\nline two\n\nline four\n";
+	for(const StringView& l : text.isplitlines())
+		print("  line: \"%s\"", l.str().c_str());
+
+	print("lt: %s", (StringView("abc") < StringView("abcd")) ? "OK" : "FAIL");
+	print("ne: %s", (StringView("abc") != StringView("abd")) ? "OK" : "FAIL");
+	print("empty: %s", StringView().empty() ? "OK" : "FAIL");
+	return 0;
+}
+
+// EOB
@@ -0,0 +1,175 @@
+/*
+	testTaskGroup.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace oo;
+
+std::atomic<int> counter(0);
+
+void add(int n) {
+	counter += n;
+}
+
+void boom(int n) {
+	if (n == 3) {
+		throw ValueError("task 3 failed");
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	counter++;
+}
+
+// nested groups; a task waits for its own children
+long fib(int n) {
+	if (n < 2) {
+		return n;
+	}
+	long a, b;
+	TaskGroup g;
+	g.go([&a, n]() { a = fib(n - 1); });
+	b = fib(n - 2);
+	g.wait();
+	return a + b;
+}
+
+int main(void) {
+	WaitGroup wg;
+	wg.add(4);
+	for(int i = 0; i < 4; i++) {
+		go([&wg]() {
+			counter++;
+			wg.done();
+		});
+	}
+	wg.wait();
+	print("WaitGroup: %d", counter.load());
+	try {
+		wg.done();
+		print("done() without add()    <-- BUG");
+	} catch(RuntimeError err) {
+		print("done() without add(): %v", &err);
+	}
+	join();
+
+	// groups wait for their own tasks only
+	counter = 0;
+	Chan<int> never(1);
+	go([&never]() { never.get(); });
+
+	TaskGroup g;
+	for(int i = 1; i <= 100; i++) {
+		g.go(add, i);
+	}
+	g.wait();
+	print("TaskGroup: sum %d, pending %zu", counter.load(), g.pending());
+
+	// exceptions
+	counter = 0;
+	TaskGroup failing;
+	for(int i = 0; i < 10; i++) {
+		failing.go(boom, i);
+	}
+	try {
+		failing.wait();
+		print("wait() did not throw    <-- BUG");
+	} catch(ValueError err) {
+		print("wait() threw: %v", &err);
+	}
+	print("cancelled(): %s", failing.cancelled() ? "true" : "false");
+
+	// cancellation
+	counter = 0;
+	TaskGroup cancelled;
+	CancelToken token = cancelled.token();
+	WaitGroup started;
+	started.add(1);
+	cancelled.go([token, &started]() {
+		started.done();
+		while(!token.cancelled()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		counter++;
+	});
+	started.wait();
+	cancelled.cancel();
+	cancelled.go(add, 100);
+	cancelled.wait();
+	print("cancel(): counter %d", counter.load());
+	try {
+		token.check();
+	} catch(CancelledError err) {
+		print("check(): %v", &err);
+	}
+
+	// nesting
+	print("fib(20): %ld", fib(20));
+
+	// a single worker can only get this done by helping out
+	ThreadPool one(1);
+	counter = 0;
+	TaskGroup outer(one);
+	outer.go([&one]() {
+		TaskGroup inner(one);
+		for(int i = 0; i < 10; i++) {
+			inner.go(add, 1);
+		}
+		inner.wait();
+	});
+	outer.wait();
+	print("nested on one worker: %d", counter.load());
+
+	// wait() in a goroutine runs no other goroutines, that might be
+	// waiting for what the waiter does next
+	Chan<int> ch(1);
+	WaitGroup finished;
+	finished.add(2);
+	go([&ch, &finished]() {
+		TaskGroup g;
+		g.go([]() { });
+		go([&ch, &finished]() {
+			ch.get();
+			finished.done();
+		});
+		g.wait();
+		ch.put(1);
+		finished.done();
+	});
+	finished.wait();
+	print("wait() in a goroutine: finished");
+
+	never.put(0);
+	join();
+	return 0;
+}
+
+// EOB
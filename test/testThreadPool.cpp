@@ -0,0 +1,136 @@
+/*
+	testThreadPool.cpp	WJ114
+*/
+/*
+ * Copyright (c) 2014, Walter de Jong
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "oolib"
+
+#include <atomic>
+#include <chrono>
+
+using namespace oo;
+
+std::atomic<int> counter(0);
+
+void add(int n) {
+	counter += n;
+}
+
+// divide and conquer; the halves go on the deque of the worker
+void sum_range(ThreadPool *pool, int lo, int hi) {
+	if (hi - lo <= 16) {
+		int sum = 0;
+		for(int i = lo; i < hi; i++) {
+			sum += i;
+		}
+		counter += sum;
+		return;
+	}
+	int mid = lo + (hi - lo) / 2;
+	pool->go(sum_range, pool, lo, mid);
+	pool->go(sum_range, pool, mid, hi);
+}
+
+int main(void) {
+	// fixed pool
+	ThreadPool fixed(2);
+	for(int i = 1; i <= 100; i++) {
+		fixed.go(add, i);
+	}
+	fixed.wait();
+	print("fixed pool: threads %zu, sum %d", fixed.threads(), counter.load());
+	print("pending(): %zu", fixed.pending());
+
+	// elastic pool; tasks that block each other must each get a thread
+	ThreadPool elastic(0, 8, std::chrono::milliseconds(50));
+	Chan<int> ping(1), pong(1);
+	elastic.go([&ping, &pong]() {
+		for(int i = 0; i < 3; i++) {
+			pong.put(ping.get() + 1);
+		}
+	});
+	elastic.go([&ping, &pong]() {
+		int n = 0;
+		for(int i = 0; i < 3; i++) {
+			ping.put(n);
+			n = pong.get();
+		}
+		print("ping-pong: %d", n);
+	});
+	elastic.wait();
+	print("elastic pool: threads %zu", elastic.threads());
+
+	// surplus workers go away after the linger time
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	print("elastic pool after linger: threads %zu", elastic.threads());
+
+	// shutdown runs what is queued
+	ThreadPool one(1);
+	counter = 0;
+	for(int i = 0; i < 10; i++) {
+		one.go(add, 1);
+	}
+	one.shutdown();
+	print("shutdown: sum %d", counter.load());
+	try {
+		one.go(add, 1);
+		print("submit after shutdown    <-- BUG");
+	} catch(RuntimeError err) {
+		print("submit after shutdown: %v", &err);
+	}
+
+	// work stealing
+	WorkDeque<int *> dq(2);
+	int items[4] = { 1, 2, 3, 4 };
+	for(int i = 0; i < 4; i++) {
+		dq.push(&items[i]);
+	}
+	int *p = nullptr;
+	dq.pop(p);
+	print("WorkDeque pop(): %d", *p);
+	dq.steal(p);
+	print("WorkDeque steal(): %d", *p);
+	print("WorkDeque len(): %zu", dq.len());
+
+	ThreadPool four(4);
+	counter = 0;
+	four.go(sum_range, &four, 0, 10000);
+	four.wait();
+	print("divide and conquer: sum %s", (counter == 10000 * 9999 / 2) ? "OK" : "FAIL");
+
+	// go() reuses the threads of go_pool()
+	counter = 0;
+	for(int i = 0; i < 1000; i++) {
+		go(add, 1);
+	}
+	join();
+	print("go(): sum %d, threads %s", counter.load(), (go_pool().threads() < 1000) ? "reused" : "FAIL");
+
+	return 0;
+}
+
+// EOB